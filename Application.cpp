@@ -1,6 +1,11 @@
 #include <vector>
 #include <iostream>
 #include <string>
+#include <memory>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cfloat>
 
 #include "GL/glew.h"
 #include "GLFW/glfw3.h"
@@ -11,46 +16,122 @@
 #include "VertexBuffer.h"
 #include "VertexBufferLayout.h"
 #include "Texture.h"
-#include "FrameBuffer.h"
 #include "IndexBuffer.h"
 #include "Shader.h"
 #include "Lights.h"
-
-#define OP_OBJ_NUM 6 // The number of opaque objects.
-#define TRANS_OBJ_NUM 3 // Number of translucent objects.
-#define ALPHA 0.3 // The transparency of a translucent object.
+#include "Mesh.h"
+#include "MeshCache.h"
+#include "ObjStreamer.h"
+#include "LodSelector.h"
+#include "MeshQuantizer.h"
+#include "ShadowMaps.h"
+#include "Frustum.h"
+#include "FileWatcher.h"
+#include "GeometryHeap.h"
+#include "AssetRegistry.h"
+#include "Scene.h"
+#include "SceneSnapshot.h"
+#include "SceneGraph.h"
+#include "EntityStore.h"
+#include "Bvh.h"
+#include "OcclusionCuller.h"
+#include "Pvs.h"
+#include "GLState.h"
 
 #define A 0.0f
 #define B 0.0f
 #define C 0.02f
-#define N 2
-
-#define AMBIENT_STRENGTH 0.1f
-#define SPECULAR_STRENGTH 0.5f
-#define DIFFUSE_STRENGTH 0.8f
 
-#define OBJECT_COLOR 1.0f, 0.5f, 0.31f
 #define LIGHT_COLOR 1.0f, 1.0f, 1.0f
 
 // Program window size.
 #define WIDTH 1280
 #define HEIGHT 720
 
+#define SHADOW_WIDTH 4096 // Increase resolution for finer shadows.
+#define SHADOW_HEIGHT 4096
+
+// Watched for hot reloading.
+#define SCENE_FILE "../res/objects/scene.txt"
+#define LIGHTS_FILE "../res/lightsPos.pos"
+#define SNAPSHOT_FILE "../res/objects/scene.snapshot" // Written by --snapshot, read by --from-snapshot.
+#define PVS_FILE "../res/objects/scene.pvs" // Written by PvsBaker, read by --pvs.
+
+// Render queue passes, in the order they run: each light's opaque depth map at 2 * light and its translucent one
+// after it, then the main view.
+#define MAIN_OPAQUE_PASS 254u
+#define MAIN_TRANSLUCENT_PASS 255u
+#define MAIN_SHADER 0u
+#define DEPTH_SHADER 1u
+// Render queue payloads besides the entities' dense indices.
+#define PLANE_COMMAND (~0u)
+#define CLEAR_COMMAND (~0u - 1) // Draws nothing, but runs its pass so the pass's map is cleared.
+
+// Per-instance attributes of the main pass, as laid out in the instance buffer; the depth passes only take model.
+struct objectInstance {
+    glm::mat4 model; // Including the mesh's dequantization.
+    glm::mat3 normalMatrix;
+    glm::vec4 color;    // And alpha.
+    glm::vec4 material; // Ambient, diffuse and specular strengths, and shininess.
+};
+
 // Camera settings
 glm::vec3 cameraPos = glm::vec3(0.0f, 6.0f, 15.0f);
 glm::vec3 cameraFront = glm::vec3(0.0f, 0.0f, -1.0f);
 glm::vec3 cameraUp = glm::vec3(0.0f, 1.0f, 0.0f);
 float cameraSpeed = 0.05f;
 
-std::unordered_map<unsigned int, glm::vec3> axisOffs; // The offsets of the object in the scene.
-
 bool genShaderSrc(const std::string &filePath, unsigned int num);
 void processInput(GLFWwindow *window, glm::vec3 &cameraPos, glm::vec3 &cameraFront, glm::vec3 &cameraUp,
                   float &cameraSpeed);
-bool loadOBJ(const char *path, std::vector<glm::vec3> &vertices, std::vector<glm::vec3> &normals, const glm::vec3 &offset);
-void getAxisOff(const std::string filePath, std::unordered_map<unsigned int, glm::vec3> &axisOffs);
+bool loadOBJ(const char *path, meshData &mesh, const glm::vec3 &offset);
+bool loadOBJ(const char *path, MeshCache &cache, const glm::vec3 &offset, size_t streamBudget,
+             unsigned long long streamThreshold);
+
+int main(int argc, char **argv) {
+    // --snapshot [file] saves the resolved scene after loading it, --from-snapshot [file] starts from it.
+    // --scene and --lights replace the scene and lights files. --frames n renders n frames, re-rendering every
+    // shadow map each frame, prints their average GPU times and exits. --no-occlusion draws what the occluders hide.
+    // --pvs [file] only draws what the baked potentially visible set of the camera's cell holds. OBJ files of at least
+    // --stream-threshold MB are streamed into their caches with --stream-budget MB of working memory.
+    std::string scenePath = SCENE_FILE, lightsPath = LIGHTS_FILE, snapshotPath = SNAPSHOT_FILE, pvsPath = PVS_FILE;
+    bool writeSnapshot = false, readSnapshot = false, usePvs = false;
+    int measuredFrames = 0;
+    bool occlusionCulling = true;
+    size_t streamBudget = DEFAULT_STREAM_BUDGET;
+    unsigned long long streamThreshold = DEFAULT_STREAM_THRESHOLD;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--snapshot" || arg == "--from-snapshot") {
+            (arg == "--snapshot" ? writeSnapshot : readSnapshot) = true;
+            if (i + 1 < argc && argv[i + 1][0] != '-') {
+                snapshotPath = argv[++i];
+            }
+        } else if (arg == "--pvs") {
+            usePvs = true;
+            if (i + 1 < argc && argv[i + 1][0] != '-') {
+                pvsPath = argv[++i];
+            }
+        } else if (arg == "--scene" && i + 1 < argc) {
+            scenePath = argv[++i];
+        } else if (arg == "--lights" && i + 1 < argc) {
+            lightsPath = argv[++i];
+        } else if (arg == "--frames" && i + 1 < argc && std::atoi(argv[i + 1]) > 0) {
+            measuredFrames = std::atoi(argv[++i]);
+        } else if (arg == "--no-occlusion") {
+            occlusionCulling = false;
+        } else if (arg == "--stream-budget" && i + 1 < argc && std::atoll(argv[i + 1]) > 0) {
+            streamBudget = std::atoll(argv[++i]) * 1024ull * 1024ull;
+        } else if (arg == "--stream-threshold" && i + 1 < argc && std::atoll(argv[i + 1]) > 0) {
+            streamThreshold = std::atoll(argv[++i]) * 1024ull * 1024ull;
+        } else {
+            std::cerr << "Unknown argument " << arg << "; usage: " << argv[0]
+                      << " [--snapshot [file]] [--from-snapshot [file]] [--scene file] [--lights file] [--frames n]"
+                      << " [--no-occlusion] [--pvs [file]] [--stream-budget MB] [--stream-threshold MB]" << std::endl;
+            return -1;
+        }
+    }
 
-int main() {
     // Initialize GLFW.
     if (!glfwInit()) {
         std::cerr << "Failed to initialize GLFW" << std::endl;
@@ -87,268 +168,1014 @@ int main() {
     glEnable(GL_BLEND);
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
-    // Load light settings.
+    // Start from the snapshot if it is still valid, otherwise from the text files.
+    double loadStart = glfwGetTime();
+    SceneSnapshot snapshot;
+    bool restored = readSnapshot && snapshot.open(snapshotPath, scenePath, lightsPath);
+    if (readSnapshot && !restored) {
+        std::cerr << snapshot.getError() << "; loading the scene files instead" << std::endl;
+    }
+    Scene scene;
     Lights lights;
-    lights.loadLights("../res/lightsPos.pos");
+    if (restored) {
+        snapshot.restore(scene, lights);
+    } else {
+        lights.loadLights(lightsPath);
+    }
     unsigned int lightNum = lights.getLightNum();
 
+    // Light space matrices only change with the lights.
+    glm::mat4 lightProjection = glm::perspective(glm::radians(90.0f), (GLfloat)WIDTH / HEIGHT, 5.0f, 100.0f);
+    std::vector<glm::mat4> lightSpaceMatrix(lightNum);
+    auto updateLightSpaceMatrices = [&]() {
+        lightSpaceMatrix.resize(lightNum);
+        for (size_t i = 0; i < lightNum; i++) {
+            lightSpaceMatrix[i] = snapshot.isOpen() ? snapshot.getLightSpaceMatrix(i) :
+                                  lightProjection * glm::lookAt(lights.getLightPos(i), glm::vec3(0.0f),
+                                                                glm::vec3(0.0f, 1.0f, 0.0f));
+        }
+    };
+    updateLightSpaceMatrices();
+
     // Dynamically generate Shaders based on the number of light sources.
-    if (!genShaderSrc("../res/shaders/fragment.glsl", lightNum)) {
-        std::cout << "Shader generation failed!" << std::endl;
-        return -1;
-    }
+    auto buildShader = [](unsigned int lightNum) -> Shader * {
+        if (!genShaderSrc("../res/shaders/fragment.glsl", lightNum)) {
+            std::cout << "Shader generation failed!" << std::endl;
+            return nullptr;
+        }
+        Shader *shader = new Shader("../res/shaders/vertex.glsl", "../res/shaders/fragment.glsl.cache");
+        remove("../res/shaders/fragment.glsl.cache"); // Clear the shader cache.
+        return shader;
+    };
 
     // Compile and link shaders.
-    Shader shaderProgram("../res/shaders/vertex.glsl", "../res/shaders/fragment.glsl.cache");
+    std::unique_ptr<Shader> shaderProgram(buildShader(lightNum));
+    if (!shaderProgram) {
+        return -1;
+    }
     Shader depthShaderProgram("../res/shaders/depth_vertex.glsl", "../res/shaders/depth_fragment.glsl");
 
-    // Clear the shader cache.
-    remove("../res/shaders/fragment.glsl.cache");
-
-    // Load multiple OBJ files.
-    std::vector<std::string> objFiles = {
-            "../res/objects/object1-酒杯.obj",
-            "../res/objects/object2-小凳子.obj",
-            "../res/objects/object3-台灯.obj",
-            "../res/objects/object4-正方体.obj",
-            "../res/objects/object5-圆柱.obj",
-            "../res/objects/object6-圆球.obj",
-            "../res/objects/object7-锥体.obj",
-            "../res/objects/object8-六边形柱体.obj",
-            "../res/objects/object9-环.obj"
-    };
-    getAxisOff("../res/objects/scene.txt", axisOffs);
-
-    // Create VAOs for the objects.
-    VertexArray opVA(OP_OBJ_NUM);
-    VertexArray transVA(TRANS_OBJ_NUM);
-    std::vector<size_t> vertexCounts;
-
-    for (size_t i = 0; i < OP_OBJ_NUM; i++) {
-        std::vector<glm::vec3> vertices;
-        std::vector<glm::vec3> normals;
-        if (!loadOBJ(objFiles[i].c_str(), vertices, normals, axisOffs[i + 1])) {
-            std::cerr << "Failed to load OBJ file: " << objFiles[i] << std::endl;
-            return -1;
-        }
-
-        opVA.bind(i);
-        VertexBuffer VB(vertices, vertices.size() * sizeof(glm::vec3));
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(GL_FLOAT), (void *) 0);
-        glEnableVertexAttribArray(0);
-
-        VertexBuffer NB(normals, normals.size() * sizeof(glm::vec3));
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(GL_FLOAT), (void *) 0);
-        glEnableVertexAttribArray(1);
-        opVA.unbind();
+    // Load the scene description; every per-object array is sized from it.
+    if (!restored && !scene.load(scenePath)) {
+        std::cerr << scene.getError() << std::endl;
+        return -1;
+    }
 
-        vertexCounts.push_back(vertices.size());
+    // Vertex streams: interleaved quantized positions and normals, and positions alone for the depth passes.
+    // The shaders ignore the fourth position component.
+    VertexBufferLayout vertexLayout;
+    vertexLayout.push<short>(QUANTIZED_POSITION_SIZE);
+    vertexLayout.push<short>(QUANTIZED_NORMAL_SIZE);
+    VertexBufferLayout positionLayout;
+    positionLayout.push<short>(QUANTIZED_POSITION_SIZE);
+    // Instance streams: an objectInstance for the main pass, the model matrix alone for the depth passes. The model
+    // matrix includes the mesh's dequantization, so there is no per-mesh shader data.
+    VertexBufferLayout instanceLayout;
+    for (unsigned int column = 0; column < 4; column++) {
+        instanceLayout.push<float>(4);
+    }
+    VertexBufferLayout depthInstanceLayout = instanceLayout;
+    for (unsigned int column = 0; column < 3; column++) {
+        instanceLayout.push<float>(3);
     }
+    instanceLayout.push<float>(4);
+    instanceLayout.push<float>(4);
+    static_assert(sizeof(objectInstance) == 33 * sizeof(float), "objectInstance must match its instance layout");
+
+    // Every mesh lives in one geometry heap.
+    GeometryHeap heap(vertexLayout, positionLayout, instanceLayout, depthInstanceLayout);
+    printf("Instanced draws through %s\n", heap.isIndirect() ? "glMultiDrawElementsIndirect" :
+                                                              "one glDrawElementsInstancedBaseVertex per mesh range");
+
+    auto printHeapStats = [&heap]() {
+        heapStats stats = heap.getStats();
+        printf("Geometry heap: %u meshes; vertices %zu/%zu (%.0f%% fragmented); index bytes %zu/%zu (%.0f%% "
+               "fragmented); %u defragmentations, %u growths\n", stats.meshNum, stats.vertexUsed,
+               stats.vertexCapacity, 100.0f * stats.vertexFragmentation, stats.indexUsed, stats.indexCapacity,
+               100.0f * stats.indexFragmentation, stats.defragmentNum, stats.growNum);
+    };
 
-    for (size_t i = OP_OBJ_NUM; i < OP_OBJ_NUM + TRANS_OBJ_NUM; i++) {
-        std::vector<glm::vec3> vertices;
-        std::vector<glm::vec3> normals;
-        if (!loadOBJ(objFiles[i].c_str(), vertices, normals, axisOffs[i + 1])) {
-            std::cerr << "Failed to load OBJ file: " << objFiles[i] << std::endl;
-            return -1;
+    // Loads a mesh asset at the origin into the heap; its levels of detail lie back to back in its allocation.
+    auto loadAsset = [&](const std::string &path, meshAsset &asset) -> bool {
+        std::shared_ptr<MeshCache> mesh = std::make_shared<MeshCache>();
+        if (!loadOBJ(path.c_str(), *mesh, glm::vec3(0.0f), streamBudget, streamThreshold)) {
+            std::cerr << "Failed to load OBJ file: " << path << std::endl;
+            return false;
         }
 
-        transVA.bind(i - OP_OBJ_NUM);
-        VertexBuffer VB(vertices, vertices.size() * sizeof(glm::vec3));
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(GL_FLOAT), (void *) 0);
-        glEnableVertexAttribArray(0);
+        unsigned int handle = heap.allocate(mesh->getVertexCount(), mesh->getIndexCount(),
+                                            mesh->getIndexSize() == 2 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT);
+        // The cache holds the vertices quantized as uploaded, so they go straight from the mapping to the heap.
+        std::cout << path << ": quantization error " << mesh->getPositionError() << " units, "
+                  << mesh->getNormalError() << " degrees" << std::endl;
+        asset.dequantization = glm::scale(glm::translate(glm::mat4(1.0f), mesh->getDequantizeOffset()),
+                                          mesh->getDequantizeScale());
+        heap.upload(handle, mesh->getVertices(), mesh->getQuantizedPositions(), mesh->getIndices());
+
+        asset.heapHandle = handle;
+        asset.bytes = mesh->getVertexCount() * (vertexLayout.getStride() + positionLayout.getStride()) +
+                      mesh->getIndexCount() * mesh->getIndexSize();
+        for (unsigned int level = 0; level < mesh->getLodCount(); level++) {
+            asset.lods.push_back(mesh->getLod(level));
+        }
+        asset.center = (mesh->getBoundsMin() + mesh->getBoundsMax()) * 0.5f;
+        asset.radius = glm::length(mesh->getBoundsMax() - mesh->getBoundsMin()) * 0.5f;
+        asset.extent = (mesh->getBoundsMax() - mesh->getBoundsMin()) * 0.5f;
+        // Stays mapped: the occlusion rasterizer reads occluders' full-detail triangles from it rather than a copy.
+        asset.cache = mesh;
+        return true;
+    };
+    AssetRegistry assets(loadAsset, [&heap](meshAsset &asset) { heap.free(asset.heapHandle); });
+
+    // Acquires the mesh of one object of a scene, loading it only if no asset has the file's content yet. Assets
+    // already acquired for a mesh declaration, by the declaration, are retained instead of looked up again.
+    auto acquireMesh = [&](const Scene &scene, size_t i, std::vector<unsigned int> *meshAssets) -> unsigned int {
+        unsigned int mesh = scene.getMesh(i), asset;
+        if (meshAssets && (*meshAssets)[mesh] != INVALID_ASSET_HANDLE) {
+            asset = (*meshAssets)[mesh];
+            assets.retain(asset);
+        } else if ((asset = assets.acquire(scene.getMeshPath(mesh))) != INVALID_ASSET_HANDLE && meshAssets) {
+            (*meshAssets)[mesh] = asset;
+        }
+        return asset;
+    };
+    // World-space bounds of an entity from its node's world matrix. The box is the one around the transformed
+    // model-space box, its half size the model one through the absolute linear part. An entity whose mesh failed to
+    // reload is a point at its origin.
+    auto updateBounds = [&](const SceneGraph &graph, EntityStore &store, size_t i) {
+        const glm::mat4 &world = graph.getWorld(store.getNode(i));
+        float scale = std::max(glm::length(glm::vec3(world[0])),
+                               std::max(glm::length(glm::vec3(world[1])), glm::length(glm::vec3(world[2]))));
+        if (store.getAsset(i) == INVALID_ASSET_HANDLE) {
+            glm::vec3 origin(world[3]);
+            store.setBounds(i, origin, 0.0f, scale);
+            store.setBox(i, origin, origin);
+            return;
+        }
+        const meshAsset &mesh = assets.get(store.getAsset(i));
+        glm::vec3 center = glm::vec3(world * glm::vec4(mesh.center, 1.0f));
+        glm::vec3 extent = glm::mat3(glm::abs(glm::vec3(world[0])), glm::abs(glm::vec3(world[1])),
+                                     glm::abs(glm::vec3(world[2]))) * mesh.extent;
+        store.setBounds(i, center, mesh.radius * scale, scale);
+        store.setBox(i, center - extent, center + extent);
+    };
+    auto entityFlags = [](const Scene &scene, size_t i) -> unsigned char {
+        return (scene.isTranslucent(i) ? ENTITY_TRANSLUCENT : 0) | (scene.isOccluder(i) ? ENTITY_OCCLUDER : 0);
+    };
+    // Places every object of a scene as an entity, with one graph node per object in the scene's order. The
+    // entities' handles are returned by object.
+    auto placeScene = [&](const Scene &scene, EntityStore &store, SceneGraph &graph,
+                          std::vector<unsigned int> &handles) -> bool {
+        std::vector<unsigned int> meshAssets(scene.getMeshNum(), INVALID_ASSET_HANDLE), objectAssets;
+        objectAssets.reserve(scene.getObjectNum());
+        for (size_t i = 0; i < scene.getObjectNum(); i++) {
+            objectAssets.push_back(acquireMesh(scene, i, &meshAssets));
+            if (objectAssets.back() == INVALID_ASSET_HANDLE) {
+                objectAssets.pop_back();
+                for (unsigned int asset: objectAssets) {
+                    assets.release(asset);
+                }
+                return false;
+            }
+        }
 
-        VertexBuffer NB(normals, normals.size() * sizeof(glm::vec3));
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(GL_FLOAT), (void *) 0);
-        glEnableVertexAttribArray(1);
-        transVA.unbind();
+        graph.clear();
+        graph.reserve(scene.getObjectNum());
+        for (size_t i = 0; i < scene.getObjectNum(); i++) {
+            unsigned int parent = scene.getParent(i);
+            graph.add(parent == SCENE_ROOT ? INVALID_NODE : parent, scene.getPosition(i),
+                      SceneGraph::eulerRotation(scene.getRotation(i)), scene.getScale(i));
+        }
+        graph.update();
+
+        store.clear();
+        store.reserve(scene.getObjectNum());
+        handles.resize(scene.getObjectNum());
+        for (size_t i = 0; i < scene.getObjectNum(); i++) {
+            handles[i] = store.create(i, objectAssets[i], scene.getMaterial(i), entityFlags(scene, i));
+            unsigned int index = store.getIndex(handles[i]);
+            if (snapshot.isOpen()) {
+                const resolvedPlacement &resolved = snapshot.getPlacement(i);
+                store.setBounds(index, resolved.center, resolved.radius, resolved.scale);
+                store.setBox(index, resolved.boxMin, resolved.boxMax);
+            } else {
+                updateBounds(graph, store, index);
+            }
+        }
+        return true;
+    };
+
+    auto printAssetStats = [&assets]() {
+        assetStats stats = assets.getStats();
+        printf("Mesh assets: %u unique meshes for %u placements; %.1lf KB on the GPU, %.1lf KB saved by sharing\n",
+               stats.assetNum, stats.placementNum, stats.loadedBytes / 1024.0,
+               (stats.placedBytes - stats.loadedBytes) / 1024.0);
+    };
 
-        vertexCounts.push_back(vertices.size());
+    // A restored scene's file identities are known, so its meshes are not hashed again.
+    if (restored) {
+        for (unsigned int m = 0; m < snapshot.getMeshNum(); m++) {
+            assets.remember(scene.getMeshPath(m), snapshot.getMeshIdentity(m));
+        }
+    }
+    EntityStore entities;
+    SceneGraph graph;
+    std::vector<unsigned int> objectEntities; // Entity handle of each scene object.
+    bool placed = placeScene(scene, entities, graph, objectEntities);
+    snapshot.close(); // Reloads are computed from the files.
+    if (!placed) {
+        return -1;
+    }
+    // Opaque entities are drawn before translucent ones; the lists hold dense indices. The visible ones are those
+    // of the main view, the casters those a light's maps need for them.
+    std::vector<unsigned int> visibleObjects, visibleOpaque, visibleTranslucent;
+    std::vector<unsigned int> casters, opaqueCasters, translucentCasters;
+    // Entities whose mesh failed to reload; culling drops them while there are any.
+    size_t unloadedNum = 0;
+    auto dropUnloaded = [&](std::vector<unsigned int> &objects) {
+        if (unloadedNum > 0) {
+            objects.erase(std::remove_if(objects.begin(), objects.end(), [&](unsigned int j) {
+                return entities.getAsset(j) == INVALID_ASSET_HANDLE;
+            }), objects.end());
+        }
+    };
+    // Entities by dense index, for view-frustum culling; rebuilt when the entities change, refitted when they move.
+    Bvh bvh;
+    // What the visible occluders hide, from a depth buffer rasterized on the CPU each frame.
+    OcclusionCuller occlusion;
+    auto buildBvh = [&]() {
+        double buildStart = glfwGetTime();
+        bvh.build(entities.getBoxMins(), entities.getBoxMaxs(), entities.size());
+        printf("Culling hierarchy: %zu nodes over %zu objects built in %.2lf ms\n", bvh.getNodeNum(),
+               bvh.getObjectNum(), 1000.0 * (glfwGetTime() - buildStart));
+    };
+    buildBvh();
+    // The objects each cell of the walkable space may see, baked offline for this scene; a scene or mesh edit makes
+    // it stale, so it is dropped until a bake for the new files is there. Mesh hashes come from the registry's file
+    // identities, so only files whose modification time or size changed are read; the scene file is hashed again
+    // only when it changed.
+    Pvs pvs;
+    int pvsCell = -1; // Whose set pvsVisible holds.
+    std::vector<unsigned char> pvsVisible;
+    uint64_t pvsSceneHash = 0, pvsInputHash = 0;
+    bool pvsChecked = false;
+    auto loadPvs = [&](bool sceneChanged) {
+        if (sceneChanged || !pvsChecked) {
+            pvsSceneHash = MeshCache::hashFile(scenePath);
+        }
+        std::vector<uint64_t> meshHashes(scene.getMeshNum(), 0);
+        for (size_t m = 0; m < meshHashes.size(); m++) {
+            fileIdentity identity;
+            if (assets.identify(scene.getMeshPath(m), identity)) {
+                meshHashes[m] = identity.hash;
+            }
+        }
+        uint64_t inputHash = Pvs::hashInputs(pvsSceneHash, meshHashes);
+        if (pvsChecked && inputHash == pvsInputHash) {
+            return; // Baked from the same files as before, or still missing.
+        }
+        pvsChecked = true;
+        pvsInputHash = inputHash;
+        pvsCell = -1;
+        if (!pvs.load(pvsPath, inputHash)) {
+            std::cerr << pvs.getError() << "; drawing without a PVS" << std::endl;
+            return;
+        }
+        const pvsHeader &header = pvs.getHeader();
+        printf("PVS: %u x %u cells of %.1f over %u objects, %.1lf KB\n", header.cellsX, header.cellsZ,
+               header.cellSize, header.objectNum, pvs.getFileSize() / 1024.0);
+    };
+    if (usePvs) {
+        loadPvs(true);
+    }
+    printf("Scene: %zu objects of %zu meshes loaded in %.1lf ms%s\n", scene.getObjectNum(), scene.getMeshNum(),
+           1000.0 * (glfwGetTime() - loadStart), restored ? " from the snapshot" : "");
+    printAssetStats();
+
+    if (writeSnapshot) {
+        std::vector<fileIdentity> identities(scene.getMeshNum());
+        std::vector<resolvedPlacement> placements(objectEntities.size());
+        for (size_t m = 0; m < identities.size(); m++) {
+            assets.identify(scene.getMeshPath(m), identities[m]);
+        }
+        for (size_t i = 0; i < objectEntities.size(); i++) {
+            unsigned int index = entities.getIndex(objectEntities[i]);
+            placements[i] = {entities.getCenter(index), entities.getRadius(index), entities.getScale(index),
+                             entities.getBoxMins()[index], entities.getBoxMaxs()[index]};
+        }
+        if (SceneSnapshot::write(snapshotPath, scenePath, lightsPath, scene, identities, placements, lights,
+                                 lightSpaceMatrix)) {
+            std::cout << "Scene snapshot written to " << snapshotPath << std::endl;
+        }
     }
 
     // Define vertices for the plane
-    float planeVertices[] = {
-            // positions                        // normals
-            100.0f, 0.0f, 100.0f, 0.0f, 1.0f, 0.0f,
-            -100.0f, 0.0f, 100.0f, 0.0f, 1.0f, 0.0f,
-            -100.0f, 0.0f, -100.0f, 0.0f, 1.0f, 0.0f,
-            100.0f, 0.0f, -100.0f, 0.0f, 1.0f, 0.0f
+    std::vector<glm::vec3> planePositions = {
+            {100.0f, 0.0f, 100.0f},
+            {-100.0f, 0.0f, 100.0f},
+            {-100.0f, 0.0f, -100.0f},
+            {100.0f, 0.0f, -100.0f}
     };
+    std::vector<glm::vec3> planeNormals(planePositions.size(), glm::vec3(0.0f, 1.0f, 0.0f));
+    glm::vec3 planeBoundsMin(FLT_MAX), planeBoundsMax(-FLT_MAX); // For the shadow receivers.
+    for (const glm::vec3 &position: planePositions) {
+        planeBoundsMin = glm::min(planeBoundsMin, position);
+        planeBoundsMax = glm::max(planeBoundsMax, position);
+    }
 
-    unsigned int planeVertexIndices[] = {
+    unsigned short planeVertexIndices[] = {
             0, 1, 2,
             2, 3, 0
     };
+    unsigned int planeIndexNum = sizeof(planeVertexIndices) / sizeof(planeVertexIndices[0]);
+
+    // The plane goes into the heap too, quantized like the meshes.
+    unsigned int planeHandle = heap.allocate(planePositions.size(), planeIndexNum, GL_UNSIGNED_SHORT);
+    quantizedMesh plane;
+    quantizeMesh(planePositions.data(), planeNormals.data(), planePositions.size(), plane);
+    const glm::mat4 planeDequantization = glm::scale(glm::translate(glm::mat4(1.0f), plane.offset), plane.scale);
+    heap.upload(planeHandle, plane.vertices.data(), plane.positions.data(), planeVertexIndices);
+    printHeapStats();
+
+    // Shadow mapping setup: depth maps for opaque and translucent objects, rendered when a light's map is dirty.
+    ShadowMaps shadowMaps(lightNum, SHADOW_WIDTH, SHADOW_HEIGHT);
+    // Dirties the shadow maps of every light that can see the sphere.
+    auto markShadowsDirty = [&](const glm::vec3 &center, float radius) {
+        for (size_t i = 0; i < lightNum; i++) {
+            if (Frustum(lightSpaceMatrix[i]).intersects(center, radius)) {
+                shadowMaps.markDirty(i);
+            }
+        }
+    };
 
-    // Create VBO and VAO for the plane.
-    VertexArray planeVA(1);
-    VertexBuffer planeVB(planeVertices, sizeof(planeVertices));
-
-    VertexBufferLayout layout;
-    layout.push<float>(3); // Position coordinates layout.
-    layout.push<float>(3); // Normals coordinates layout.
-    planeVA.addBuffer(0, planeVB, layout);
-    planeVA.unbind();
-
-    // Indices buffer object.
-    IndexBuffer ib(planeVertexIndices, sizeof(planeVertexIndices) / sizeof(planeVertexIndices[0]));
-
-    const unsigned int SHADOW_WIDTH = 4096, SHADOW_HEIGHT = 4096; // Increase resolution for finer shadows.
-
-    // Shadow mapping setup.
-    // Depth mapping for opaque objects.
-    Texture opDepthMap("", lightNum, textureType::Depth, SHADOW_WIDTH, SHADOW_HEIGHT);
-    std::vector<FrameBuffer> opDepthMapFB;
-    // Depth mapping for translucent objects.
-    Texture transDepthMap("", lightNum, textureType::Depth, SHADOW_WIDTH, SHADOW_HEIGHT);
-    std::vector<FrameBuffer> transDepthMapFB;
-    for (size_t i = 0; i < lightNum; i++) {
-        opDepthMapFB.push_back(FrameBuffer());
-        opDepthMapFB[i].addTexutre(opDepthMap.getID(i));
-        transDepthMapFB.push_back(FrameBuffer());
-        transDepthMapFB[i].addTexutre(transDepthMap.getID(i));
-
-        glDrawBuffer(GL_NONE);
-        glReadBuffer(GL_NONE);
-    }
+    // Hot reloading: the scene, lights and the mesh files.
+    FileWatcher watcher;
+    unsigned int sceneWatch = watcher.add(scenePath);
+    unsigned int lightsWatch = watcher.add(lightsPath);
+    std::vector<std::string> watchedMeshes;
+    std::vector<unsigned int> meshWatches;
+    auto watchMeshes = [&]() {
+        for (size_t m = 0; m < scene.getMeshNum(); m++) {
+            const std::string &path = scene.getMeshPath(m);
+            if (std::find(watchedMeshes.begin(), watchedMeshes.end(), path) == watchedMeshes.end()) {
+                watchedMeshes.push_back(path);
+                meshWatches.push_back(watcher.add(path));
+            }
+        }
+    };
+    watchMeshes();
+
+    auto markEntityShadowsDirty = [&](const EntityStore &store, unsigned int handle) {
+        unsigned int index = store.getIndex(handle);
+        markShadowsDirty(store.getCenter(index), store.getRadius(index));
+    };
+    // Applies an edit that kept every object, its mesh and its parent: only the changed local transforms are set,
+    // and the graph recomputes their subtrees. Shadow maps are dirtied around what moved or changed pass.
+    auto moveObjects = [&](const Scene &newScene) {
+        for (size_t i = 0; i < objectEntities.size(); i++) {
+            unsigned int index = entities.getIndex(objectEntities[i]);
+            if (newScene.getPosition(i) != scene.getPosition(i) || newScene.getRotation(i) != scene.getRotation(i) ||
+                newScene.getScale(i) != scene.getScale(i)) {
+                graph.setLocal(i, newScene.getPosition(i), SceneGraph::eulerRotation(newScene.getRotation(i)),
+                               newScene.getScale(i));
+            } else if (newScene.isTranslucent(i) != scene.isTranslucent(i)) {
+                markEntityShadowsDirty(entities, objectEntities[i]);
+            }
+            entities.setMaterial(index, newScene.getMaterial(i));
+            entities.setFlags(index, entityFlags(newScene, i));
+        }
+        // Nodes are the objects' indices.
+        const std::vector<unsigned int> &moved = graph.update();
+        for (unsigned int node: moved) {
+            markEntityShadowsDirty(entities, objectEntities[node]);
+            updateBounds(graph, entities, entities.getIndex(objectEntities[node]));
+            markEntityShadowsDirty(entities, objectEntities[node]);
+        }
+        bvh.refit(entities.getBoxMins(), entities.getBoxMaxs());
+        printf("Moved %zu objects\n", moved.size());
+    };
+    // Replaces the scene, dirtying the shadow maps around the objects that moved, changed mesh or changed pass.
+    auto reloadScene = [&]() {
+        Scene newScene;
+        if (!newScene.load(scenePath)) {
+            std::cerr << newScene.getError() << std::endl << "Keeping the previous scene" << std::endl;
+            return;
+        }
+        bool sameObjects = newScene.getObjectNum() == scene.getObjectNum();
+        for (size_t i = 0; sameObjects && i < scene.getObjectNum(); i++) {
+            sameObjects = newScene.getParent(i) == scene.getParent(i) &&
+                          newScene.getMeshPath(newScene.getMesh(i)) == scene.getMeshPath(scene.getMesh(i));
+        }
+        if (sameObjects) {
+            moveObjects(newScene);
+            scene = newScene;
+            if (usePvs) {
+                loadPvs(true);
+            }
+            return;
+        }
+
+        EntityStore newEntities;
+        SceneGraph newGraph;
+        std::vector<unsigned int> newObjectEntities;
+        if (!placeScene(newScene, newEntities, newGraph, newObjectEntities)) {
+            std::cerr << "Keeping the previous scene" << std::endl;
+            return;
+        }
+        for (size_t i = 0; i < std::max(objectEntities.size(), newObjectEntities.size()); i++) {
+            if (i < objectEntities.size() && i < newObjectEntities.size() &&
+                entities.getAsset(entities.getIndex(objectEntities[i])) ==
+                newEntities.getAsset(newEntities.getIndex(newObjectEntities[i])) &&
+                graph.getWorld(i) == newGraph.getWorld(i) && scene.isTranslucent(i) == newScene.isTranslucent(i)) {
+                continue;
+            }
+            if (i < objectEntities.size()) {
+                markEntityShadowsDirty(entities, objectEntities[i]);
+            }
+            if (i < newObjectEntities.size()) {
+                markEntityShadowsDirty(newEntities, newObjectEntities[i]);
+            }
+        }
+        for (size_t i = 0; i < entities.size(); i++) {
+            if (entities.getAsset(i) != INVALID_ASSET_HANDLE) {
+                assets.release(entities.getAsset(i));
+            }
+        }
+        unloadedNum = 0;
+        entities = newEntities;
+        objectEntities.swap(newObjectEntities);
+        graph = newGraph;
+        scene = newScene;
+        buildBvh();
+        watchMeshes();
+        if (usePvs) {
+            loadPvs(true);
+        }
+    };
+    // Reloads the objects using a mesh file, dirtying the shadow maps that saw them before or see them now. Their old
+    // asset is released before the file is loaded again, so its heap ranges are free for the new one. If the file
+    // does not load, its objects are left without a mesh and culled until an edit that does.
+    auto reloadMesh = [&](const std::string &path) {
+        std::vector<size_t> reloaded;
+        fileIdentity identity;
+        bool identified = assets.identify(path, identity);
+        for (size_t i = 0; i < objectEntities.size(); i++) {
+            if (scene.getMeshPath(scene.getMesh(i)) != path) {
+                continue;
+            }
+            unsigned int index = entities.getIndex(objectEntities[i]), asset = entities.getAsset(index);
+            if (asset != INVALID_ASSET_HANDLE && identified && assets.get(asset).hash == identity.hash) {
+                continue; // Touched, but the same content.
+            }
+            markEntityShadowsDirty(entities, objectEntities[i]);
+            if (asset != INVALID_ASSET_HANDLE) {
+                assets.release(asset);
+            } else {
+                unloadedNum--;
+            }
+            entities.setAsset(index, INVALID_ASSET_HANDLE);
+            reloaded.push_back(i);
+        }
+
+        std::vector<unsigned int> meshAssets(scene.getMeshNum(), INVALID_ASSET_HANDLE);
+        bool failed = false;
+        for (size_t i: reloaded) {
+            unsigned int index = entities.getIndex(objectEntities[i]);
+            unsigned int asset = failed ? INVALID_ASSET_HANDLE : acquireMesh(scene, i, &meshAssets);
+            if (asset == INVALID_ASSET_HANDLE) {
+                failed = true;
+                unloadedNum++;
+            }
+            entities.setAsset(index, asset);
+            updateBounds(graph, entities, index);
+            markEntityShadowsDirty(entities, objectEntities[i]);
+        }
+        if (failed) {
+            std::cerr << "Hiding the objects of " << path << " until it loads" << std::endl;
+        }
+        bvh.refit(entities.getBoxMins(), entities.getBoxMaxs());
+        if (usePvs) {
+            loadPvs(false);
+        }
+    };
 
     // For performance measurement.
     double lastTime = glfwGetTime();
     double currentTime;
     int nbFrames = 0;
+    unsigned int secondDrawCalls = 0;
+    size_t secondCulled = 0;
+    double secondCullTime = 0.0, secondCasterCullTime = 0.0;
+    unsigned int secondShadowRenders = 0;
+    size_t secondOccluded = 0, secondInFrustum = 0, secondOccluderTriangles = 0;
+    size_t secondPvsHidden = 0, secondPvsCandidates = 0;
+    size_t secondCommands = 0, secondStateChanges = 0;
+    glStateStats secondGLCalls = glStateStats();
+    double secondSortTime = 0.0;
+    double secondOcclusionTime = 0.0;
+    std::vector<size_t> secondOpaqueCasters, secondTranslucentCasters; // By light.
+    bool firstFrame = true;
+
+    // GPU time of the shadow and main passes over the measured frames; the first frame is left out. Frames alternate
+    // between two pairs of queries, so a frame's times are read during the next one instead of waiting for the GPU.
+    GLuint passQueries[2][2] = {{0, 0}, {0, 0}};
+    GLuint64 shadowNanoseconds = 0, mainNanoseconds = 0;
+    unsigned long long drawCallNum = 0, instanceNum = 0, culledNum = 0, casterNum = 0;
+    unsigned long long occludedNum = 0, inFrustumNum = 0, occluderTriangleNum = 0;
+    unsigned long long pvsHiddenNum = 0, pvsCandidateNum = 0;
+    unsigned long long commandNum = 0, stateChangeNum = 0;
+    unsigned long long issuedBindNum = 0, skippedBindNum = 0, issuedUniformNum = 0, skippedUniformNum = 0;
+    double sortSeconds = 0.0;
+    double cullSeconds = 0.0, casterCullSeconds = 0.0, occlusionSeconds = 0.0;
+    int frameNum = 0;
+    double measureStart = 0.0;
+    if (measuredFrames > 0) {
+        glGenQueries(4, passQueries[0]);
+        glfwSwapInterval(0); // Not limited by vertical sync.
+    }
+    auto addPassTimes = [&](int frame) {
+        GLuint64 shadowTime, mainTime;
+        glGetQueryObjectui64v(passQueries[frame % 2][0], GL_QUERY_RESULT, &shadowTime);
+        glGetQueryObjectui64v(passQueries[frame % 2][1], GL_QUERY_RESULT, &mainTime);
+        shadowNanoseconds += shadowTime;
+        mainNanoseconds += mainTime;
+    };
+
+    Renderer renderer;
+
+    // Shadow maps get their own selector: they tolerate coarser levels than the main view.
+    LodSelector viewLod(glm::radians(45.0f), HEIGHT, LOD_THRESHOLD);
+    LodSelector shadowLod(glm::radians(90.0f), SHADOW_HEIGHT, SHADOW_LOD_THRESHOLD);
+    auto makeInstance = [](const glm::mat4 &model, const glm::mat3 &normalMatrix, const sceneMaterial &material) {
+        return objectInstance{model, normalMatrix, glm::vec4(material.color, material.alpha),
+                              glm::vec4(material.ambient, material.diffuse, material.specular, material.shininess)};
+    };
+    const objectInstance planeInstance = makeInstance(planeDequantization, glm::mat3(1.0f), sceneMaterial());
+    // Queues an entity (by dense index) at its level of detail; the next flush of the stream draws it.
+    auto drawObject = [&](size_t j, const LodSelector &selector, const glm::vec3 &eye, bool depthOnly, bool ordered) {
+        const meshAsset &asset = assets.get(entities.getAsset(j));
+        const meshLod &lod = asset.lods[selector.select(asset.lods, eye, entities.getCenter(j),
+                                                        entities.getRadius(j), entities.getScale(j))];
+        unsigned int node = entities.getNode(j);
+        glm::mat4 model = graph.getWorld(node) * asset.dequantization;
+        if (depthOnly) {
+            heap.addDraw(asset.heapHandle, lod.indexOffset, lod.indexCount, &model, true, ordered);
+        } else {
+            objectInstance instance = makeInstance(model, graph.getNormal(node), entities.getMaterial(j));
+            heap.addDraw(asset.heapHandle, lod.indexOffset, lod.indexCount, &instance, false, ordered);
+        }
+    };
+    // Queues a render command for an entity; its key sorts it by pass, then state, then depth.
+    auto submitObject = [&](unsigned int pass, bool depthOnly, float depth, bool backToFront, unsigned int j) {
+        renderer.submit(Renderer::makeKey(pass, depthOnly ? DEPTH_SHADER : MAIN_SHADER, depthOnly ? 1 : 0, depth,
+                                          backToFront, assets.get(entities.getAsset(j)).heapHandle), j);
+    };
+    // What the render queue's current state draws with.
+    Shader *stateShader = nullptr;
+    const LodSelector *stateLod = &viewLod;
+    glm::vec3 stateEye(0.0f);
+    bool stateDepthOnly = false, stateOrdered = false;
 
     // Render loop.
     while (!glfwWindowShouldClose(window)) {
         // Process input for keyboard events and camera movement.
         processInput(window, cameraPos, cameraFront, cameraUp, cameraSpeed);
 
-        // 1. Render depth map.
-        glm::mat4 lightProjection = glm::perspective(glm::radians(90.0f), (GLfloat)WIDTH / HEIGHT, 5.0f, 100.0f);
-        glm::mat4 lightView; // Light source view matrix.
-        std::vector<glm::mat4> lightSpaceMatrix(lightNum); // Light space matrices.
-
-        for (size_t i = 0; i < lightNum; i++) {
-            lightView = glm::lookAt(lights.getLightPos(i), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-            lightSpaceMatrix[i] = lightProjection * lightView;
+        // 0. Apply edits to the watched files.
+        std::vector<unsigned int> changes = watcher.poll();
+        if (!changes.empty()) {
+            double reloadStart = glfwGetTime();
+            for (unsigned int change: changes) {
+                if (change == sceneWatch) {
+                    reloadScene();
+                } else if (change == lightsWatch) {
+                    Lights newLights;
+                    if (!newLights.loadLights(lightsPath)) {
+                        std::cerr << "Keeping the previous lights" << std::endl;
+                        continue;
+                    }
+                    if (newLights.getLightNum() != lightNum) {
+                        // The shader is specialised for the light count.
+                        Shader *shader = buildShader(newLights.getLightNum());
+                        if (!shader) {
+                            continue;
+                        }
+                        shaderProgram.reset(shader);
+                        shadowMaps.resize(newLights.getLightNum());
+                    } else {
+                        for (size_t i = 0; i < lightNum; i++) {
+                            if (newLights.getLightPos(i) != lights.getLightPos(i)) {
+                                shadowMaps.markDirty(i);
+                            }
+                        }
+                    }
+                    lights = newLights;
+                    lightNum = lights.getLightNum();
+                    updateLightSpaceMatrices();
+                } else {
+                    for (size_t m = 0; m < meshWatches.size(); m++) {
+                        if (change == meshWatches[m]) {
+                            reloadMesh(watchedMeshes[m]);
+                        }
+                    }
+                }
+            }
+            unsigned int dirtyNum = 0;
+            for (size_t i = 0; i < lightNum; i++) {
+                dirtyNum += shadowMaps.isDirty(i);
+            }
+            printf("Reloaded in %.1lf ms; %u of %u shadow maps to re-render\n", 1000.0 * (glfwGetTime() - reloadStart),
+                   dirtyNum, lightNum);
+            printAssetStats();
+            printHeapStats();
+        }
 
-            depthShaderProgram.bind();
-            depthShaderProgram.setUniformMatrix4fv("lightSpaceMatrix", 1, GL_FALSE, lightSpaceMatrix[i]);
-            depthShaderProgram.setUniformMatrix4fv("model", 1, GL_FALSE, glm::mat4(1.0f));
+        // 1. Cull the main view: only the entities in its frustum that the camera's cell may see and that no
+        // occluder hides are drawn, split by pass.
+        glm::mat4 view = glm::lookAt(cameraPos, cameraPos + cameraFront, cameraUp);
+        glm::mat4 projection = glm::perspective(glm::radians(45.0f), (GLfloat)WIDTH / HEIGHT, 0.1f, 200.0f);
+        double cullStart = glfwGetTime();
+        visibleObjects.clear();
+        bvh.cull(Frustum(projection * view), visibleObjects);
+        dropUnloaded(visibleObjects);
+        double cullTime = glfwGetTime() - cullStart;
+        size_t culled = entities.size() - visibleObjects.size();
+        secondCullTime += cullTime;
+        secondCulled += culled;
+
+        // Outside the PVS's cells everything in the frustum is kept.
+        size_t pvsCandidates = visibleObjects.size(), pvsHidden = 0;
+        int cell = pvs.findCell(cameraPos);
+        if (cell >= 0) {
+            if (cell != pvsCell) {
+                pvs.decode(cell, pvsVisible);
+                pvsCell = cell;
+            }
+            visibleObjects.erase(std::remove_if(visibleObjects.begin(), visibleObjects.end(), [&](unsigned int j) {
+                return !pvsVisible[entities.getNode(j)];
+            }), visibleObjects.end());
+            pvsHidden = pvsCandidates - visibleObjects.size();
+            secondPvsHidden += pvsHidden;
+            secondPvsCandidates += pvsCandidates;
+        }
 
-            glViewport(0, 0, SHADOW_WIDTH, SHADOW_HEIGHT);
-            glClear(GL_DEPTH_BUFFER_BIT);
+        const unsigned char *flags = entities.getFlagArray();
+        const glm::vec3 *boxMins = entities.getBoxMins(), *boxMaxs = entities.getBoxMaxs();
+        double occlusionStart = glfwGetTime();
+        size_t inFrustum = visibleObjects.size(), occluded = 0, occluderTriangles = 0;
+        if (occlusionCulling) {
+            occlusion.begin(projection * view);
+            bool hasOccluders = false;
+            for (unsigned int j: visibleObjects) {
+                if (flags[j] & ENTITY_OCCLUDER) {
+                    const MeshCache &mesh = *assets.get(entities.getAsset(j)).cache;
+                    const meshLod &full = mesh.getLod(0);
+                    const glm::mat4 &world = graph.getWorld(entities.getNode(j));
+                    if (mesh.getIndexSize() == 2) {
+                        occlusion.addOccluder(world, mesh.getPositions(), mesh.getVertexCount(),
+                                              (const unsigned short *) mesh.getIndices() + full.indexOffset,
+                                              full.indexCount);
+                    } else {
+                        occlusion.addOccluder(world, mesh.getPositions(), mesh.getVertexCount(),
+                                              (const unsigned int *) mesh.getIndices() + full.indexOffset,
+                                              full.indexCount);
+                    }
+                    hasOccluders = true;
+                }
+            }
+            if (hasOccluders) {
+                occlusion.rasterize();
+                occluded = occlusion.cull(visibleObjects, boxMins, boxMaxs);
+                occluderTriangles = occlusion.getTriangleNum();
+            }
+        }
+        double occlusionTime = glfwGetTime() - occlusionStart;
+        secondOcclusionTime += occlusionTime;
+        secondOccluded += occluded;
+        secondInFrustum += inFrustum;
+        secondOccluderTriangles += occluderTriangles;
+
+        visibleOpaque.clear();
+        visibleTranslucent.clear();
+        for (unsigned int j: visibleObjects) {
+            (flags[j] & ENTITY_TRANSLUCENT ? visibleTranslucent : visibleOpaque).push_back(j);
+        }
 
-            // Render scene to opaque objects' depth map.
-            opDepthMapFB[i].bind();
-            planeVA.bind(0);
-            glDrawArrays(GL_TRIANGLES, 0, 6);
+        // The receivers' box: the visible objects and the part of the plane within the view frustum's box.
+        double casterCullStart = glfwGetTime();
+        glm::vec3 receiverMin(FLT_MAX), receiverMax(-FLT_MAX);
+        for (unsigned int j: visibleObjects) {
+            receiverMin = glm::min(receiverMin, boxMins[j]);
+            receiverMax = glm::max(receiverMax, boxMaxs[j]);
+        }
+        glm::mat4 inverseViewProjection = glm::inverse(projection * view);
+        glm::vec3 viewMin(FLT_MAX), viewMax(-FLT_MAX);
+        for (int corner = 0; corner < 8; corner++) {
+            glm::vec4 point = inverseViewProjection * glm::vec4(corner & 1 ? 1.0f : -1.0f, corner & 2 ? 1.0f : -1.0f,
+                                                                corner & 4 ? 1.0f : -1.0f, 1.0f);
+            viewMin = glm::min(viewMin, glm::vec3(point) / point.w);
+            viewMax = glm::max(viewMax, glm::vec3(point) / point.w);
+        }
+        glm::vec3 planeMin = glm::max(viewMin, planeBoundsMin);
+        glm::vec3 planeMax = glm::min(viewMax, planeBoundsMax);
+        if (planeMin.x <= planeMax.x && planeMin.y <= planeMax.y && planeMin.z <= planeMax.z) {
+            receiverMin = glm::min(receiverMin, planeMin);
+            receiverMax = glm::max(receiverMax, planeMax);
+        }
+        double casterCullTime = glfwGetTime() - casterCullStart;
 
-            for (size_t j = 0; j < OP_OBJ_NUM; ++j) {
-                opVA.bind(j);
-                glDrawArrays(GL_TRIANGLES, 0, vertexCounts[j]);
+        // 2. Queue the depth maps of the lights whose maps are out of date or lack a caster the view needs. A light's
+        // casters are the entities in its frustum cropped to the receivers; the others shadow nothing visible.
+        if (measuredFrames > 0) {
+            for (size_t i = 0; i < lightNum; i++) {
+                shadowMaps.markDirty(i);
+            }
+            glBeginQuery(GL_TIME_ELAPSED, passQueries[frameNum % 2][0]);
+        }
+        secondOpaqueCasters.resize(lightNum, 0);
+        secondTranslucentCasters.resize(lightNum, 0);
+        for (size_t i = 0; i < lightNum; i++) {
+            casterCullStart = glfwGetTime();
+            casters.clear();
+            glm::mat4 cropped;
+            if (ShadowMaps::cropToReceivers(lightSpaceMatrix[i], receiverMin, receiverMax, cropped)) {
+                bvh.cull(Frustum(cropped), casters);
+                dropUnloaded(casters);
+            }
+            opaqueCasters.clear();
+            translucentCasters.clear();
+            for (unsigned int j: casters) {
+                (flags[j] & ENTITY_TRANSLUCENT ? translucentCasters : opaqueCasters).push_back(j);
+            }
+            casterCullTime += glfwGetTime() - casterCullStart;
+            secondOpaqueCasters[i] += opaqueCasters.size();
+            secondTranslucentCasters[i] += translucentCasters.size();
+            casterNum += frameNum > 0 ? casters.size() : 0;
+            if (!shadowMaps.isDirty(i) && !shadowMaps.missesCasters(i, casters)) {
+                continue;
             }
-            opDepthMapFB[i].unbind();
-
 
-            // Render scene to translucent objects' depth map.
-            transDepthMapFB[i].bind();
-            for (size_t j = OP_OBJ_NUM; j < OP_OBJ_NUM + TRANS_OBJ_NUM; ++j) {
-                transVA.bind(j - OP_OBJ_NUM);
-                glDrawArrays(GL_TRIANGLES, 0, vertexCounts[j]);
+            // Queue the plane and the opaque casters front to back from the light, then the translucent casters.
+            glm::vec3 light = lights.getLightPos(i);
+            unsigned int opaquePass = 2 * i, translucentPass = 2 * i + 1;
+            renderer.submit(Renderer::makeKey(opaquePass, DEPTH_SHADER, 1, 0.0f, false, planeHandle), PLANE_COMMAND);
+            for (unsigned int j: opaqueCasters) {
+                submitObject(opaquePass, true, glm::distance(entities.getCenter(j), light), false, j);
             }
-            transDepthMapFB[i].unbind();
+            renderer.submit(Renderer::makeKey(translucentPass, DEPTH_SHADER, 1, 0.0f, false, 0), CLEAR_COMMAND);
+            for (unsigned int j: translucentCasters) {
+                submitObject(translucentPass, true, glm::distance(entities.getCenter(j), light), false, j);
+            }
+            shadowMaps.markClean(i, casters);
+            secondShadowRenders++;
+        }
+        secondCasterCullTime += casterCullTime;
+
+        // 3. Queue the main view: the plane and the opaque objects front to back, so early depth tests reject what
+        // they cover, then the translucent ones back to front, for blending.
+        glm::vec3 forward = glm::normalize(cameraFront);
+        renderer.submit(Renderer::makeKey(MAIN_OPAQUE_PASS, MAIN_SHADER, 0, 0.0f, false, planeHandle), PLANE_COMMAND);
+        for (unsigned int j: visibleOpaque) {
+            submitObject(MAIN_OPAQUE_PASS, false, glm::dot(entities.getCenter(j) - cameraPos, forward), false, j);
+        }
+        for (unsigned int j: visibleTranslucent) {
+            submitObject(MAIN_TRANSLUCENT_PASS, false, glm::dot(entities.getCenter(j) - cameraPos, forward), true, j);
         }
 
-        depthShaderProgram.unbind();
+        // 4. Sort the queue and run it: each state binds its target and shader and sets their uniforms, its draws
+        // are queued in the heap in key order, and the heap draws them when the state ends.
+        auto beginState = [&](uint64_t key) {
+            unsigned int pass = Renderer::getPass(key);
+            if (pass < MAIN_OPAQUE_PASS) {
+                unsigned int light = pass / 2;
+                depthShaderProgram.bind();
+                depthShaderProgram.setUniformMatrix4fv("lightSpaceMatrix", 1, GL_FALSE, lightSpaceMatrix[light]);
+                if (pass % 2 == 0) {
+                    shadowMaps.bindOpaque(light);
+                } else {
+                    shadowMaps.bindTranslucent(light);
+                }
+                stateShader = &depthShaderProgram;
+                stateLod = &shadowLod;
+                stateEye = lights.getLightPos(light);
+                stateDepthOnly = true;
+                stateOrdered = false;
+                return;
+            }
+            stateShader = shaderProgram.get();
+            stateLod = &viewLod;
+            stateEye = cameraPos;
+            stateDepthOnly = false;
+            stateOrdered = pass == MAIN_TRANSLUCENT_PASS;
+            if (pass == MAIN_TRANSLUCENT_PASS) {
+                // Translucent models (after opaque ones).
+                shaderProgram->setUniform1f("flag", true);
+                return;
+            }
+
+            depthShaderProgram.unbind();
+            if (measuredFrames > 0) {
+                glEndQuery(GL_TIME_ELAPSED);
+                glBeginQuery(GL_TIME_ELAPSED, passQueries[frameNum % 2][1]);
+            }
 
-        // Reset viewport. Optimized for Retina screens.
+            // Reset viewport. Optimized for Retina screens.
 #ifdef __APPLE__
-        glViewport(0, 0, 2 * WIDTH, 2 * HEIGHT); // For MacOS.
+            glState().viewport(0, 0, 2 * WIDTH, 2 * HEIGHT); // For MacOS.
 #else
-        glViewport(0, 0, WIDTH, HEIGHT);
+            glState().viewport(0, 0, WIDTH, HEIGHT);
 #endif
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-        // 2. Render scene with shadows.
-        glm::mat4 view = glm::lookAt(cameraPos, cameraPos + cameraFront, cameraUp);
-        glm::mat4 projection = glm::perspective(glm::radians(45.0f), (GLfloat)WIDTH / HEIGHT, 0.1f, 200.0f);
-
-        shaderProgram.bind();
-        shaderProgram.setUniformMatrix4fv("view", 1, GL_FALSE, view);
-        shaderProgram.setUniformMatrix4fv("projection", 1, GL_FALSE, projection);
-
-        // Set light and view positions.
-        for (size_t i = 0; i < lightNum; ++i) {
-            glm::vec3 light = lights.getLightPos(i);
-            shaderProgram.setUniformMatrix4fv("lightSpaceMatrix[" + std::to_string(i) + "]", 1, GL_FALSE,
-                                              lightSpaceMatrix[i]);
-            shaderProgram.setUniform3f("lightPos[" + std::to_string(i) + "]", light.x, light.y, light.z);
-            shaderProgram.setUniform3f("lightColor[" + std::to_string(i) + "]", LIGHT_COLOR);
-        }
-        shaderProgram.setUniform3f("viewPos", cameraPos.x, cameraPos.y, cameraPos.z);
-        shaderProgram.setUniform3f("objectColor", OBJECT_COLOR);
-
-        // Set material properties
-        shaderProgram.setUniform1f("ambientStrength", AMBIENT_STRENGTH);
-        shaderProgram.setUniform1f("specularStrength", SPECULAR_STRENGTH);
-        shaderProgram.setUniform1f("diffuseStrength", DIFFUSE_STRENGTH);
-        shaderProgram.setUniform1f("alpha", ALPHA);
-//        shaderProgram.setUniform1f("refractionRatio", 1.0f / 1.33f);
-
-        // Set attenuation parameters.
-        shaderProgram.setUniform1f("att_a", A);
-        shaderProgram.setUniform1f("att_b", B);
-        shaderProgram.setUniform1f("att_c", C);
-        shaderProgram.setUniform1i("n", N);
-
-        // 3. Bind depth maps.
-        size_t slot = 0;
-        for (size_t i = 0; i < lightNum; i++) {
-            glActiveTexture(GL_TEXTURE0 + slot);
-            glBindTexture(GL_TEXTURE_2D, opDepthMap.getID(i));
-            shaderProgram.setUniform1i("opShadowMap[" + std::to_string(i) + "]", slot++);
-
-            glActiveTexture(GL_TEXTURE0 + slot);
-            glBindTexture(GL_TEXTURE_2D, transDepthMap.getID(i));
-            shaderProgram.setUniform1i("transShadowMap[" + std::to_string(i) + "]", slot++);
-        }
-
-        // 4. Draw plane.
-        shaderProgram.setUniformMatrix4fv("model", 1, GL_FALSE, glm::mat4(1.0f));
-        shaderProgram.setUniform1f("flag", false);
-        Renderer renderer;
-        renderer.draw(planeVA, ib, shaderProgram);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+            // Render scene with shadows.
+            shaderProgram->bind();
+            shaderProgram->setUniformMatrix4fv("view", 1, GL_FALSE, view);
+            shaderProgram->setUniformMatrix4fv("projection", 1, GL_FALSE, projection);
+
+            // Set light and view positions.
+            for (size_t i = 0; i < lightNum; ++i) {
+                glm::vec3 light = lights.getLightPos(i);
+                shaderProgram->setUniformMatrix4fv("lightSpaceMatrix[" + std::to_string(i) + "]", 1, GL_FALSE,
+                                                  lightSpaceMatrix[i]);
+                shaderProgram->setUniform3f("lightPos[" + std::to_string(i) + "]", light.x, light.y, light.z);
+                shaderProgram->setUniform3f("lightColor[" + std::to_string(i) + "]", LIGHT_COLOR);
+            }
+            shaderProgram->setUniform3f("viewPos", cameraPos.x, cameraPos.y, cameraPos.z);
+//            shaderProgram->setUniform1f("refractionRatio", 1.0f / 1.33f);
+
+            // Set attenuation parameters.
+            shaderProgram->setUniform1f("att_a", A);
+            shaderProgram->setUniform1f("att_b", B);
+            shaderProgram->setUniform1f("att_c", C);
+
+            // Bind depth maps.
+            size_t slot = 0;
+            for (size_t i = 0; i < lightNum; i++) {
+                glState().bindTexture(slot, shadowMaps.getOpaqueMap(i));
+                shaderProgram->setUniform1i("opShadowMap[" + std::to_string(i) + "]", slot++);
+
+                glState().bindTexture(slot, shadowMaps.getTranslucentMap(i));
+                shaderProgram->setUniform1i("transShadowMap[" + std::to_string(i) + "]", slot++);
+            }
 
-        // 5. Draw opaque models.
-        for (size_t i = 0; i < OP_OBJ_NUM; ++i) {
-            opVA.bind(i);
-            glDrawArrays(GL_TRIANGLES, 0, vertexCounts[i]);
-        }
+            // The plane, with the default material, and opaque models.
+            shaderProgram->setUniform1f("flag", false);
+        };
+        auto draw = [&](unsigned int payload) {
+            if (payload == PLANE_COMMAND) {
+                heap.addDraw(planeHandle, 0, planeIndexNum,
+                             stateDepthOnly ? (const void *) &planeInstance.model : &planeInstance, stateDepthOnly);
+            } else if (payload != CLEAR_COMMAND) {
+                drawObject(payload, *stateLod, stateEye, stateDepthOnly, stateOrdered);
+            }
+        };
+        auto endState = [&](uint64_t key) {
+            heap.flush(renderer, *stateShader, stateDepthOnly);
+            if (Renderer::getPass(key) < MAIN_OPAQUE_PASS) {
+                shadowMaps.unbind();
+            }
+        };
+        renderer.execute(beginState, draw, endState);
 
-        // 6. Draw translucent models (after opaque ones).
-        shaderProgram.setUniform1f("flag", true);
-        for (size_t i = OP_OBJ_NUM; i < OP_OBJ_NUM + TRANS_OBJ_NUM; ++i) {
-            transVA.bind(i - OP_OBJ_NUM);
-            glDrawArrays(GL_TRIANGLES, 0, vertexCounts[i]);
+        shaderProgram->unbind();
+        if (measuredFrames > 0) {
+            glEndQuery(GL_TIME_ELAPSED);
         }
 
-        shaderProgram.unbind();
-
         // Swap buffers and poll IO events.
         glfwSwapBuffers(window);
         glfwPollEvents();
+        if (firstFrame) {
+            glFinish();
+            printf("First frame after %.1lf ms\n", 1000.0 * glfwGetTime());
+            firstFrame = false;
+        }
+        heapDrawStats draws = heap.takeDrawStats();
+        secondDrawCalls += draws.drawCallNum;
+        renderQueueStats queue = renderer.takeQueueStats();
+        secondCommands += queue.commandNum;
+        secondStateChanges += queue.stateChangeNum;
+        secondSortTime += queue.sortSeconds;
+        glStateStats calls = glState().takeStats();
+        secondGLCalls.issuedBinds += calls.issuedBinds;
+        secondGLCalls.skippedBinds += calls.skippedBinds;
+        secondGLCalls.issuedUniforms += calls.issuedUniforms;
+        secondGLCalls.skippedUniforms += calls.skippedUniforms;
+        if (measuredFrames > 0) {
+            if (frameNum >= 2) {
+                addPassTimes(frameNum - 1);
+            }
+            if (frameNum++ == 0) {
+                measureStart = glfwGetTime();
+            } else {
+                drawCallNum += draws.drawCallNum;
+                instanceNum += draws.instanceNum;
+                culledNum += culled;
+                cullSeconds += cullTime;
+                casterCullSeconds += casterCullTime;
+                occludedNum += occluded;
+                inFrustumNum += inFrustum;
+                occluderTriangleNum += occluderTriangles;
+                occlusionSeconds += occlusionTime;
+                pvsHiddenNum += pvsHidden;
+                pvsCandidateNum += cell >= 0 ? pvsCandidates : 0;
+                commandNum += queue.commandNum;
+                stateChangeNum += queue.stateChangeNum;
+                sortSeconds += queue.sortSeconds;
+                issuedBindNum += calls.issuedBinds;
+                skippedBindNum += calls.skippedBinds;
+                issuedUniformNum += calls.issuedUniforms;
+                skippedUniformNum += calls.skippedUniforms;
+            }
+            if (frameNum > measuredFrames) {
+                addPassTimes(measuredFrames); // Only the last frame's times are waited for.
+                printf("Measured %d frames, %zu objects, %u lights: %.3lf ms/frame; shadow passes %.3lf ms, main "
+                       "pass %.3lf ms; %.1lf draw calls for %.0lf instances per frame; %.0lf objects culled in "
+                       "%.3lf ms per frame\n", measuredFrames, entities.size(), lightNum,
+                       1000.0 * (glfwGetTime() - measureStart) / measuredFrames,
+                       shadowNanoseconds / 1e6 / measuredFrames, mainNanoseconds / 1e6 / measuredFrames,
+                       double(drawCallNum) / measuredFrames, double(instanceNum) / measuredFrames,
+                       double(culledNum) / measuredFrames, 1000.0 * cullSeconds / measuredFrames);
+                printf("Shadow casters: %.0lf per light of %zu objects, culled in %.3lf ms per frame\n",
+                       lightNum ? double(casterNum) / measuredFrames / lightNum : 0.0, entities.size(),
+                       1000.0 * casterCullSeconds / measuredFrames);
+                printf("Occlusion: %.0lf of %.0lf objects in the view frustum hidden (%.1lf%%) by %.0lf occluder "
+                       "triangles in %.3lf ms per frame\n", double(occludedNum) / measuredFrames,
+                       double(inFrustumNum) / measuredFrames, inFrustumNum ? 100.0 * occludedNum / inFrustumNum : 0.0,
+                       double(occluderTriangleNum) / measuredFrames, 1000.0 * occlusionSeconds / measuredFrames);
+                printf("Render queue: %.0lf commands in %.1lf states per frame, sorted in %.3lf ms per frame\n",
+                       double(commandNum) / measuredFrames, double(stateChangeNum) / measuredFrames,
+                       1000.0 * sortSeconds / measuredFrames);
+                printf("GL state: %.1lf binds issued, %.1lf skipped; %.1lf uniform writes issued, %.1lf skipped per "
+                       "frame\n", double(issuedBindNum) / measuredFrames, double(skippedBindNum) / measuredFrames,
+                       double(issuedUniformNum) / measuredFrames, double(skippedUniformNum) / measuredFrames);
+                if (pvs.isOpen()) {
+                    printf("PVS: %.0lf of %.0lf objects in the view frustum outside the camera cell's set (%.1lf%%)"
+                           "\n", double(pvsHiddenNum) / measuredFrames, double(pvsCandidateNum) / measuredFrames,
+                           pvsCandidateNum ? 100.0 * pvsHiddenNum / pvsCandidateNum : 0.0);
+                }
+                break;
+            }
+        }
 
         // Performance measurement.
         nbFrames++;
         currentTime = glfwGetTime();
         if (currentTime - lastTime >= 1.0) {
-            printf("%lf ms/frame; %.1lf frames/sec\n", 1000.0 * (currentTime - lastTime) / double(nbFrames), \
-                    double(nbFrames) / (currentTime - lastTime));
+            printf("%lf ms/frame; %.1lf frames/sec; %.1lf draw calls/frame; %.0lf of %zu objects culled in %.3lf "
+                   "ms/frame\n", 1000.0 * (currentTime - lastTime) / double(nbFrames),
+                   double(nbFrames) / (currentTime - lastTime), double(secondDrawCalls) / nbFrames,
+                   double(secondCulled) / nbFrames, entities.size(), 1000.0 * secondCullTime / nbFrames);
+            printf("Shadow casters per light (opaque + translucent):");
+            for (size_t i = 0; i < lightNum; i++) {
+                printf("%s %.0lf + %.0lf", i ? "," : "", double(secondOpaqueCasters[i]) / nbFrames,
+                       double(secondTranslucentCasters[i]) / nbFrames);
+            }
+            printf("; %.1lf maps re-rendered/frame; culled in %.3lf ms/frame\n",
+                   double(secondShadowRenders) / nbFrames, 1000.0 * secondCasterCullTime / nbFrames);
+            if (secondOccluderTriangles > 0) {
+                printf("Occlusion: %.0lf of %.0lf objects in the view frustum hidden (%.1lf%%) by %.0lf occluder "
+                       "triangles in %.3lf ms/frame\n", double(secondOccluded) / nbFrames,
+                       double(secondInFrustum) / nbFrames, 100.0 * secondOccluded / secondInFrustum,
+                       double(secondOccluderTriangles) / nbFrames, 1000.0 * secondOcclusionTime / nbFrames);
+            }
+            printf("Render queue: %.0lf commands in %.1lf states/frame, sorted in %.3lf ms/frame\n",
+                   double(secondCommands) / nbFrames, double(secondStateChanges) / nbFrames,
+                   1000.0 * secondSortTime / nbFrames);
+            printf("GL state: %.1lf binds issued, %.1lf skipped; %.1lf uniform writes issued, %.1lf skipped "
+                   "per frame\n", double(secondGLCalls.issuedBinds) / nbFrames,
+                   double(secondGLCalls.skippedBinds) / nbFrames, double(secondGLCalls.issuedUniforms) / nbFrames,
+                   double(secondGLCalls.skippedUniforms) / nbFrames);
+            if (secondPvsCandidates > 0) {
+                printf("PVS: %.0lf of %.0lf objects in the view frustum outside cell %d's set (%.1lf%%)\n",
+                       double(secondPvsHidden) / nbFrames, double(secondPvsCandidates) / nbFrames, pvsCell,
+                       100.0 * secondPvsHidden / secondPvsCandidates);
+            }
             nbFrames = 0;
+            secondDrawCalls = 0;
+            secondCulled = 0;
+            secondCullTime = 0.0;
+            secondCasterCullTime = 0.0;
+            secondShadowRenders = 0;
+            secondOccluded = 0;
+            secondInFrustum = 0;
+            secondOccluderTriangles = 0;
+            secondOcclusionTime = 0.0;
+            secondPvsHidden = 0;
+            secondPvsCandidates = 0;
+            secondCommands = 0;
+            secondStateChanges = 0;
+            secondSortTime = 0.0;
+            secondGLCalls = glStateStats();
+            secondOpaqueCasters.assign(lightNum, 0);
+            secondTranslucentCasters.assign(lightNum, 0);
             lastTime = glfwGetTime();
         }
     }
 
+    if (measuredFrames > 0) {
+        glDeleteQueries(4, passQueries[0]);
+    }
     glfwTerminate();
     return 0;
 }
@@ -0,0 +1,398 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <random>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include <unordered_map>
+#include <cstdio>
+#include <cstdlib>
+#include <cfloat>
+#include <cmath>
+#include "glm/glm.hpp"
+#include "Scene.h"
+#include "SceneGraph.h"
+#include "ObjParser.h"
+#include "Pvs.h"
+#include "MeshCache.h"
+
+#define SCENE_FILE "../res/objects/scene.txt"
+#define PVS_FILE "../res/objects/scene.pvs"
+#define PVS_CELL_SIZE 10.0f
+#define PVS_SAMPLES 64      // Rays per cell and object before the object counts as hidden from the cell.
+#define PVS_MIN_HEIGHT 0.5f // The band the camera moves in: from just above the ground to above the tallest object.
+#define PVS_HEADROOM 2.0f
+#define PVS_FAR 200.0f      // App's far plane: objects farther from every point of a cell are never drawn from it.
+#define RAY_LEAF_SIZE 4     // Triangles per leaf of the ray-casting hierarchy.
+#define RAY_STACK_SIZE 64
+
+// A world-space triangle and the object it belongs to.
+struct bakeTriangle {
+    glm::vec3 a, b, c;
+    unsigned int object;
+};
+
+struct rayNode {
+    glm::vec3 min, max;
+    unsigned int first; // Leaves: the first triangle. Inner nodes: the second child; the first follows the node.
+    unsigned int count; // Triangles in a leaf, 0 for inner nodes.
+};
+
+// A binary bounding volume hierarchy over the blocking triangles, for visibility ray casts.
+class TriangleBvh {
+private:
+    std::vector<rayNode> m_nodes;
+    std::vector<bakeTriangle> m_triangles;
+    std::vector<glm::vec3> m_centroids;
+public:
+    explicit TriangleBvh(std::vector<bakeTriangle> triangles) : m_triangles(std::move(triangles)) {
+        for (const auto &triangle: m_triangles) {
+            m_centroids.push_back((triangle.a + triangle.b + triangle.c) / 3.0f);
+        }
+        if (!m_triangles.empty()) {
+            build(0, m_triangles.size());
+        }
+    }
+
+    // Whether a triangle of another object than the one ignored crosses the ray from origin along direction
+    // before maxT. Any such hit will do, so the walk stops at the first.
+    bool isBlocked(const glm::vec3 &origin, const glm::vec3 &direction, float maxT, unsigned int ignored) const {
+        if (m_nodes.empty()) {
+            return false;
+        }
+        glm::vec3 inverse(1.0f / direction.x, 1.0f / direction.y, 1.0f / direction.z);
+        unsigned int stack[RAY_STACK_SIZE];
+        int top = 0;
+        stack[0] = 0;
+        while (top >= 0) {
+            const rayNode &node = m_nodes[stack[top--]];
+            if (!hitsBox(node, origin, inverse, maxT)) {
+                continue;
+            }
+            if (node.count == 0) {
+                stack[++top] = node.first;
+                stack[++top] = &node - m_nodes.data() + 1;
+                continue;
+            }
+            for (unsigned int i = node.first; i < node.first + node.count; i++) {
+                float t;
+                if (m_triangles[i].object != ignored && hitsTriangle(m_triangles[i], origin, direction, t) &&
+                    t < maxT) {
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+private:
+    unsigned int build(unsigned int first, unsigned int count) {
+        unsigned int index = m_nodes.size();
+        m_nodes.push_back({glm::vec3(FLT_MAX), glm::vec3(-FLT_MAX), first, count});
+        glm::vec3 centroidMin(FLT_MAX), centroidMax(-FLT_MAX);
+        for (unsigned int i = first; i < first + count; i++) {
+            const bakeTriangle &triangle = m_triangles[i];
+            m_nodes[index].min = glm::min(m_nodes[index].min, glm::min(triangle.a, glm::min(triangle.b, triangle.c)));
+            m_nodes[index].max = glm::max(m_nodes[index].max, glm::max(triangle.a, glm::max(triangle.b, triangle.c)));
+            centroidMin = glm::min(centroidMin, m_centroids[i]);
+            centroidMax = glm::max(centroidMax, m_centroids[i]);
+        }
+        if (count <= RAY_LEAF_SIZE) {
+            return index;
+        }
+
+        // Median split along the longest centroid axis; triangles and centroids are sorted together.
+        glm::vec3 extent = centroidMax - centroidMin;
+        int axis = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2);
+        std::vector<unsigned int> order(count);
+        for (unsigned int i = 0; i < count; i++) {
+            order[i] = first + i;
+        }
+        unsigned int half = count / 2;
+        std::nth_element(order.begin(), order.begin() + half, order.end(), [this, axis](unsigned int a,
+                                                                                         unsigned int b) {
+            return m_centroids[a][axis] < m_centroids[b][axis];
+        });
+        std::vector<bakeTriangle> triangles(count);
+        std::vector<glm::vec3> centroids(count);
+        for (unsigned int i = 0; i < count; i++) {
+            triangles[i] = m_triangles[order[i]];
+            centroids[i] = m_centroids[order[i]];
+        }
+        std::copy(triangles.begin(), triangles.end(), m_triangles.begin() + first);
+        std::copy(centroids.begin(), centroids.end(), m_centroids.begin() + first);
+
+        build(first, half);
+        unsigned int second = build(first + half, count - half);
+        m_nodes[index].first = second;
+        m_nodes[index].count = 0;
+        return index;
+    }
+
+    static bool hitsBox(const rayNode &node, const glm::vec3 &origin, const glm::vec3 &inverse, float maxT) {
+        glm::vec3 t0 = (node.min - origin) * inverse, t1 = (node.max - origin) * inverse;
+        glm::vec3 near = glm::min(t0, t1), far = glm::max(t0, t1);
+        float enter = std::max(std::max(near.x, near.y), std::max(near.z, 0.0f));
+        float exit = std::min(std::min(far.x, far.y), std::min(far.z, maxT));
+        return enter <= exit;
+    }
+
+    // Moller-Trumbore, either side.
+    static bool hitsTriangle(const bakeTriangle &triangle, const glm::vec3 &origin, const glm::vec3 &direction,
+                             float &t) {
+        glm::vec3 edge1 = triangle.b - triangle.a, edge2 = triangle.c - triangle.a;
+        glm::vec3 p = glm::cross(direction, edge2);
+        float determinant = glm::dot(edge1, p);
+        if (std::fabs(determinant) < 1e-12f) {
+            return false;
+        }
+        float inverse = 1.0f / determinant;
+        glm::vec3 s = origin - triangle.a;
+        float u = glm::dot(s, p) * inverse;
+        if (u < 0.0f || u > 1.0f) {
+            return false;
+        }
+        glm::vec3 q = glm::cross(s, edge1);
+        float v = glm::dot(direction, q) * inverse;
+        if (v < 0.0f || u + v > 1.0f) {
+            return false;
+        }
+        t = glm::dot(edge2, q) * inverse;
+        return t > 0.0f;
+    }
+};
+
+// An object's world-space triangles, with their running areas for picking points uniformly on its surface.
+struct bakeObject {
+    std::vector<bakeTriangle> triangles;
+    std::vector<float> areas; // Cumulative.
+    glm::vec3 min, max;
+};
+
+// A side of a cell, at a coordinate along an axis.
+struct cellFace {
+    int axis;
+    float at;
+    float area; // Running total over the sides gathered so far.
+};
+
+// Distance between two boxes; 0 when they overlap.
+static float boxDistance(const glm::vec3 &minA, const glm::vec3 &maxA, const glm::vec3 &minB, const glm::vec3 &maxB) {
+    glm::vec3 gap = glm::max(glm::vec3(0.0f), glm::max(minA - maxB, minB - maxA));
+    return glm::length(gap);
+}
+
+static bool loadObjects(const Scene &scene, std::vector<bakeObject> &objects) {
+    SceneGraph graph;
+    graph.reserve(scene.getObjectNum());
+    for (size_t i = 0; i < scene.getObjectNum(); i++) {
+        unsigned int parent = scene.getParent(i);
+        graph.add(parent == SCENE_ROOT ? INVALID_NODE : parent, scene.getPosition(i),
+                  SceneGraph::eulerRotation(scene.getRotation(i)), scene.getScale(i));
+    }
+    graph.update();
+
+    ObjParser parser;
+    std::vector<objData> meshes(scene.getMeshNum());
+    for (size_t m = 0; m < scene.getMeshNum(); m++) {
+        if (!parser.parse(scene.getMeshPath(m), meshes[m])) {
+            std::cerr << parser.getError() << std::endl;
+            return false;
+        }
+    }
+
+    objects.resize(scene.getObjectNum());
+    for (size_t i = 0; i < scene.getObjectNum(); i++) {
+        const objData &mesh = meshes[scene.getMesh(i)];
+        const glm::mat4 &world = graph.getWorld(i);
+        bakeObject &object = objects[i];
+        object.min = glm::vec3(FLT_MAX);
+        object.max = glm::vec3(-FLT_MAX);
+        float area = 0.0f;
+        for (size_t c = 0; c + 2 < mesh.corners.size(); c += 3) {
+            glm::vec3 corners[3];
+            for (int k = 0; k < 3; k++) {
+                const float *p = &mesh.positions[3 * mesh.corners[c + k].position];
+                corners[k] = glm::vec3(world * glm::vec4(p[0], p[1], p[2], 1.0f));
+                object.min = glm::min(object.min, corners[k]);
+                object.max = glm::max(object.max, corners[k]);
+            }
+            object.triangles.push_back({corners[0], corners[1], corners[2], (unsigned int) i});
+            area += 0.5f * glm::length(glm::cross(corners[1] - corners[0], corners[2] - corners[0]));
+            object.areas.push_back(area);
+        }
+    }
+    return true;
+}
+
+int main(int argc, char **argv) {
+    std::string scenePath = SCENE_FILE, pvsPath = PVS_FILE;
+    float cellSize = PVS_CELL_SIZE;
+    unsigned int samples = PVS_SAMPLES, threadNum = std::max(1u, std::thread::hardware_concurrency());
+    bool valid = true;
+    for (int i = 1; valid && i < argc; i++) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--scene" && hasValue) {
+            scenePath = argv[++i];
+        } else if (arg == "--out" && hasValue) {
+            pvsPath = argv[++i];
+        } else if (arg == "--cell" && hasValue) {
+            cellSize = std::atof(argv[++i]);
+            valid = cellSize > 0.0f;
+        } else if (arg == "--samples" && hasValue) {
+            samples = std::atoi(argv[++i]);
+            valid = samples > 0;
+        } else if (arg == "--threads" && hasValue) {
+            threadNum = std::atoi(argv[++i]);
+            valid = threadNum > 0;
+        } else {
+            valid = false;
+        }
+    }
+    if (!valid) {
+        std::cerr << "Usage: " << argv[0] << " [--scene file] [--out file] [--cell size] [--samples n] "
+                  << "[--threads n]\nBakes which objects of a static scene can be seen from each cell of the space "
+                  << "above the ground, for App --pvs." << std::endl;
+        return -1;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    Scene scene;
+    if (!scene.load(scenePath)) {
+        std::cerr << scene.getError() << std::endl;
+        return -1;
+    }
+    std::vector<bakeObject> objects;
+    if (!loadObjects(scene, objects)) {
+        return -1;
+    }
+
+    // Opaque objects block rays; translucent ones are seen through.
+    std::vector<bakeTriangle> blockers;
+    glm::vec3 sceneMin(FLT_MAX), sceneMax(-FLT_MAX);
+    for (size_t i = 0; i < objects.size(); i++) {
+        if (!scene.isTranslucent(i)) {
+            blockers.insert(blockers.end(), objects[i].triangles.begin(), objects[i].triangles.end());
+        }
+        sceneMin = glm::min(sceneMin, objects[i].min);
+        sceneMax = glm::max(sceneMax, objects[i].max);
+    }
+    size_t blockerNum = blockers.size();
+    TriangleBvh bvh(std::move(blockers));
+
+    // Cells cover the scene's footprint and one cell around it.
+    pvsHeader grid{};
+    std::vector<uint64_t> meshHashes(scene.getMeshNum());
+    for (size_t m = 0; m < meshHashes.size(); m++) {
+        meshHashes[m] = MeshCache::hashFile(scene.getMeshPath(m));
+    }
+    grid.inputHash = Pvs::hashInputs(MeshCache::hashFile(scenePath), meshHashes);
+    grid.objectNum = objects.size();
+    grid.cellSize = cellSize;
+    grid.originX = objects.empty() ? 0.0f : std::floor(sceneMin.x / cellSize - 1.0f) * cellSize;
+    grid.originZ = objects.empty() ? 0.0f : std::floor(sceneMin.z / cellSize - 1.0f) * cellSize;
+    grid.cellsX = objects.empty() ? 1 : (unsigned int) std::ceil((sceneMax.x - grid.originX) / cellSize + 1.0f);
+    grid.cellsZ = objects.empty() ? 1 : (unsigned int) std::ceil((sceneMax.z - grid.originZ) / cellSize + 1.0f);
+    grid.minY = PVS_MIN_HEIGHT;
+    grid.maxY = std::max(PVS_MIN_HEIGHT, objects.empty() ? 0.0f : sceneMax.y) + PVS_HEADROOM;
+    unsigned int cellNum = grid.cellsX * grid.cellsZ;
+
+    // Cells are handed out one at a time; each draws from its own seed, so the result does not depend on threads.
+    std::vector<std::vector<unsigned char>> cells(cellNum);
+    std::atomic<unsigned int> next(0);
+    std::atomic<unsigned long long> rayNum(0);
+    auto bake = [&]() {
+        for (unsigned int cell; (cell = next++) < cellNum;) {
+            glm::vec3 cellMin(grid.originX + (cell % grid.cellsX) * cellSize, grid.minY,
+                              grid.originZ + (cell / grid.cellsX) * cellSize);
+            glm::vec3 cellMax = cellMin + glm::vec3(cellSize, grid.maxY - grid.minY, cellSize);
+            std::mt19937 random(cell);
+            std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+            unsigned long long rays = 0;
+            std::vector<unsigned char> &visible = cells[cell];
+            visible.assign(objects.size(), 0);
+            for (size_t i = 0; i < objects.size(); i++) {
+                const bakeObject &object = objects[i];
+                float distance = boxDistance(cellMin, cellMax, object.min, object.max);
+                if (object.triangles.empty() || distance > PVS_FAR) {
+                    continue;
+                }
+                if (distance == 0.0f) {
+                    visible[i] = 1;
+                    continue;
+                }
+                // A segment from inside the cell that reaches the object unblocked still does from where it leaves
+                // the cell, so rays only start on the cell's sides toward the object.
+                cellFace faces[6];
+                int faceNum = 0;
+                float faceArea = 0.0f;
+                glm::vec3 extent = cellMax - cellMin;
+                for (int axis = 0; axis < 3; axis++) {
+                    float area = extent[(axis + 1) % 3] * extent[(axis + 2) % 3];
+                    if (object.min[axis] < cellMin[axis]) {
+                        faces[faceNum++] = {axis, cellMin[axis], faceArea += area};
+                    }
+                    if (object.max[axis] > cellMax[axis]) {
+                        faces[faceNum++] = {axis, cellMax[axis], faceArea += area};
+                    }
+                }
+                // Seen when nothing else blocks a ray from the cell to a point on the object.
+                for (unsigned int s = 0; s < samples && !visible[i]; s++) {
+                    float side = unit(random) * faceArea;
+                    int face = 0;
+                    while (face < faceNum - 1 && faces[face].area < side) {
+                        face++;
+                    }
+                    glm::vec3 origin = cellMin + extent * glm::vec3(unit(random), unit(random), unit(random));
+                    origin[faces[face].axis] = faces[face].at;
+                    float pick = unit(random) * object.areas.back();
+                    size_t t = std::min<size_t>(std::upper_bound(object.areas.begin(), object.areas.end(), pick) -
+                                                object.areas.begin(), object.areas.size() - 1);
+                    float u = unit(random), v = unit(random);
+                    if (u + v > 1.0f) {
+                        u = 1.0f - u;
+                        v = 1.0f - v;
+                    }
+                    const bakeTriangle &triangle = object.triangles[t];
+                    glm::vec3 target = triangle.a + u * (triangle.b - triangle.a) + v * (triangle.c - triangle.a);
+                    glm::vec3 direction = target - origin;
+                    float length = glm::length(direction);
+                    visible[i] = !bvh.isBlocked(origin, direction / length, length, i);
+                    rays++;
+                }
+            }
+            rayNum += rays;
+        }
+    };
+    std::vector<std::thread> threads;
+    for (unsigned int i = 1; i < threadNum; i++) {
+        threads.emplace_back(bake);
+    }
+    bake();
+    for (auto &thread: threads) {
+        thread.join();
+    }
+
+    if (!Pvs::write(pvsPath, grid, cells)) {
+        std::cerr << "Could not write " << pvsPath << std::endl;
+        return -1;
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    size_t visibleNum = 0;
+    for (const auto &cell: cells) {
+        visibleNum += std::count(cell.begin(), cell.end(), 1);
+    }
+    Pvs pvs;
+    pvs.load(pvsPath, grid.inputHash);
+    double rawBytes = double(cellNum) * ((objects.size() + 7) / 8);
+    printf("Baked %s: %u x %u cells of %.1f over heights %.1f to %.1f, %zu objects, %zu blocking triangles\n",
+           pvsPath.c_str(), grid.cellsX, grid.cellsZ, cellSize, grid.minY, grid.maxY, objects.size(), blockerNum);
+    printf("%.2lf s on %u threads, %llu rays; %.1lf KB (bitsets alone %.1lf KB); %.1lf%% of the objects visible "
+           "per cell on average\n", elapsed.count(), threadNum, rayNum.load(), pvs.getFileSize() / 1024.0,
+           rawBytes / 1024.0, objects.empty() ? 0.0 : 100.0 * visibleNum / (double(cellNum) * objects.size()));
+    return 0;
+}
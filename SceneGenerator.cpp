@@ -0,0 +1,273 @@
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <random>
+#include <filesystem>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+
+#define MESH_DIR "../res/objects"
+#define STRESS_SCENE_FILE "../res/objects/stress.txt"
+#define STRESS_LIGHTS_FILE "../res/stress.pos"
+#define APP_COMMAND "./App"
+
+#define LAYOUT_EXTENT 90.0f // Half size of the placement area; the ground plane reaches 100.
+#define CLUSTER_SIZE 200 // Objects per cluster in the clustered layout.
+#define CLUSTER_SPREAD 4.0f // Standard deviation around a cluster's center.
+#define CORRIDOR_WIDTH 12.0f
+#define CORRIDOR_WALL_FRACTION 0.8f // Objects lining the corridor's walls, as occluders; the rest stand inside it.
+#define TRANSLUCENT_FRACTION 0.25f
+#define LIGHT_HEIGHT 16.0f
+#define LIGHT_RING 14.0f // Lights circle the origin, which their shadow maps look at.
+#define SWEEP_FRAMES 300
+
+// Deterministic random numbers for a seed: std::mt19937's sequence is fixed by the standard, unlike the
+// standard distributions', so the same seed gives the same scene with any standard library.
+class SeededRandom {
+private:
+    std::mt19937 m_engine;
+public:
+    SeededRandom(unsigned int seed) : m_engine(seed) {}
+
+    ~SeededRandom() {}
+
+    float uniform(float low, float high) { return low + (high - low) * float(m_engine() / 4294967296.0); }
+
+    unsigned int below(unsigned int n) { return (unsigned int) (m_engine() / 4294967296.0 * n); }
+
+    // Box-Muller.
+    float normal() {
+        float u = uniform(1e-7f, 1.0f), v = uniform(0.0f, 1.0f);
+        return std::sqrt(-2.0f * std::log(u)) * std::cos(6.2831853f * v);
+    }
+};
+
+enum layoutType {
+    UNIFORM, CLUSTERED, CORRIDOR
+};
+
+static const char *layoutNames[] = {"uniform", "clustered", "corridor"};
+
+static std::vector<std::filesystem::path> listMeshes(const std::string &dir) {
+    std::vector<std::filesystem::path> meshes;
+    for (const auto &entry: std::filesystem::directory_iterator(dir)) {
+        if (entry.is_regular_file() && entry.path().extension() == ".obj") {
+            meshes.push_back(entry.path());
+        }
+    }
+    std::sort(meshes.begin(), meshes.end());
+    return meshes;
+}
+
+// Writes objectNum placements of the meshes in the layout; mesh paths are made relative to the scene file.
+static bool writeScene(const std::string &scenePath, const std::vector<std::filesystem::path> &meshes,
+                       unsigned int objectNum, layoutType layout, SeededRandom &random) {
+    std::ofstream scene(scenePath);
+    if (!scene.is_open()) {
+        std::cerr << "Could not write " << scenePath << std::endl;
+        return false;
+    }
+    std::filesystem::path sceneDir = std::filesystem::absolute(scenePath).parent_path();
+    scene << "# Generated: " << objectNum << " objects, " << layoutNames[layout] << " layout.\n";
+    for (size_t m = 0; m < meshes.size(); m++) {
+        scene << "mesh m" << m << " "
+              << std::filesystem::relative(std::filesystem::absolute(meshes[m]), sceneDir).generic_string() << "\n";
+    }
+
+    std::vector<float> clusters;
+    unsigned int clusterNum = (objectNum + CLUSTER_SIZE - 1) / CLUSTER_SIZE;
+    for (unsigned int c = 0; layout == CLUSTERED && c < clusterNum; c++) {
+        clusters.push_back(random.uniform(-LAYOUT_EXTENT + 10.0f, LAYOUT_EXTENT - 10.0f));
+        clusters.push_back(random.uniform(-LAYOUT_EXTENT + 10.0f, LAYOUT_EXTENT - 10.0f));
+    }
+
+    char line[256];
+    for (unsigned int i = 0; i < objectNum; i++) {
+        float x, z;
+        bool occluder = false;
+        if (layout == UNIFORM) {
+            x = random.uniform(-LAYOUT_EXTENT, LAYOUT_EXTENT);
+            z = random.uniform(-LAYOUT_EXTENT, LAYOUT_EXTENT);
+        } else if (layout == CLUSTERED) {
+            unsigned int c = random.below(clusterNum);
+            x = std::clamp(clusters[2 * c] + CLUSTER_SPREAD * random.normal(), -LAYOUT_EXTENT, LAYOUT_EXTENT);
+            z = std::clamp(clusters[2 * c + 1] + CLUSTER_SPREAD * random.normal(), -LAYOUT_EXTENT, LAYOUT_EXTENT);
+        } else {
+            // Along z, lining both walls.
+            z = random.uniform(-LAYOUT_EXTENT, LAYOUT_EXTENT);
+            if (random.uniform(0.0f, 1.0f) < CORRIDOR_WALL_FRACTION) {
+                x = (random.below(2) ? 0.5f : -0.5f) * CORRIDOR_WIDTH;
+                x += 0.5f * random.normal();
+                occluder = true;
+            } else {
+                x = random.uniform(-0.4f * CORRIDOR_WIDTH, 0.4f * CORRIDOR_WIDTH);
+            }
+        }
+        // Drawn one per statement: the order arguments are evaluated in is unspecified.
+        unsigned int mesh = random.below(meshes.size());
+        float angle = random.uniform(0.0f, 360.0f), scale = random.uniform(0.5f, 1.5f);
+        float r = random.uniform(0.2f, 1.0f), g = random.uniform(0.2f, 1.0f), b = random.uniform(0.2f, 1.0f);
+        snprintf(line, sizeof(line), "object m%u position %.2f 0 %.2f rotation 0 %.0f 0 scale %.2f color %.2f %.2f "
+                 "%.2f", mesh, x, z, angle, scale, r, g, b);
+        scene << line;
+        if (random.uniform(0.0f, 1.0f) < TRANSLUCENT_FRACTION) {
+            snprintf(line, sizeof(line), " translucent alpha %.2f", random.uniform(0.2f, 0.6f));
+            scene << line;
+        } else if (occluder) {
+            scene << " occluder";
+        }
+        scene << "\n";
+    }
+    return bool(scene);
+}
+
+static bool writeLights(const std::string &lightsPath, unsigned int lightNum, SeededRandom &random) {
+    std::ofstream lights(lightsPath);
+    if (!lights.is_open()) {
+        std::cerr << "Could not write " << lightsPath << std::endl;
+        return false;
+    }
+    lights << "# Generated: " << lightNum << " lights.\n";
+    char line[128];
+    for (unsigned int i = 0; i < lightNum; i++) {
+        float angle = 6.2831853f * (i + random.uniform(0.0f, 0.5f)) / lightNum;
+        snprintf(line, sizeof(line), "x/y/z: %.2f/%.2f/%.2f\n", LIGHT_RING * std::cos(angle),
+                 LIGHT_HEIGHT + random.uniform(0.0f, 8.0f), LIGHT_RING * std::sin(angle));
+        lights << line;
+    }
+    return bool(lights);
+}
+
+// Comma-separated positive numbers.
+static bool parseList(const std::string &text, std::vector<unsigned int> &values) {
+    values.clear();
+    size_t begin = 0;
+    while (begin <= text.size()) {
+        size_t end = std::min(text.find(',', begin), text.size());
+        int value = std::atoi(text.substr(begin, end - begin).c_str());
+        if (value <= 0) {
+            return false;
+        }
+        values.push_back(value);
+        begin = end + 1;
+    }
+    return !values.empty();
+}
+
+struct frameReport {
+    bool ok;
+    double frame, shadow, main; // Milliseconds per frame.
+};
+
+// Runs App on the files for a number of frames and reads back its measurement.
+static frameReport measure(const std::string &app, const std::string &scenePath, const std::string &lightsPath,
+                           unsigned int frames) {
+    frameReport report{false, 0.0, 0.0, 0.0};
+    std::string command = app + " --scene \"" + scenePath + "\" --lights \"" + lightsPath + "\" --frames " +
+                          std::to_string(frames) + " 2>&1";
+    FILE *output = popen(command.c_str(), "r");
+    if (!output) {
+        return report;
+    }
+    char line[512];
+    while (fgets(line, sizeof(line), output)) {
+        const char *measured = strstr(line, "ms/frame; shadow passes");
+        if (strncmp(line, "Measured", 8) == 0 && measured) {
+            const char *colon = strchr(line, ':');
+            report.ok = colon && sscanf(colon, ": %lf ms/frame; shadow passes %lf ms, main pass %lf ms",
+                                        &report.frame, &report.shadow, &report.main) == 3;
+        }
+    }
+    report.ok = pclose(output) == 0 && report.ok;
+    return report;
+}
+
+int main(int argc, char **argv) {
+    std::vector<unsigned int> objectNums{1000}, lightNums{3};
+    layoutType layout = UNIFORM;
+    unsigned int seed = 1, sweepFrames = 0;
+    std::string meshDir = MESH_DIR, scenePath = STRESS_SCENE_FILE, lightsPath = STRESS_LIGHTS_FILE, app = APP_COMMAND;
+
+    bool valid = true;
+    for (int i = 1; valid && i < argc; i++) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--objects" && hasValue) {
+            valid = parseList(argv[++i], objectNums);
+        } else if (arg == "--lights" && hasValue) {
+            valid = parseList(argv[++i], lightNums);
+        } else if (arg == "--layout" && hasValue) {
+            std::string name = argv[++i];
+            auto found = std::find(std::begin(layoutNames), std::end(layoutNames), name);
+            valid = found != std::end(layoutNames);
+            layout = layoutType(found - std::begin(layoutNames));
+        } else if (arg == "--seed" && hasValue) {
+            seed = std::strtoul(argv[++i], nullptr, 10);
+        } else if (arg == "--mesh-dir" && hasValue) {
+            meshDir = argv[++i];
+        } else if (arg == "--scene" && hasValue) {
+            scenePath = argv[++i];
+        } else if (arg == "--lights-file" && hasValue) {
+            lightsPath = argv[++i];
+        } else if (arg == "--app" && hasValue) {
+            app = argv[++i];
+        } else if (arg == "--sweep") {
+            sweepFrames = SWEEP_FRAMES;
+            if (hasValue && argv[i + 1][0] != '-') {
+                sweepFrames = std::atoi(argv[++i]);
+                valid = sweepFrames > 0;
+            }
+        } else {
+            valid = false;
+        }
+    }
+    bool sweep = sweepFrames > 0;
+    if (!valid || (!sweep && (objectNums.size() > 1 || lightNums.size() > 1))) {
+        std::cerr << "Usage: " << argv[0] << " [--objects n[,n...]] [--lights m[,m...]] [--layout uniform|clustered|"
+                  << "corridor] [--seed s] [--mesh-dir dir] [--scene file] [--lights-file file] [--app command] "
+                  << "[--sweep [frames]]\nLists are only allowed with --sweep, which runs App on every combination "
+                  << "and reports its frame times." << std::endl;
+        return -1;
+    }
+
+    std::vector<std::filesystem::path> meshes = listMeshes(meshDir);
+    if (meshes.empty()) {
+        std::cerr << "No .obj files in " << meshDir << std::endl;
+        return -1;
+    }
+
+    if (sweep) {
+        printf("%10s %8s %12s %14s %14s %16s\n", "objects", "lights", "ms/frame", "shadow ms", "main ms",
+               "shadow ms/light");
+    }
+    for (unsigned int objectNum: objectNums) {
+        for (unsigned int lightNum: lightNums) {
+            // Every combination starts from the seed, so a scene does not depend on the ones before it.
+            SeededRandom random(seed);
+            if (!writeScene(scenePath, meshes, objectNum, layout, random) ||
+                !writeLights(lightsPath, lightNum, random)) {
+                return -1;
+            }
+            if (!sweep) {
+                printf("Wrote %u objects (%s layout, seed %u) to %s and %u lights to %s\n", objectNum,
+                       layoutNames[layout], seed, scenePath.c_str(), lightNum, lightsPath.c_str());
+                continue;
+            }
+
+            frameReport report = measure(app, scenePath, lightsPath, sweepFrames);
+            if (report.ok) {
+                printf("%10u %8u %12.3f %14.3f %14.3f %16.3f\n", objectNum, lightNum, report.frame, report.shadow,
+                       report.main, report.shadow / lightNum);
+            } else {
+                printf("%10u %8u %12s\n", objectNum, lightNum, "failed");
+            }
+            fflush(stdout);
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,738 @@
+#define TINYOBJLOADER_IMPLEMENTATION
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <filesystem>
+#include <functional>
+#include <algorithm>
+#include <cstdio>
+#include <cmath>
+#include <cfloat>
+#include <thread>
+#include <fstream>
+#include <sstream>
+#include <unordered_map>
+#include "glm/glm.hpp"
+#include "glm/gtc/matrix_transform.hpp"
+#include "tiny_obj_loader.h"
+#include "ObjParser.h"
+#include "NormalGenerator.h"
+#include "Lights.h"
+#include "Scene.h"
+#include "EntityStore.h"
+#include "Frustum.h"
+#include "Bvh.h"
+#include "OcclusionCuller.h"
+
+#define RUNS 5 // Each measurement keeps the best of RUNS runs.
+#define GRID_SIZE 1500 // Quads per side of the synthetic terrain: 4.5M triangles.
+#define PARSE_LINES 1000000 // Lines of the generated scene and light files.
+#define ENTITY_NUM 100000 // Entities walked per simulated frame.
+#define ENTITY_FRAMES 100
+#define ENTITY_CHURN 1000 // Entities destroyed and created again per frame.
+#define CULL_NUM 100000 // Boxes culled per simulated frame, the camera turning a little each frame.
+#define CULL_FRAMES 100
+#define ROOM_GRID 12 // Rooms per side of the synthetic interior, each ROOM_SIZE wide with a doorway in every wall.
+#define ROOM_SIZE 10.0f
+#define TRUTH_WIDTH 1280 // Screen the props the occlusion culler hides are checked against, one ray per pixel.
+#define TRUTH_HEIGHT 720
+#define TRUTH_FRAMES 10  // Frames checked, spread over the turn.
+
+// Best wall time of RUNS calls of f, in seconds.
+static double bestTime(const std::function<void()> &f) {
+    double best = 1e30;
+    for (int i = 0; i < RUNS; i++) {
+        auto start = std::chrono::steady_clock::now();
+        f();
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        best = std::min(best, elapsed.count());
+    }
+    return best;
+}
+
+// OBJ parsing throughput: tinyobj::LoadObj against ObjParser on every file in the directory.
+static void benchObj(const std::string &dir) {
+    std::vector<std::filesystem::path> files;
+    for (const auto &entry: std::filesystem::directory_iterator(dir)) {
+        if (entry.path().extension() == ".obj") {
+            files.push_back(entry.path());
+        }
+    }
+    std::sort(files.begin(), files.end());
+
+    printf("%-40s %10s %12s %12s %8s\n", "file", "MB", "tinyobj MB/s", "parser MB/s", "speedup");
+    for (const auto &file: files) {
+        double mb = std::filesystem::file_size(file) / (1024.0 * 1024.0);
+        size_t tinyCorners = 0, parserCorners = 0;
+
+        double tinyTime = bestTime([&]() {
+            tinyobj::attrib_t attrib;
+            std::vector<tinyobj::shape_t> shapes;
+            std::vector<tinyobj::material_t> materials;
+            std::string warn, err;
+            tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, file.string().c_str());
+            tinyCorners = 0;
+            for (const auto &shape: shapes) {
+                tinyCorners += shape.mesh.indices.size();
+            }
+        });
+
+        double parserTime = bestTime([&]() {
+            objData data;
+            ObjParser parser;
+            parser.parse(file.string(), data);
+            parserCorners = data.corners.size();
+        });
+
+        printf("%-40s %10.2f %12.1f %12.1f %7.1fx%s\n", file.filename().string().c_str(), mb, mb / tinyTime,
+               mb / parserTime, tinyTime / parserTime, tinyCorners == parserCorners ? "" : "  (corner mismatch)");
+    }
+}
+
+// Normal generation on a rolling terrain without vn records, single-threaded and on every core.
+static void benchNormals() {
+    objData grid;
+    for (int i = 0; i <= GRID_SIZE; i++) {
+        for (int j = 0; j <= GRID_SIZE; j++) {
+            grid.positions.insert(grid.positions.end(),
+                                  {i * 0.01f, std::sin(i * 0.05f) * std::cos(j * 0.03f), j * 0.01f});
+        }
+    }
+    for (int i = 0; i < GRID_SIZE; i++) {
+        for (int j = 0; j < GRID_SIZE; j++) {
+            int a = i * (GRID_SIZE + 1) + j, b = a + 1, c = a + GRID_SIZE + 1, d = c + 1;
+            for (int corner: {a, c, b, b, c, d}) {
+                grid.corners.push_back({corner, -1});
+            }
+        }
+    }
+
+    printf("\n%-40s %10s %12s\n", "normal generation", "triangles", "ms");
+    std::vector<unsigned int> threadNums = {1};
+    if (std::thread::hardware_concurrency() > 1) {
+        threadNums.push_back(std::thread::hardware_concurrency());
+    }
+    for (unsigned int threads: threadNums) {
+        double time = bestTime([&]() {
+            objData data = grid;
+            NormalGenerator(threads).generate(data);
+        });
+        std::string label = std::to_string(threads) + (threads == 1 ? " thread" : " threads");
+        printf("%-40s %10zu %12.1f\n", label.c_str(), grid.corners.size() / 3, time * 1000.0);
+    }
+}
+
+// An object as the previous scene parser kept it.
+struct legacyPlacement {
+    unsigned int mesh;
+    glm::vec3 position = glm::vec3(0.0f), rotation = glm::vec3(0.0f), scale = glm::vec3(1.0f);
+    sceneMaterial material;
+    bool translucent = false;
+};
+
+static bool legacyReadVec3(std::istringstream &stream, glm::vec3 &value) {
+    return bool(stream >> value.x >> value.y >> value.z);
+}
+
+// The istringstream scene parser TextTokenizer replaced, for comparison. Returns false on the first bad line.
+static bool legacyLoadScene(const std::string &filePath, std::vector<std::string> &meshPaths,
+                            std::vector<legacyPlacement> &objects) {
+    meshPaths.clear();
+    objects.clear();
+    std::ifstream stream(filePath);
+    if (!stream.is_open()) {
+        return false;
+    }
+
+    std::unordered_map<std::string, unsigned int> meshes;
+    std::string line, keyword, key;
+    while (getline(stream, line)) {
+        std::istringstream tokens(line);
+        if (!(tokens >> keyword) || keyword[0] == '#') {
+            continue;
+        }
+
+        if (keyword == "mesh") {
+            std::string name, file;
+            if (!(tokens >> name >> file) || !meshes.emplace(name, meshPaths.size()).second) {
+                return false;
+            }
+            meshPaths.push_back(file);
+        } else if (keyword == "object") {
+            std::string name;
+            auto mesh = meshes.end();
+            if (!(tokens >> name) || (mesh = meshes.find(name)) == meshes.end()) {
+                return false;
+            }
+
+            legacyPlacement object;
+            object.mesh = mesh->second;
+            sceneMaterial &material = object.material;
+            while (tokens >> key) {
+                bool valid;
+                if (key == "position") {
+                    valid = legacyReadVec3(tokens, object.position);
+                } else if (key == "rotation") {
+                    valid = legacyReadVec3(tokens, object.rotation);
+                } else if (key == "scale") {
+                    valid = bool(tokens >> object.scale.x);
+                    glm::vec3 scale;
+                    std::streampos next = tokens.tellg();
+                    if (valid && tokens >> scale.y >> scale.z) {
+                        object.scale.y = scale.y;
+                        object.scale.z = scale.z;
+                    } else {
+                        tokens.clear();
+                        tokens.seekg(next);
+                        object.scale = glm::vec3(object.scale.x);
+                    }
+                } else if (key == "translucent") {
+                    valid = object.translucent = true;
+                } else if (key == "color") {
+                    valid = legacyReadVec3(tokens, material.color);
+                } else if (key == "ambient") {
+                    valid = bool(tokens >> material.ambient);
+                } else if (key == "diffuse") {
+                    valid = bool(tokens >> material.diffuse);
+                } else if (key == "specular") {
+                    valid = bool(tokens >> material.specular);
+                } else if (key == "shininess") {
+                    valid = bool(tokens >> material.shininess);
+                } else if (key == "alpha") {
+                    valid = bool(tokens >> material.alpha);
+                } else {
+                    return false;
+                }
+                if (!valid) {
+                    return false;
+                }
+            }
+            objects.push_back(object);
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
+// The light parser TextTokenizer replaced, for comparison.
+static std::vector<glm::vec3> legacyParseLights(const std::string &filePath) {
+    std::ifstream stream(filePath);
+    std::string line;
+    std::vector<glm::vec3> lights;
+    while (getline(stream, line)) {
+        if (line.find('#') == std::string::npos && line != "") {
+            if (line.find("x/y/z: ") != std::string::npos) {
+                std::vector<float> coordinate;
+                std::string::iterator it = line.begin() + 7;
+                while (it != line.end()) {
+                    std::string pos;
+                    while (it != line.end() && (*it) != '/') {
+                        pos += *(it++);
+                    }
+                    coordinate.push_back(stof(pos));
+                    if (it != line.end() && (*it) == '/') {
+                        it++;
+                    }
+                }
+                lights.push_back({coordinate[0], coordinate[1], coordinate[2]});
+            } else {
+                return std::vector<glm::vec3>{};
+            }
+        }
+    }
+    return lights;
+}
+
+// Scene and light file parsing on generated PARSE_LINES-line files: the previous parsers against TextTokenizer.
+static void benchParsers() {
+    std::string dir = std::filesystem::temp_directory_path().string();
+    std::string lightsFile = dir + "/bench_lights.pos", sceneFile = dir + "/bench_scene.txt";
+    {
+        std::ofstream lights(lightsFile), scene(sceneFile);
+        char line[256];
+        for (int i = 0; i < PARSE_LINES; i++) {
+            float x = (i % 2000) * 0.37f - 370.0f, y = (i % 17) * 0.5f, z = (i % 3001) * -0.21f;
+            snprintf(line, sizeof(line), "x/y/z: %.3f/%.3f/%.3f\n", x, y, z);
+            lights << line;
+            if (i < 8) {
+                scene << "mesh m" << i << " m" << i << ".obj\n";
+            } else {
+                snprintf(line, sizeof(line), "object m%d position %.3f %.3f %.3f rotation 0 %.1f 0 scale %.2f\n",
+                         i % 8, x, y, z, (i % 360) * 1.0f, 0.5f + (i % 7) * 0.25f);
+                scene << line;
+            }
+        }
+    }
+
+    printf("\n%-40s %10s %10s %12s %12s\n", "parser", "lines", "MB", "ms", "MB/s");
+    auto report = [](const char *label, const std::string &file, size_t count, double time) {
+        double mb = std::filesystem::file_size(file) / (1024.0 * 1024.0);
+        printf("%-40s %10d %10.2f %12.1f %12.1f  (%zu entries)\n", label, PARSE_LINES, mb, time * 1000.0, mb / time,
+               count);
+    };
+
+    size_t count = 0;
+    double legacyLights = bestTime([&]() { count = legacyParseLights(lightsFile).size(); });
+    report("lights: previous parser", lightsFile, count, legacyLights);
+    double tokenizerLights = bestTime([&]() {
+        Lights lights;
+        lights.loadLights(lightsFile);
+        count = lights.getLightNum();
+    });
+    report("lights: TextTokenizer", lightsFile, count, tokenizerLights);
+
+    double legacyScene = bestTime([&]() {
+        std::vector<std::string> meshPaths;
+        std::vector<legacyPlacement> objects;
+        legacyLoadScene(sceneFile, meshPaths, objects);
+        count = objects.size();
+    });
+    report("scene: previous parser", sceneFile, count, legacyScene);
+    double tokenizerScene = bestTime([&]() {
+        Scene scene;
+        scene.load(sceneFile);
+        count = scene.getObjectNum();
+    });
+    report("scene: TextTokenizer", sceneFile, count, tokenizerScene);
+
+    remove(lightsFile.c_str());
+    remove(sceneFile.c_str());
+}
+
+// Per-object state as it was kept before the entity store: one struct per object.
+struct legacyObject {
+    unsigned int asset;
+    glm::mat4 model;
+    glm::vec3 center;
+    float radius;
+    float scale;
+    sceneMaterial material;
+    bool translucent;
+};
+
+// A frame's walk over ENTITY_NUM objects: culling against a camera, splitting the visible ones into opaque and
+// translucent, and gathering what submission reads. Objects as structs against the entity store's arrays.
+static void benchEntities() {
+    std::vector<legacyObject> legacy(ENTITY_NUM);
+    std::vector<glm::mat4> worlds(ENTITY_NUM); // Stands in for the scene graph.
+    EntityStore entities;
+    entities.reserve(ENTITY_NUM);
+    std::vector<unsigned int> handles(ENTITY_NUM);
+    for (unsigned int i = 0; i < ENTITY_NUM; i++) {
+        glm::vec3 center((i * 7919 % 1000) * 0.4f - 200.0f, 1.0f, (i * 104729 % 1000) * -0.4f + 10.0f);
+        worlds[i] = glm::translate(glm::mat4(1.0f), center);
+        legacy[i] = {i % 9, worlds[i], center, 1.5f, 1.0f, sceneMaterial(), i % 3 == 0};
+        handles[i] = entities.create(i, i % 9, sceneMaterial(), i % 3 == 0 ? ENTITY_TRANSLUCENT : 0);
+        entities.setBounds(entities.getIndex(handles[i]), center, 1.5f, 1.0f);
+    }
+    glm::vec3 eye(0.0f, 6.0f, 15.0f);
+    Frustum frustum(glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.1f, 200.0f) *
+                    glm::lookAt(eye, eye + glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f)));
+
+    std::vector<unsigned int> opaque, translucent;
+    opaque.reserve(ENTITY_NUM);
+    translucent.reserve(ENTITY_NUM);
+    float checksum = 0.0f;
+
+    double legacyTime = bestTime([&]() {
+        for (int frame = 0; frame < ENTITY_FRAMES; frame++) {
+            opaque.clear();
+            translucent.clear();
+            for (unsigned int i = 0; i < legacy.size(); i++) {
+                if (frustum.intersects(legacy[i].center, legacy[i].radius)) {
+                    (legacy[i].translucent ? translucent : opaque).push_back(i);
+                }
+            }
+            for (unsigned int i: opaque) {
+                checksum += legacy[i].model[3][0] + legacy[i].material.diffuse + legacy[i].asset;
+            }
+        }
+    });
+
+    double storeTime = bestTime([&]() {
+        for (int frame = 0; frame < ENTITY_FRAMES; frame++) {
+            opaque.clear();
+            translucent.clear();
+            const glm::vec3 *centers = entities.getCenters();
+            const float *radii = entities.getRadii();
+            const unsigned char *flags = entities.getFlagArray();
+            for (unsigned int i = 0; i < entities.size(); i++) {
+                if (frustum.intersects(centers[i], radii[i])) {
+                    (flags[i] & ENTITY_TRANSLUCENT ? translucent : opaque).push_back(i);
+                }
+            }
+            for (unsigned int i: opaque) {
+                checksum += worlds[entities.getNode(i)][3][0] + entities.getMaterial(i).diffuse + entities.getAsset(i);
+            }
+        }
+    });
+
+    // Handles survive the entities moving around in the dense arrays.
+    size_t stale = 0;
+    double churnTime = bestTime([&]() {
+        for (int frame = 0; frame < ENTITY_FRAMES; frame++) {
+            for (unsigned int k = 0; k < ENTITY_CHURN; k++) {
+                unsigned int &handle = handles[(frame * 7919 + k * 104729) % ENTITY_NUM];
+                unsigned int index = entities.getIndex(handle);
+                unsigned int node = entities.getNode(index), asset = entities.getAsset(index);
+                unsigned char flags = entities.getFlags(index);
+                glm::vec3 center = entities.getCenter(index);
+                entities.destroy(handle);
+                stale += entities.isAlive(handle);
+                handle = entities.create(node, asset, sceneMaterial(), flags);
+                entities.setBounds(entities.getIndex(handle), center, 1.5f, 1.0f);
+            }
+        }
+    });
+    for (unsigned int i = 0; i < ENTITY_NUM; i++) {
+        stale += entities.getNode(entities.getIndex(handles[i])) != i;
+    }
+
+    printf("\n%-40s %10s %12s\n", "per-object state", "entities", "ms/frame");
+    printf("%-40s %10d %12.3f\n", "structs (cull, split, gather)", ENTITY_NUM, legacyTime * 1000.0 / ENTITY_FRAMES);
+    printf("%-40s %10d %12.3f  (%zu visible)\n", "EntityStore (cull, split, gather)", ENTITY_NUM,
+           storeTime * 1000.0 / ENTITY_FRAMES, opaque.size() + translucent.size());
+    printf("%-40s %10d %12.3f  (%zu stale handles)\n", "EntityStore churn", ENTITY_CHURN,
+           churnTime * 1000.0 / ENTITY_FRAMES, stale);
+    volatile float sink = checksum; // Keeps the gathering from being optimised away.
+    (void) sink;
+}
+
+// View-frustum culling of boxes scattered over the ground: every box tested against the frustum, against the
+// four-wide hierarchy.
+static void benchCulling() {
+    std::vector<glm::vec3> mins(CULL_NUM), maxs(CULL_NUM);
+    for (unsigned int i = 0; i < CULL_NUM; i++) {
+        glm::vec3 center((i * 7919 % 4000) * 0.1f - 200.0f, (i % 7) * 0.5f, (i * 104729 % 4001) * 0.1f - 200.0f);
+        glm::vec3 extent(0.5f + (i % 5) * 0.3f, 0.5f + (i % 3) * 0.5f, 0.5f + (i % 4) * 0.2f);
+        mins[i] = center - extent;
+        maxs[i] = center + extent;
+    }
+    glm::mat4 projection = glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.1f, 200.0f);
+    glm::vec3 eye(0.0f, 6.0f, 15.0f);
+    auto frustumAt = [&](int frame) {
+        float yaw = glm::radians(360.0f * frame / CULL_FRAMES);
+        return Frustum(projection * glm::lookAt(eye, eye + glm::vec3(std::sin(yaw), -0.1f, -std::cos(yaw)),
+                                                glm::vec3(0.0f, 1.0f, 0.0f)));
+    };
+    // The box is outside when its corner farthest along a plane's normal is behind the plane.
+    auto boxVisible = [](const Frustum &frustum, const glm::vec3 &min, const glm::vec3 &max) {
+        for (int p = 0; p < 6; p++) {
+            const glm::vec4 &plane = frustum.getPlane(p);
+            glm::vec3 far(plane.x >= 0.0f ? max.x : min.x, plane.y >= 0.0f ? max.y : min.y,
+                          plane.z >= 0.0f ? max.z : min.z);
+            if (glm::dot(glm::vec3(plane), far) + plane.w < 0.0f) {
+                return false;
+            }
+        }
+        return true;
+    };
+
+    std::vector<unsigned int> visible;
+    visible.reserve(CULL_NUM);
+    size_t visibleNum = 0;
+    double bruteTime = bestTime([&]() {
+        visibleNum = 0;
+        for (int frame = 0; frame < CULL_FRAMES; frame++) {
+            Frustum frustum = frustumAt(frame);
+            visible.clear();
+            for (unsigned int i = 0; i < CULL_NUM; i++) {
+                if (boxVisible(frustum, mins[i], maxs[i])) {
+                    visible.push_back(i);
+                }
+            }
+            visibleNum += visible.size();
+        }
+    });
+
+    Bvh bvh;
+    double buildTime = bestTime([&]() { bvh.build(mins.data(), maxs.data(), CULL_NUM); });
+    double refitTime = bestTime([&]() { bvh.refit(mins.data(), maxs.data()); });
+    double bvhTime = bestTime([&]() {
+        for (int frame = 0; frame < CULL_FRAMES; frame++) {
+            visible.clear();
+            bvh.cull(frustumAt(frame), visible);
+        }
+    });
+
+    // The hierarchy must find exactly the boxes the plain test finds.
+    size_t mismatches = 0;
+    std::vector<unsigned int> expected;
+    for (int frame = 0; frame < CULL_FRAMES; frame += 10) {
+        Frustum frustum = frustumAt(frame);
+        expected.clear();
+        visible.clear();
+        for (unsigned int i = 0; i < CULL_NUM; i++) {
+            if (boxVisible(frustum, mins[i], maxs[i])) {
+                expected.push_back(i);
+            }
+        }
+        bvh.cull(frustum, visible);
+        std::sort(visible.begin(), visible.end());
+        mismatches += visible != expected;
+    }
+
+    printf("\n%-40s %10s %12s\n", "frustum culling", "boxes", "ms/frame");
+    printf("%-40s %10d %12.3f  (%.0f visible)\n", "every box", CULL_NUM, bruteTime * 1000.0 / CULL_FRAMES,
+           double(visibleNum) / CULL_FRAMES);
+    printf("%-40s %10d %12.3f  (%zu frames differ)\n", "four-wide BVH", CULL_NUM, bvhTime * 1000.0 / CULL_FRAMES,
+           mismatches);
+    printf("%-40s %10d %12.3f  (%zu nodes)\n", "BVH build", CULL_NUM, buildTime * 1000.0, bvh.getNodeNum());
+    printf("%-40s %10d %12.3f\n", "BVH refit", CULL_NUM, refitTime * 1000.0);
+}
+
+// Hierarchical-Z occlusion culling in a grid of rooms: the walls are the occluders, CULL_NUM props stand in the
+// rooms, and the camera turns around inside one of them. Props are frustum culled first, as in App.
+// Where the segment from origin to origin + direction enters the box, as a fraction of it; negative if it misses.
+static float segmentEntersBox(const glm::vec3 &origin, const glm::vec3 &direction, const glm::vec3 &min,
+                              const glm::vec3 &max) {
+    float enter = 0.0f, exit = 1.0f;
+    for (int axis = 0; axis < 3; axis++) {
+        if (direction[axis] == 0.0f) {
+            if (origin[axis] < min[axis] || origin[axis] > max[axis]) {
+                return -1.0f;
+            }
+            continue;
+        }
+        float t0 = (min[axis] - origin[axis]) / direction[axis], t1 = (max[axis] - origin[axis]) / direction[axis];
+        enter = std::max(enter, std::min(t0, t1));
+        exit = std::min(exit, std::max(t0, t1));
+    }
+    return enter <= exit ? enter : -1.0f;
+}
+
+// Whether the segment from origin to origin + direction * end crosses the triangle; its edges count as inside.
+static bool segmentCrossesTriangle(const glm::vec3 &origin, const glm::vec3 &direction, float end, const glm::vec3 &a,
+                                   const glm::vec3 &b, const glm::vec3 &c) {
+    glm::vec3 ab = b - a, ac = c - a, p = glm::cross(direction, ac);
+    float determinant = glm::dot(ab, p);
+    if (std::fabs(determinant) < 1e-12f) {
+        return false;
+    }
+    float inverse = 1.0f / determinant;
+    glm::vec3 s = origin - a;
+    float u = glm::dot(s, p) * inverse;
+    if (u < 0.0f || u > 1.0f) {
+        return false;
+    }
+    glm::vec3 q = glm::cross(s, ab);
+    float v = glm::dot(direction, q) * inverse;
+    if (v < 0.0f || u + v > 1.0f) {
+        return false;
+    }
+    float t = glm::dot(ac, q) * inverse;
+    return t >= 0.0f && t < end;
+}
+
+// Ground truth for the occlusion culler: how many of the hidden props the walls do not hide on a TRUTH_WIDTH x
+// TRUTH_HEIGHT screen. A prop is visible when the ray through any pixel center its box covers reaches the box before
+// a wall triangle, as the GPU would draw it, so gaps narrower than the culler's pixels count too.
+static size_t countWronglyHidden(const glm::mat4 &viewProjection, const std::vector<unsigned int> &hidden,
+                                 const glm::vec3 *mins, const glm::vec3 *maxs,
+                                 const std::vector<std::vector<glm::vec3>> &wallTriangles,
+                                 const std::vector<glm::vec3> &wallMins, const std::vector<glm::vec3> &wallMaxs) {
+    glm::mat4 inverse = glm::inverse(viewProjection);
+    size_t blocker = 0; // Neighbouring rays mostly end on the same wall, so it is tried first.
+    auto blocked = [&](const glm::vec3 &origin, const glm::vec3 &direction, float end) {
+        for (size_t k = 0; k <= wallTriangles.size(); k++) {
+            size_t w = k == 0 ? blocker : k - 1;
+            float enter = segmentEntersBox(origin, direction, wallMins[w], wallMaxs[w]);
+            if (enter < 0.0f || enter >= end) {
+                continue;
+            }
+            const std::vector<glm::vec3> &corners = wallTriangles[w];
+            for (size_t t = 0; t < corners.size(); t += 3) {
+                if (segmentCrossesTriangle(origin, direction, end, corners[t], corners[t + 1], corners[t + 2])) {
+                    blocker = w;
+                    return true;
+                }
+            }
+        }
+        return false;
+    };
+
+    size_t wrong = 0;
+    for (unsigned int prop: hidden) {
+        // The pixels whose centers the box's screen rectangle may cover; hidden boxes lie in front of the camera.
+        float minX = FLT_MAX, maxX = -FLT_MAX, minY = FLT_MAX, maxY = -FLT_MAX;
+        for (int corner = 0; corner < 8; corner++) {
+            glm::vec4 clip = viewProjection * glm::vec4(corner & 1 ? maxs[prop].x : mins[prop].x,
+                                                        corner & 2 ? maxs[prop].y : mins[prop].y,
+                                                        corner & 4 ? maxs[prop].z : mins[prop].z, 1.0f);
+            float x = (clip.x / clip.w * 0.5f + 0.5f) * TRUTH_WIDTH, y = (clip.y / clip.w * 0.5f + 0.5f) * TRUTH_HEIGHT;
+            minX = std::min(minX, x);
+            maxX = std::max(maxX, x);
+            minY = std::min(minY, y);
+            maxY = std::max(maxY, y);
+        }
+        int x0 = std::max(0, int(std::floor(minX))), x1 = std::min(TRUTH_WIDTH - 1, int(std::ceil(maxX)));
+        int y0 = std::max(0, int(std::floor(minY))), y1 = std::min(TRUTH_HEIGHT - 1, int(std::ceil(maxY)));
+        bool visible = false;
+        for (int y = y0; y <= y1 && !visible; y++) {
+            for (int x = x0; x <= x1 && !visible; x++) {
+                glm::vec2 ndc((x + 0.5f) / TRUTH_WIDTH * 2.0f - 1.0f, (y + 0.5f) / TRUTH_HEIGHT * 2.0f - 1.0f);
+                glm::vec4 near = inverse * glm::vec4(ndc, -1.0f, 1.0f), far = inverse * glm::vec4(ndc, 1.0f, 1.0f);
+                glm::vec3 origin = glm::vec3(near) / near.w, direction = glm::vec3(far) / far.w - origin;
+                float enter = segmentEntersBox(origin, direction, mins[prop], maxs[prop]);
+                visible = enter >= 0.0f && !blocked(origin, direction, enter);
+            }
+        }
+        wrong += visible;
+    }
+    return wrong;
+}
+
+static void benchOcclusion() {
+    // A wall is a quad subdivided 8x4, with the doorway's column left out in every other one.
+    std::vector<glm::vec3> wallPositions;
+    std::vector<unsigned int> wallIndices, doorIndices;
+    for (int y = 0; y <= 4; y++) {
+        for (int x = 0; x <= 8; x++) {
+            wallPositions.emplace_back(x / 8.0f - 0.5f, y / 4.0f, 0.0f);
+        }
+    }
+    for (int y = 0; y < 4; y++) {
+        for (int x = 0; x < 8; x++) {
+            unsigned int a = y * 9 + x, b = a + 1, c = a + 9, d = c + 1;
+            for (unsigned int corner: {a, b, d, a, d, c}) {
+                wallIndices.push_back(corner);
+                if ((x < 3 || x > 4) || y == 3) {
+                    doorIndices.push_back(corner);
+                }
+            }
+        }
+    }
+    std::vector<glm::mat4> walls;
+    float half = ROOM_GRID * ROOM_SIZE * 0.5f;
+    for (int i = 0; i <= ROOM_GRID; i++) {
+        for (int j = 0; j < ROOM_GRID; j++) {
+            float along = -half + (j + 0.5f) * ROOM_SIZE, across = -half + i * ROOM_SIZE;
+            glm::mat4 scale = glm::scale(glm::mat4(1.0f), glm::vec3(ROOM_SIZE, 4.0f, 1.0f));
+            walls.push_back(glm::translate(glm::mat4(1.0f), glm::vec3(along, 0.0f, across)) * scale);
+            walls.push_back(glm::translate(glm::mat4(1.0f), glm::vec3(across, 0.0f, along)) *
+                            glm::rotate(glm::mat4(1.0f), glm::radians(90.0f), glm::vec3(0.0f, 1.0f, 0.0f)) * scale);
+        }
+    }
+    // The walls' triangles in world space, for the ground truth.
+    std::vector<std::vector<glm::vec3>> wallTriangles(walls.size());
+    std::vector<glm::vec3> wallMins(walls.size(), glm::vec3(FLT_MAX)), wallMaxs(walls.size(), glm::vec3(-FLT_MAX));
+    for (size_t w = 0; w < walls.size(); w++) {
+        for (unsigned int index: w % 3 == 0 ? doorIndices : wallIndices) {
+            glm::vec3 corner = glm::vec3(walls[w] * glm::vec4(wallPositions[index], 1.0f));
+            wallTriangles[w].push_back(corner);
+            wallMins[w] = glm::min(wallMins[w], corner);
+            wallMaxs[w] = glm::max(wallMaxs[w], corner);
+        }
+    }
+
+    std::vector<glm::vec3> mins(CULL_NUM), maxs(CULL_NUM);
+    for (unsigned int i = 0; i < CULL_NUM; i++) {
+        glm::vec3 center((i * 7919 % 9973) / 9973.0f * 2.0f * half - half, 0.5f,
+                         (i * 104729 % 9967) / 9967.0f * 2.0f * half - half);
+        mins[i] = center - glm::vec3(0.3f, 0.5f, 0.3f);
+        maxs[i] = center + glm::vec3(0.3f, 0.5f, 0.3f);
+    }
+    Bvh bvh;
+    bvh.build(mins.data(), maxs.data(), CULL_NUM);
+    glm::mat4 projection = glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.1f, 200.0f);
+    glm::vec3 eye(ROOM_SIZE * 0.5f - 2.0f, 1.7f, ROOM_SIZE * 0.5f - 3.0f);
+    auto viewAt = [&](int frame) {
+        float yaw = glm::radians(360.0f * frame / CULL_FRAMES);
+        return projection * glm::lookAt(eye, eye + glm::vec3(std::sin(yaw), -0.05f, -std::cos(yaw)),
+                                        glm::vec3(0.0f, 1.0f, 0.0f));
+    };
+
+    std::vector<std::vector<unsigned int>> inFrustum(CULL_FRAMES);
+    size_t inFrustumNum = 0;
+    for (int frame = 0; frame < CULL_FRAMES; frame++) {
+        bvh.cull(Frustum(viewAt(frame)), inFrustum[frame]);
+        inFrustumNum += inFrustum[frame].size();
+    }
+
+    printf("\n%-40s %10s %12s\n", "occlusion culling", "triangles", "ms/frame");
+    std::vector<unsigned int> threadNums = {1};
+    if (std::thread::hardware_concurrency() > 1) {
+        threadNums.push_back(std::thread::hardware_concurrency());
+    }
+    std::vector<float> firstDepth;
+    size_t differ = 0, hiddenNum = 0, triangleNum = 0, checkedNum = 0, wrongNum = 0;
+    std::vector<unsigned int> visible, hidden;
+    std::vector<bool> kept(CULL_NUM);
+    for (unsigned int threads: threadNums) {
+        OcclusionCuller occlusion(threads);
+        auto drawWalls = [&](int frame) {
+            occlusion.begin(viewAt(frame));
+            for (size_t w = 0; w < walls.size(); w++) {
+                const std::vector<unsigned int> &indices = w % 3 == 0 ? doorIndices : wallIndices;
+                occlusion.addOccluder(walls[w], wallPositions.data(), wallPositions.size(), indices.data(),
+                                      indices.size());
+            }
+            occlusion.rasterize();
+        };
+        double rasterTime = bestTime([&]() {
+            triangleNum = 0;
+            for (int frame = 0; frame < CULL_FRAMES; frame++) {
+                drawWalls(frame);
+                triangleNum += occlusion.getTriangleNum();
+            }
+        });
+        double testTime = 0.0;
+        hiddenNum = 0;
+        for (int frame = 0; frame < CULL_FRAMES; frame++) {
+            drawWalls(frame);
+            testTime += bestTime([&]() {
+                visible = inFrustum[frame];
+                occlusion.cull(visible, mins.data(), maxs.data());
+            });
+            hiddenNum += inFrustum[frame].size() - visible.size();
+            if (threads == threadNums[0] && frame % (CULL_FRAMES / TRUTH_FRAMES) == 0) {
+                kept.assign(CULL_NUM, false);
+                for (unsigned int i: visible) {
+                    kept[i] = true;
+                }
+                hidden.clear();
+                for (unsigned int i: inFrustum[frame]) {
+                    if (!kept[i]) {
+                        hidden.push_back(i);
+                    }
+                }
+                checkedNum += hidden.size();
+                wrongNum += countWronglyHidden(viewAt(frame), hidden, mins.data(), maxs.data(), wallTriangles,
+                                               wallMins, wallMaxs);
+            }
+            // Thread counts must not change the depth buffer.
+            std::vector<float> depth(occlusion.getDepth(), occlusion.getDepth() + OCCLUSION_WIDTH * OCCLUSION_HEIGHT);
+            if (threads == threadNums[0] && frame == 0) {
+                firstDepth = depth;
+            } else if (frame == 0) {
+                differ += depth != firstDepth;
+            }
+        }
+        std::string label = "rasterize, " + std::to_string(threads) + (threads == 1 ? " thread" : " threads");
+        printf("%-40s %10.0f %12.3f\n", label.c_str(), double(triangleNum) / CULL_FRAMES,
+               rasterTime * 1000.0 / CULL_FRAMES);
+        printf("%-40s %10s %12.3f  (%.0f of %.0f props hidden)\n", "test boxes against the pyramid", "",
+               testTime * 1000.0 / CULL_FRAMES, double(hiddenNum) / CULL_FRAMES, double(inFrustumNum) / CULL_FRAMES);
+    }
+    if (threadNums.size() > 1) {
+        printf("%-40s %10zu\n", "depth buffers differing across threads", differ);
+    }
+    printf("%-40s %10zu  (of %zu hidden props in %d frames, %dx%d rays)\n", "hidden props actually visible", wrongNum,
+           checkedNum, TRUTH_FRAMES, TRUTH_WIDTH, TRUTH_HEIGHT);
+}
+
+int main(int argc, char **argv) {
+    std::string objDir = argc > 1 ? argv[1] : "../res/objects";
+
+    benchObj(objDir);
+    benchNormals();
+    benchParsers();
+    benchEntities();
+    benchCulling();
+    benchOcclusion();
+
+    return 0;
+}
@@ -0,0 +1,90 @@
+#ifndef LOCAL_ILLUMINATION_MODEL_ASSETREGISTRY_H
+#define LOCAL_ILLUMINATION_MODEL_ASSETREGISTRY_H
+
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
+#include <memory>
+#include "glm/glm.hpp"
+#include "Mesh.h"
+#include "MeshCache.h"
+
+#define INVALID_ASSET_HANDLE (~0u)
+
+// A mesh loaded once and shared by every placement whose source file has the same content.
+struct meshAsset {
+    std::string path;        // The file it was first loaded from.
+    uint64_t hash;           // FNV-1a hash of the file's contents.
+    uint64_t sourceSize;
+    unsigned int refCount;
+    size_t bytes;            // GPU memory of one copy.
+    unsigned int heapHandle; // Where the loader put it.
+    std::vector<meshLod> lods;
+    glm::vec3 center;        // Bounding sphere in model space, around the bounding box's center.
+    float radius;
+    glm::vec3 extent;        // Half size of the bounding box.
+    glm::mat4 dequantization; // Maps its quantized positions to model space; instances prepend their model matrix.
+    std::shared_ptr<const MeshCache> cache; // Kept mapped for objects drawn as occluders, which read level 0.
+};
+
+// What a mesh file is known by: the hash of its contents, valid while its modification time and size are unchanged.
+struct fileIdentity {
+    int64_t mtime;
+    uint64_t size, hash;
+};
+
+struct assetStats {
+    unsigned int assetNum, placementNum;
+    size_t loadedBytes; // What the unique meshes take.
+    size_t placedBytes; // What a copy per placement would take.
+};
+
+// Content-addressed mesh assets: files are identified by the hash of their contents, so byte-identical files and
+// repeated placements of one file load a single copy. Assets are reference counted and unloaded with the last
+// placement that releases them.
+class AssetRegistry {
+public:
+    // Fills in everything after refCount; returns false if the file cannot be loaded.
+    typedef std::function<bool(const std::string &path, meshAsset &asset)> loader;
+    typedef std::function<void(meshAsset &asset)> unloader;
+private:
+    std::vector<meshAsset> m_assets;
+    std::vector<unsigned int> m_free_handles;
+    std::unordered_map<uint64_t, unsigned int> m_by_hash;
+    std::unordered_map<std::string, fileIdentity> m_identities; // Rehashed only when a file changes.
+    loader m_load;
+    unloader m_unload;
+public:
+    AssetRegistry(const loader &load, const unloader &unload);
+
+    ~AssetRegistry() {}
+
+    AssetRegistry(const AssetRegistry &) = delete;
+
+    AssetRegistry &operator=(const AssetRegistry &) = delete;
+
+    // Adds a placement of the file's mesh, loading it if no asset has the same content. Returns
+    // INVALID_ASSET_HANDLE if it cannot be loaded.
+    unsigned int acquire(const std::string &path);
+
+    // Adds another placement of an asset that is already loaded.
+    inline void retain(unsigned int handle) { m_assets[handle].refCount++; }
+
+    void release(unsigned int handle);
+
+    // Stats the file and hashes it unless it is unchanged since it was last hashed.
+    bool identify(const std::string &path, fileIdentity &identity);
+
+    // Records an identity hashed earlier, e.g. by a scene snapshot, so that acquiring the file does not rehash it.
+    inline void remember(const std::string &path, const fileIdentity &identity) { m_identities[path] = identity; }
+
+    inline const meshAsset &get(unsigned int handle) const { return m_assets[handle]; }
+
+    assetStats getStats() const;
+};
+
+
+#endif //LOCAL_ILLUMINATION_MODEL_ASSETREGISTRY_H
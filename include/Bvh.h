@@ -0,0 +1,57 @@
+#ifndef LOCAL_ILLUMINATION_MODEL_BVH_H
+#define LOCAL_ILLUMINATION_MODEL_BVH_H
+
+
+#include <vector>
+#include "glm/glm.hpp"
+#include "Frustum.h"
+
+#define BVH_WIDTH 4              // Children per node, tested together.
+#define BVH_LEAF (1u << 31)      // Marks a child that is one object, by its position in the object order.
+#define BVH_EMPTY (~0u)
+
+// A node's children, their boxes as a structure of arrays so one SIMD instruction covers all four.
+struct bvhNode {
+    float minX[BVH_WIDTH], minY[BVH_WIDTH], minZ[BVH_WIDTH];
+    float maxX[BVH_WIDTH], maxY[BVH_WIDTH], maxZ[BVH_WIDTH];
+    unsigned int children[BVH_WIDTH]; // Node index, BVH_LEAF | order position, or BVH_EMPTY.
+    unsigned int first[BVH_WIDTH];    // The objects under each child are a contiguous run of the order.
+    unsigned int count[BVH_WIDTH];
+};
+
+// A four-wide bounding volume hierarchy over axis-aligned boxes, for frustum culling. Nodes are stored parents
+// first, so a refit after objects move is one backwards pass; the objects are reordered so that every subtree
+// covers a contiguous run, which a subtree entirely inside the frustum emits without testing further.
+class Bvh {
+private:
+    std::vector<bvhNode> m_nodes;
+    std::vector<unsigned int> m_order; // Object indices, in leaf order.
+    std::vector<glm::vec3> m_centroids;
+public:
+    Bvh() {}
+
+    ~Bvh() {}
+
+    // Splits at the median of the longest centroid axis, twice per node.
+    void build(const glm::vec3 *mins, const glm::vec3 *maxs, size_t objectNum);
+
+    // Recomputes every box for the same objects at new bounds, keeping the tree.
+    void refit(const glm::vec3 *mins, const glm::vec3 *maxs);
+
+    // Appends the objects whose boxes are not entirely outside a plane of the frustum.
+    void cull(const Frustum &frustum, std::vector<unsigned int> &visible) const;
+
+    inline size_t getObjectNum() const { return m_order.size(); }
+
+    inline size_t getNodeNum() const { return m_nodes.size(); }
+
+private:
+    unsigned int buildNode(unsigned int first, unsigned int count, const glm::vec3 *mins, const glm::vec3 *maxs,
+                           glm::vec3 &boundsMin, glm::vec3 &boundsMax);
+
+    // Sorts the run around its median along the longest axis of its centroids; returns the median.
+    unsigned int split(unsigned int first, unsigned int count);
+};
+
+
+#endif //LOCAL_ILLUMINATION_MODEL_BVH_H
@@ -0,0 +1,107 @@
+#ifndef LOCAL_ILLUMINATION_MODEL_ENTITYSTORE_H
+#define LOCAL_ILLUMINATION_MODEL_ENTITYSTORE_H
+
+
+#include <vector>
+#include "glm/glm.hpp"
+#include "Scene.h"
+
+#define INVALID_ENTITY (~0u)
+#define ENTITY_INDEX_BITS 24 // The remaining bits of a handle count reuses of its slot.
+#define MAX_ENTITIES (1u << ENTITY_INDEX_BITS)
+
+// Render flags.
+#define ENTITY_TRANSLUCENT 1u
+#define ENTITY_OCCLUDER 2u
+
+// Per-object state as a structure of arrays. Every component lives in its own dense array, indexed alike and
+// packed: destroying an entity moves the last one into its place. Handles stay valid across such moves; a slot
+// table maps them to the current dense index, and a generation count in the handle's high bits rejects handles of
+// destroyed entities whose slot was reused.
+class EntityStore {
+private:
+    // Components, by dense index.
+    std::vector<unsigned int> m_nodes;  // Scene graph node holding the transform.
+    std::vector<glm::vec3> m_centers;   // World-space bounding sphere.
+    std::vector<float> m_radii;
+    std::vector<float> m_scales;        // Largest axis scale of the world matrix.
+    std::vector<glm::vec3> m_box_mins;  // World-space bounding box.
+    std::vector<glm::vec3> m_box_maxs;
+    std::vector<unsigned int> m_assets; // Mesh asset handle.
+    std::vector<sceneMaterial> m_materials;
+    std::vector<unsigned char> m_flags;
+    std::vector<unsigned int> m_handles;
+    // Slots, by handle index.
+    std::vector<unsigned int> m_slot_indices, m_slot_generations, m_free_slots;
+public:
+    EntityStore() {}
+
+    ~EntityStore() {}
+
+    // Returns INVALID_ENTITY when MAX_ENTITIES are alive. Bounds start empty until setBounds() and setBox().
+    unsigned int create(unsigned int node, unsigned int asset, const sceneMaterial &material, unsigned char flags);
+
+    void destroy(unsigned int handle);
+
+    bool isAlive(unsigned int handle) const;
+
+    // The entity's current dense index; only valid until the next destroy().
+    inline unsigned int getIndex(unsigned int handle) const { return m_slot_indices[handle & (MAX_ENTITIES - 1)]; }
+
+    void reserve(size_t entityNum);
+
+    // Destroys every entity; their handles stay invalid.
+    void clear();
+
+    inline size_t size() const { return m_handles.size(); }
+
+    inline unsigned int getHandle(size_t i) const { return m_handles[i]; }
+
+    inline unsigned int getNode(size_t i) const { return m_nodes[i]; }
+
+    inline unsigned int getAsset(size_t i) const { return m_assets[i]; }
+
+    inline void setAsset(size_t i, unsigned int asset) { m_assets[i] = asset; }
+
+    inline const glm::vec3 &getCenter(size_t i) const { return m_centers[i]; }
+
+    inline float getRadius(size_t i) const { return m_radii[i]; }
+
+    inline float getScale(size_t i) const { return m_scales[i]; }
+
+    inline void setBounds(size_t i, const glm::vec3 &center, float radius, float scale) {
+        m_centers[i] = center;
+        m_radii[i] = radius;
+        m_scales[i] = scale;
+    }
+
+    inline void setBox(size_t i, const glm::vec3 &min, const glm::vec3 &max) {
+        m_box_mins[i] = min;
+        m_box_maxs[i] = max;
+    }
+
+    inline const sceneMaterial &getMaterial(size_t i) const { return m_materials[i]; }
+
+    inline void setMaterial(size_t i, const sceneMaterial &material) { m_materials[i] = material; }
+
+    inline unsigned char getFlags(size_t i) const { return m_flags[i]; }
+
+    inline void setFlags(size_t i, unsigned char flags) { m_flags[i] = flags; }
+
+    // Whole components, for loops over every entity.
+    inline const glm::vec3 *getCenters() const { return m_centers.data(); }
+
+    inline const float *getRadii() const { return m_radii.data(); }
+
+    inline const glm::vec3 *getBoxMins() const { return m_box_mins.data(); }
+
+    inline const glm::vec3 *getBoxMaxs() const { return m_box_maxs.data(); }
+
+    inline const unsigned char *getFlagArray() const { return m_flags.data(); }
+
+private:
+    void freeSlot(unsigned int slot);
+};
+
+
+#endif //LOCAL_ILLUMINATION_MODEL_ENTITYSTORE_H
@@ -0,0 +1,45 @@
+#ifndef LOCAL_ILLUMINATION_MODEL_FILEWATCHER_H
+#define LOCAL_ILLUMINATION_MODEL_FILEWATCHER_H
+
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+// Reports which of a set of files changed since the last poll, without blocking. On Linux it listens to inotify on
+// the files' directories, so editors that save by renaming a temporary file are seen too. Elsewhere it compares
+// modification times and sizes, and only reports a file once they stayed the same for one poll, so a save still
+// being written is not picked up half-way.
+class FileWatcher {
+private:
+    struct watchedFile {
+        std::string path;
+        std::string directory, name;
+        int watch;              // inotify watch descriptor of the directory.
+        int64_t mtime, size;    // Last reported state.
+        int64_t seenMtime, seenSize; // State at the previous poll.
+    };
+
+    std::vector<watchedFile> m_files;
+    int m_inotify_fd;
+public:
+    FileWatcher();
+
+    ~FileWatcher();
+
+    FileWatcher(const FileWatcher &) = delete;
+
+    FileWatcher &operator=(const FileWatcher &) = delete;
+
+    // Starts watching a file and returns its id for poll().
+    unsigned int add(const std::string &filePath);
+
+    // Ids of the files that changed since the last call, each at most once.
+    std::vector<unsigned int> poll();
+
+private:
+    static bool stat(const std::string &filePath, int64_t &mtime, int64_t &size);
+};
+
+
+#endif //LOCAL_ILLUMINATION_MODEL_FILEWATCHER_H
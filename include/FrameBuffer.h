@@ -14,6 +14,14 @@ public:
 
     ~FrameBuffer();
 
+    // Owns the GL object, so it can be moved but not copied.
+    FrameBuffer(FrameBuffer &&other) noexcept
+            : m_renderer_ID(other.m_renderer_ID) { other.m_renderer_ID = 0; }
+
+    FrameBuffer(const FrameBuffer &) = delete;
+
+    FrameBuffer &operator=(const FrameBuffer &) = delete;
+
     void bind() const;
 
     void unbind() const;
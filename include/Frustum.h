@@ -0,0 +1,44 @@
+#ifndef LOCAL_ILLUMINATION_MODEL_FRUSTUM_H
+#define LOCAL_ILLUMINATION_MODEL_FRUSTUM_H
+
+
+#include "glm/glm.hpp"
+
+// The six planes of a view-projection matrix (Gribb-Hartmann), for bounding volume tests against a camera or a
+// light. Plane normals point inwards.
+class Frustum {
+private:
+    glm::vec4 m_planes[6];
+public:
+    Frustum(const glm::mat4 &viewProjection) {
+        glm::vec4 rows[4];
+        for (int i = 0; i < 4; i++) {
+            rows[i] = glm::vec4(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i],
+                                viewProjection[3][i]);
+        }
+        for (int i = 0; i < 3; i++) {
+            m_planes[2 * i] = rows[3] + rows[i];
+            m_planes[2 * i + 1] = rows[3] - rows[i];
+        }
+        for (auto &plane: m_planes) {
+            plane /= glm::length(glm::vec3(plane));
+        }
+    }
+
+    ~Frustum() {}
+
+    inline const glm::vec4 &getPlane(int index) const { return m_planes[index]; }
+
+    // Conservative: spheres near a corner may pass although they are outside.
+    bool intersects(const glm::vec3 &center, float radius) const {
+        for (const auto &plane: m_planes) {
+            if (glm::dot(glm::vec3(plane), center) + plane.w < -radius) {
+                return false;
+            }
+        }
+        return true;
+    }
+};
+
+
+#endif //LOCAL_ILLUMINATION_MODEL_FRUSTUM_H
@@ -0,0 +1,78 @@
+#ifndef LOCAL_ILLUMINATION_MODEL_GLSTATE_H
+#define LOCAL_ILLUMINATION_MODEL_GLSTATE_H
+
+
+#include <unordered_map>
+#include "GL/glew.h"
+
+#define GL_STATE_TEXTURE_UNITS 32 // Units whose 2D texture is tracked; binds on higher ones always reach GL.
+#define GL_STATE_UNKNOWN (~0u)    // A binding the cache has not seen set.
+
+// Calls through the state cache and the shaders' uniform setters since the last takeStats().
+struct glStateStats {
+    unsigned int issuedBinds, skippedBinds;       // Including viewport changes.
+    unsigned int issuedUniforms, skippedUniforms;
+};
+
+// The GL bindings of the one context, as last set through it, so binding what is already bound makes no call. The
+// wrappers route their binds of programs, vertex arrays, array, element and indirect buffers, 2D textures per unit,
+// framebuffers and the viewport here. The element buffer is vertex array state, so it is kept per vertex array.
+// Deleting objects through it unbinds them, as GL does; everything starts unknown, so the first bind always reaches
+// GL.
+class GLState {
+private:
+    unsigned int m_program, m_vertex_array, m_array_buffer, m_indirect_buffer, m_framebuffer;
+    std::unordered_map<unsigned int, unsigned int> m_element_buffers; // By vertex array.
+    unsigned int m_active_unit;
+    unsigned int m_textures[GL_STATE_TEXTURE_UNITS];
+    int m_viewport[4];
+    glStateStats m_stats;
+public:
+    GLState();
+
+    ~GLState() {}
+
+    GLState(const GLState &) = delete;
+
+    GLState &operator=(const GLState &) = delete;
+
+    void useProgram(unsigned int program);
+
+    void bindVertexArray(unsigned int vertexArray);
+
+    // GL_ARRAY_BUFFER, GL_ELEMENT_ARRAY_BUFFER and GL_DRAW_INDIRECT_BUFFER are cached; other targets go straight to
+    // GL.
+    void bindBuffer(unsigned int target, unsigned int buffer);
+
+    // Binds a 2D texture to a texture unit, making it the active unit.
+    void bindTexture(unsigned int unit, unsigned int texture);
+
+    void bindFramebuffer(unsigned int framebuffer);
+
+    void viewport(int x, int y, int width, int height);
+
+    void deleteProgram(unsigned int program);
+
+    void deleteVertexArrays(unsigned int count, const unsigned int *vertexArrays);
+
+    void deleteBuffers(unsigned int count, const unsigned int *buffers);
+
+    void deleteTextures(unsigned int count, const unsigned int *textures);
+
+    void deleteFramebuffers(unsigned int count, const unsigned int *framebuffers);
+
+    // For the shaders' uniform setters, which compare against their own copies of the values.
+    inline void countUniform(bool skipped) { (skipped ? m_stats.skippedUniforms : m_stats.issuedUniforms)++; }
+
+    glStateStats takeStats();
+
+private:
+    // Whether the cached binding already is the value; otherwise records it and counts the call to make.
+    bool isBound(unsigned int &binding, unsigned int value);
+};
+
+// The cache of the current context.
+GLState &glState();
+
+
+#endif //LOCAL_ILLUMINATION_MODEL_GLSTATE_H
@@ -0,0 +1,158 @@
+#ifndef LOCAL_ILLUMINATION_MODEL_GEOMETRYHEAP_H
+#define LOCAL_ILLUMINATION_MODEL_GEOMETRYHEAP_H
+
+
+#include <map>
+#include <vector>
+#include <memory>
+#include "VertexArray.h"
+#include "VertexBuffer.h"
+#include "VertexBufferLayout.h"
+#include "Renderer.h"
+
+#define HEAP_INITIAL_VERTICES (1u << 18) // Vertex capacity to start with; doubles when full.
+#define HEAP_INITIAL_INDEX_BYTES (1u << 22)
+#define INVALID_HEAP_HANDLE (~0u)
+#define HEAP_INSTANCE_ATTRIBUTE 3 // First location of the per-instance attributes, after the vertex attributes.
+
+// First-fit allocator over a range of units with coalescing free blocks.
+class RangeAllocator {
+private:
+    std::map<size_t, size_t> m_free; // Offset -> size, never adjacent to each other.
+    size_t m_capacity, m_used;
+public:
+    RangeAllocator(size_t capacity);
+
+    ~RangeAllocator() {}
+
+    bool allocate(size_t size, size_t &offset);
+
+    void free(size_t offset, size_t size);
+
+    // Adds [capacity, newCapacity) to the free space.
+    void grow(size_t newCapacity);
+
+    // After compaction: [0, used) is taken and the rest is one free block.
+    void reset(size_t used);
+
+    inline size_t getCapacity() const { return m_capacity; }
+
+    inline size_t getUsed() const { return m_used; }
+
+    size_t getLargestFree() const;
+
+    // 0 when all free space is one block, approaching 1 as it splinters.
+    float getFragmentation() const;
+};
+
+// Where a mesh lives in the heap.
+struct heapAllocation {
+    unsigned int vertexOffset; // In vertices: the base vertex of its draws.
+    unsigned int vertexCount;
+    size_t indexOffset;        // In bytes.
+    unsigned int indexCount;
+    unsigned int indexType;    // GL_UNSIGNED_SHORT or GL_UNSIGNED_INT.
+    bool live;
+};
+
+// Instanced draws queued for one stream: one command per distinct index range, and the instances in queue order.
+struct instanceQueue {
+    std::vector<drawElementsIndirectCommand> commands[2];                  // With 16-bit and 32-bit indices.
+    std::vector<std::vector<std::pair<unsigned int, unsigned int>>> ranges; // By handle: first index, command.
+    std::vector<unsigned int> instanceCommands; // Command of each instance; the top bit picks the index type.
+    std::vector<unsigned int> order;            // Ordered draws: the commands in the order they are drawn.
+    std::vector<unsigned char> instances, sorted; // Instance records as queued, and grouped by command.
+};
+
+// Submission counts since the last takeDrawStats().
+struct heapDrawStats {
+    unsigned int flushNum;
+    unsigned int drawCallNum;
+    unsigned int commandNum;  // Distinct index ranges drawn, each instanced.
+    unsigned int instanceNum;
+};
+
+struct heapStats {
+    size_t vertexCapacity, vertexUsed;      // In vertices.
+    size_t indexCapacity, indexUsed;        // In bytes.
+    float vertexFragmentation, indexFragmentation;
+    unsigned int meshNum;
+    unsigned int defragmentNum, growNum;
+};
+
+// All meshes in two vertex buffers (the interleaved stream and the position-only depth stream, allocated in step)
+// and one index buffer, drawn through one VAO per stream. Indices are relative to each mesh's base vertex, so meshes
+// up to 65536 vertices keep 16-bit indices; 16- and 32-bit indices share the buffer and are drawn in separate batches.
+// Handles stay valid across growth and defragmentation.
+//
+// Draws are instanced: each stream also reads per-instance attributes from its own instance buffer, and a flush
+// submits one command per distinct index range, however many instances share it. With GL 4.3 or the multi-draw
+// indirect and base instance extensions, the commands go into an indirect buffer drawn with one
+// glMultiDrawElementsIndirect per index type. On GL 3.3 each command is its own instanced draw, with the instance
+// attributes pointed at its first instance, so the call count still only grows with the meshes and their levels.
+class GeometryHeap {
+private:
+    VertexBufferLayout m_vertex_layout, m_position_layout;
+    VertexBufferLayout m_instance_layouts[2];                         // By stream.
+    std::unique_ptr<VertexBuffer> m_vertices, m_positions, m_indices; // The index data is a plain buffer object.
+    std::unique_ptr<VertexBuffer> m_instances[2], m_commands;         // Per stream, and the indirect commands.
+    VertexArray m_VA;                                                 // 0: main pass, 1: depth passes.
+    RangeAllocator m_vertex_allocator, m_index_allocator;
+    std::vector<heapAllocation> m_allocations;
+    std::vector<unsigned int> m_free_handles;
+    instanceQueue m_queues[2]; // By stream.
+    std::vector<drawElementsIndirectCommand> m_submitted;
+    bool m_indirect;
+    heapDrawStats m_draw_stats;
+    unsigned int m_defragment_num, m_grow_num;
+public:
+    // The instance layouts describe one instance's attributes for the main and the depth stream; they are read from
+    // location HEAP_INSTANCE_ATTRIBUTE on.
+    GeometryHeap(const VertexBufferLayout &vertexLayout, const VertexBufferLayout &positionLayout,
+                 const VertexBufferLayout &instanceLayout, const VertexBufferLayout &depthInstanceLayout);
+
+    ~GeometryHeap() {}
+
+    GeometryHeap(const GeometryHeap &) = delete;
+
+    GeometryHeap &operator=(const GeometryHeap &) = delete;
+
+    // Reserves room for a mesh, defragmenting or growing the buffers if it does not fit.
+    unsigned int allocate(unsigned int vertexCount, unsigned int indexCount, unsigned int indexType);
+
+    // Fills an allocation: vertices and positions in the layouts' formats, indices of its index type.
+    void upload(unsigned int handle, const void *vertices, const void *positions, const void *indices);
+
+    void free(unsigned int handle);
+
+    // Moves all meshes to the start of their buffers, leaving one free block each.
+    void defragment();
+
+    inline const heapAllocation &getAllocation(unsigned int handle) const { return m_allocations[handle]; }
+
+    heapStats getStats() const;
+
+    // Queues an instance of a range of a mesh's indices, e.g. one level of detail, for the main or the depth stream.
+    // The instance record is copied, in the stream's instance layout. Ordered draws, for blending, are drawn in the
+    // order they are queued: an instance only joins the last command, if it draws the same range. A stream's draws
+    // between flushes are either all ordered or none.
+    void addDraw(unsigned int handle, unsigned int firstIndex, unsigned int indexCount, const void *instance,
+                 bool depthOnly, bool ordered = false);
+
+    // Submits the stream's queued instances, grouped into one command per index range, then clears its queue.
+    void flush(const Renderer &renderer, const Shader &shader, bool depthOnly);
+
+    // Whether flushes use glMultiDrawElementsIndirect rather than one instanced draw per command.
+    inline bool isIndirect() const { return m_indirect; }
+
+    heapDrawStats takeDrawStats();
+
+private:
+    void bindStreams();
+
+    // Reallocates the buffers at the given capacities and copies the live meshes over, packed from the start.
+    void relocate(size_t vertexCapacity, size_t indexCapacity);
+};
+
+
+#endif //LOCAL_ILLUMINATION_MODEL_GEOMETRYHEAP_H
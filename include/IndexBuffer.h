@@ -10,9 +10,12 @@ class IndexBuffer {
 private:
     unsigned int m_renderer_ID;
     unsigned int m_count;
+    unsigned int m_type; // GL_UNSIGNED_INT or GL_UNSIGNED_SHORT.
 public:
     IndexBuffer(const unsigned int *data, unsigned int count);
 
+    IndexBuffer(const unsigned short *data, unsigned int count);
+
     ~IndexBuffer();
 
     void bind() const;
@@ -20,6 +23,8 @@ public:
     void unbind() const;
 
     inline unsigned int getCount() const { return m_count; };
+
+    inline unsigned int getType() const { return m_type; };
 };
 
 
@@ -7,6 +7,7 @@
 
 
 #include <vector>
+#include <string>
 #include "glm/glm.hpp"
 
 class Lights {
@@ -20,6 +21,8 @@ public:
 
     bool loadLights(const std::string &filePath);
 
+    void setLights(const glm::vec3 *positions, unsigned int count);
+
     glm::vec3 getLightPos(int index) const { return m_lights_pos[index]; };
 
     unsigned int getLightNum() const { return m_count; };
@@ -0,0 +1,41 @@
+#ifndef LOCAL_ILLUMINATION_MODEL_LODSELECTOR_H
+#define LOCAL_ILLUMINATION_MODEL_LODSELECTOR_H
+
+
+#include <vector>
+#include <cmath>
+#include <algorithm>
+#include "glm/glm.hpp"
+#include "Mesh.h"
+
+#define LOD_THRESHOLD 1.0f        // Screen-space error in pixels the main view tolerates.
+#define SHADOW_LOD_THRESHOLD 8.0f // Texels of error a shadow map tolerates; filtering hides the rest.
+
+// Picks a level of detail per object from its projected size for one view: the coarsest level whose simplification
+// error, projected at the object's nearest point, stays below the pixel threshold.
+class LodSelector {
+private:
+    float m_pixels_per_unit; // Pixels covered by one world unit at distance one.
+    float m_threshold;
+public:
+    LodSelector(float fovY, float viewportHeight, float pixelThreshold)
+            : m_pixels_per_unit(viewportHeight / (2.0f * std::tan(fovY / 2.0f))), m_threshold(pixelThreshold) {}
+
+    ~LodSelector() {}
+
+    // The scale brings errors measured on the mesh to world units when the object is scaled.
+    unsigned int select(const std::vector<meshLod> &lods, const glm::vec3 &eye, const glm::vec3 &center,
+                        float radius, float scale = 1.0f) const {
+        float distance = std::max(glm::length(center - eye) - radius, 1e-3f);
+        float pixelsPerUnit = scale * m_pixels_per_unit / distance;
+
+        unsigned int level = 0;
+        while (level + 1 < lods.size() && lods[level + 1].error * pixelsPerUnit < m_threshold) {
+            level++;
+        }
+        return level;
+    }
+};
+
+
+#endif //LOCAL_ILLUMINATION_MODEL_LODSELECTOR_H
@@ -0,0 +1,60 @@
+#ifndef LOCAL_ILLUMINATION_MODEL_MESH_H
+#define LOCAL_ILLUMINATION_MODEL_MESH_H
+
+
+#include <vector>
+#include <cstdint>
+#include "glm/glm.hpp"
+
+#define MAX_LOD_LEVELS 5 // Full detail included.
+
+// A level of detail: a range of meshData::indices over the shared vertices, with its geometric error.
+struct meshLod {
+    unsigned int indexOffset;
+    unsigned int indexCount;
+    float error; // Largest deviation from the full-detail surface, in world units.
+};
+
+// Indexed mesh: one entry per unique (position, normal) pair plus a triangle list into them.
+struct meshData {
+    std::vector<glm::vec3> positions;
+    std::vector<glm::vec3> normals;
+    std::vector<unsigned int> indices;
+    std::vector<meshLod> lods; // Empty until buildLodChain(); afterwards indices holds every level back to back.
+    unsigned int cornerCount = 0; // Number of triangle corners before welding.
+
+    // Whether the indices fit into GL_UNSIGNED_SHORT.
+    inline bool fitsShortIndices() const { return positions.size() <= 0xFFFF; }
+
+    std::vector<unsigned short> getShortIndices() const;
+};
+
+// Welds identical (position, normal) pairs with an open-addressing hash table.
+class VertexWelder {
+private:
+    std::vector<unsigned int> m_table; // Slot -> vertex index + 1, 0 means empty.
+    unsigned int m_mask;
+    meshData &m_mesh;
+public:
+    VertexWelder(meshData &mesh, size_t expectedVertices);
+
+    ~VertexWelder() {}
+
+    // Returns the index of the vertex, appending it to the mesh if it has not been seen yet.
+    unsigned int insert(const glm::vec3 &position, const glm::vec3 &normal);
+
+    // Appends a triangle corner to the mesh.
+    inline void addCorner(const glm::vec3 &position, const glm::vec3 &normal) {
+        m_mesh.indices.push_back(insert(position, normal));
+        m_mesh.cornerCount++;
+    }
+
+    // Forgets all welded vertices, to be called after the mesh has been emptied.
+    void clear();
+
+private:
+    void grow();
+};
+
+
+#endif //LOCAL_ILLUMINATION_MODEL_MESH_H
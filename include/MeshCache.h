@@ -0,0 +1,136 @@
+#ifndef LOCAL_ILLUMINATION_MODEL_MESHCACHE_H
+#define LOCAL_ILLUMINATION_MODEL_MESHCACHE_H
+
+
+#include <string>
+#include <cstdint>
+#include <cstdio>
+#include "glm/glm.hpp"
+#include "Mesh.h"
+
+#define MESH_CACHE_MAGIC 0x434D494Cu // "LIMC"
+// Version 3: levels of detail. Version 4: generated normals. Version 5: quantized vertices instead of float normals.
+#define MESH_CACHE_VERSION 5u
+
+// On-disk layout of a mesh cache file. The blobs follow the header, each aligned to 16 bytes.
+struct meshCacheHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t sourceHash;   // FNV-1a hash of the source .obj contents.
+    int64_t sourceMtime;   // Modification time of the source when the cache was built.
+    uint64_t sourceSize;
+    float offset[3];       // Scene offset baked into the positions.
+    float boundsMin[3];
+    float boundsMax[3];
+    uint32_t vertexCount;
+    uint32_t indexCount;
+    uint32_t cornerCount;
+    uint32_t indexSize;    // 2 or 4 bytes per index.
+    uint64_t positionsOffset;          // Full-precision positions, for the CPU.
+    uint64_t indicesOffset;
+    uint64_t verticesOffset;           // Quantized streams as uploaded: positions and normals interleaved,
+    uint64_t quantizedPositionsOffset; // and positions alone.
+    float dequantizeScale[3];          // Quantized positions are restored as position * scale + offset.
+    float dequantizeOffset[3];
+    float positionError;               // Largest quantization errors, in world units and degrees.
+    float normalError;
+    uint64_t fileSize;
+    uint32_t lodCount;
+    meshLod lods[MAX_LOD_LEVELS]; // Ranges of the index blob, level 0 first.
+};
+
+// Read-only memory mapping of a mesh cache file.
+class MeshCache {
+private:
+    void *m_data;
+    size_t m_size;
+    const meshCacheHeader *m_header;
+public:
+    MeshCache();
+
+    ~MeshCache();
+
+    MeshCache(const MeshCache &) = delete;
+
+    MeshCache &operator=(const MeshCache &) = delete;
+
+    // Maps the cache file and checks it against the source file and the scene offset.
+    bool open(const std::string &cachePath, const std::string &sourcePath, const glm::vec3 &offset);
+
+    // Holds a mesh in memory in the cache layout, for when its cache file cannot be written.
+    bool hold(const std::string &sourcePath, const glm::vec3 &offset, const meshData &mesh);
+
+    void close();
+
+    static bool write(const std::string &cachePath, const std::string &sourcePath, const glm::vec3 &offset,
+                      const meshData &mesh);
+
+    // Rewrites a cache built for another scene offset with its positions moved to the given one, which is much
+    // cheaper than rebuilding it from the source.
+    static bool rebase(const std::string &cachePath, const std::string &sourcePath, const glm::vec3 &offset);
+
+    static uint64_t hashFile(const std::string &filePath);
+
+    inline bool isOpen() const { return m_header != nullptr; }
+
+    inline unsigned int getVertexCount() const { return m_header->vertexCount; }
+
+    inline unsigned int getIndexCount() const { return m_header->indexCount; }
+
+    inline unsigned int getIndexSize() const { return m_header->indexSize; }
+
+    inline glm::vec3 getBoundsMin() const { return glm::vec3(m_header->boundsMin[0], m_header->boundsMin[1], m_header->boundsMin[2]); }
+
+    inline glm::vec3 getBoundsMax() const { return glm::vec3(m_header->boundsMax[0], m_header->boundsMax[1], m_header->boundsMax[2]); }
+
+    inline const glm::vec3 *getPositions() const { return (const glm::vec3 *) ((const char *) m_data + m_header->positionsOffset); }
+
+    inline const void *getIndices() const { return (const char *) m_data + m_header->indicesOffset; }
+
+    inline const short *getVertices() const { return (const short *) ((const char *) m_data + m_header->verticesOffset); }
+
+    inline const short *getQuantizedPositions() const { return (const short *) ((const char *) m_data + m_header->quantizedPositionsOffset); }
+
+    inline glm::vec3 getDequantizeScale() const { return glm::vec3(m_header->dequantizeScale[0], m_header->dequantizeScale[1], m_header->dequantizeScale[2]); }
+
+    inline glm::vec3 getDequantizeOffset() const { return glm::vec3(m_header->dequantizeOffset[0], m_header->dequantizeOffset[1], m_header->dequantizeOffset[2]); }
+
+    inline float getPositionError() const { return m_header->positionError; }
+
+    inline float getNormalError() const { return m_header->normalError; }
+
+    inline unsigned int getLodCount() const { return m_header->lodCount; }
+
+    inline const meshLod &getLod(unsigned int level) const { return m_header->lods[level]; }
+
+private:
+    // Maps and validates the cache file against its source, whatever its offset.
+    bool map(const std::string &cachePath, const std::string &sourcePath);
+};
+
+// Builds a cache file batch by batch. Blobs are staged in temporary files, so memory use does not grow with the mesh.
+class MeshCacheWriter {
+private:
+    std::string m_cache_path, m_source_path;
+    glm::vec3 m_offset;
+    FILE *m_positions, *m_normals, *m_indices;
+    uint32_t m_vertex_count, m_index_count, m_corner_count;
+    glm::vec3 m_bounds_min, m_bounds_max;
+public:
+    MeshCacheWriter(const std::string &cachePath, const std::string &sourcePath, const glm::vec3 &offset);
+
+    ~MeshCacheWriter();
+
+    MeshCacheWriter(const MeshCacheWriter &) = delete;
+
+    MeshCacheWriter &operator=(const MeshCacheWriter &) = delete;
+
+    // Appends an indexed batch; its indices refer to its own vertices.
+    bool append(const meshData &batch);
+
+    // Assembles the cache file, copying the staged blobs bufferSize bytes at a time.
+    bool finish(size_t bufferSize);
+};
+
+
+#endif //LOCAL_ILLUMINATION_MODEL_MESHCACHE_H
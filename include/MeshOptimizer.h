@@ -0,0 +1,35 @@
+#ifndef LOCAL_ILLUMINATION_MODEL_MESHOPTIMIZER_H
+#define LOCAL_ILLUMINATION_MODEL_MESHOPTIMIZER_H
+
+
+#include "Mesh.h"
+
+#define VERTEX_CACHE_SIZE 16   // FIFO post-transform cache size used for the statistics.
+#define OVERDRAW_THRESHOLD 1.05f // How much ACMR the overdraw pass may give up.
+
+// Post-transform vertex cache efficiency of a mesh.
+struct vertexCacheStats {
+    float acmr; // Average cache miss ratio: transformed vertices per triangle.
+    float atvr; // Average transformed vertex ratio: transformed vertices per unique vertex.
+};
+
+// Simulates a FIFO post-transform cache over the index buffer.
+vertexCacheStats analyzeVertexCache(const meshData &mesh, unsigned int cacheSize = VERTEX_CACHE_SIZE);
+
+// Reorders triangles for the post-transform vertex cache (Forsyth's linear-speed vertex cache optimisation).
+void optimizeVertexCache(meshData &mesh);
+
+void optimizeVertexCache(std::vector<unsigned int> &indices, size_t vertexNum);
+
+// Splits the triangle order into clusters at cache flushes and sorts them outside-in, so that, independent of
+// the view, triangles likely to occlude others are drawn first. Costs at most `threshold` times the ACMR.
+void optimizeOverdraw(meshData &mesh, float threshold = OVERDRAW_THRESHOLD);
+
+// Renumbers vertices in the order the index buffer first references them, dropping unused ones.
+void optimizeVertexFetch(meshData &mesh);
+
+// Runs all three passes in order and returns the statistics before and after.
+void optimizeMesh(meshData &mesh, vertexCacheStats &before, vertexCacheStats &after);
+
+
+#endif //LOCAL_ILLUMINATION_MODEL_MESHOPTIMIZER_H
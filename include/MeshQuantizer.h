@@ -0,0 +1,50 @@
+#ifndef LOCAL_ILLUMINATION_MODEL_MESHQUANTIZER_H
+#define LOCAL_ILLUMINATION_MODEL_MESHQUANTIZER_H
+
+
+#include <vector>
+#include "glm/glm.hpp"
+
+#define QUANTIZED_POSITION_SIZE 4 // Components per position: xyz and a zero that keeps them 4-byte aligned.
+#define QUANTIZED_NORMAL_SIZE 2   // Components per octahedral normal.
+#define QUANTIZED_VERTEX_SIZE (QUANTIZED_POSITION_SIZE + QUANTIZED_NORMAL_SIZE)
+
+// Vertex streams as uploaded to the GPU, 12 bytes per vertex instead of 24. Positions are normalized 16-bit
+// coordinates within the mesh's bounding box and are restored as position * scale + offset, which the renderer folds
+// into each instance's model matrix; normals are octahedral 16-bit pairs.
+struct quantizedMesh {
+    std::vector<short> vertices;  // Interleaved position and normal.
+    std::vector<short> positions; // Positions alone, for the depth passes.
+    glm::vec3 scale;
+    glm::vec3 offset;
+};
+
+// Largest error quantization introduced over a mesh.
+struct quantizationError {
+    float position; // In world units.
+    float normal;   // In degrees.
+};
+
+short quantizeSnorm16(float value);
+
+float dequantizeSnorm16(short value);
+
+// Projects a unit vector onto the octahedron and unfolds it into the square, picking the rounding that decodes
+// closest to the input.
+void encodeOctahedral(const glm::vec3 &normal, short &x, short &y);
+
+glm::vec3 decodeOctahedral(short x, short y);
+
+// The box quantized positions span: position * scale + offset maps [-1, 1] onto the bounds.
+void quantizationBox(const glm::vec3 &boundsMin, const glm::vec3 &boundsMax, glm::vec3 &scale, glm::vec3 &offset);
+
+// Quantizes vertices within a box into the interleaved stream and the position-only stream, raising error to the
+// largest error they introduce. Meshes whose bounds are known up front can be quantized a chunk at a time.
+void quantizeVertices(const glm::vec3 *positions, const glm::vec3 *normals, size_t vertexNum, const glm::vec3 &scale,
+                      const glm::vec3 &offset, short *vertices, short *quantizedPositions, quantizationError &error);
+
+quantizationError quantizeMesh(const glm::vec3 *positions, const glm::vec3 *normals, size_t vertexNum,
+                               quantizedMesh &mesh);
+
+
+#endif //LOCAL_ILLUMINATION_MODEL_MESHQUANTIZER_H
@@ -0,0 +1,20 @@
+#ifndef LOCAL_ILLUMINATION_MODEL_MESHSIMPLIFIER_H
+#define LOCAL_ILLUMINATION_MODEL_MESHSIMPLIFIER_H
+
+
+#include <vector>
+#include "Mesh.h"
+
+#define LOD_REDUCTION 0.5f     // Triangle ratio between consecutive levels of detail.
+#define LOD_MIN_TRIANGLES 16   // Meshes are not simplified below this.
+
+// Simplifies a triangle list over the mesh's vertices by quadric-error edge collapses. Only existing vertices are
+// used, so every level can share one vertex buffer. Returns the largest collapse error in world units.
+float simplifyMesh(const meshData &mesh, const std::vector<unsigned int> &indices, size_t targetIndexCount,
+                   std::vector<unsigned int> &result);
+
+// Appends up to MAX_LOD_LEVELS - 1 coarser levels to mesh.indices and fills mesh.lods, level 0 being the input.
+void buildLodChain(meshData &mesh);
+
+
+#endif //LOCAL_ILLUMINATION_MODEL_MESHSIMPLIFIER_H
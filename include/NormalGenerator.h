@@ -0,0 +1,26 @@
+#ifndef LOCAL_ILLUMINATION_MODEL_NORMALGENERATOR_H
+#define LOCAL_ILLUMINATION_MODEL_NORMALGENERATOR_H
+
+
+#include "ObjParser.h"
+
+#define CREASE_ANGLE 60.0f // Degrees between two faces beyond which their shared vertices stay sharp.
+
+// Generates vertex normals for OBJ corners that have none. A corner's normal is the area-weighted sum of the
+// normals of the faces around its position that lie within the crease angle of its own face, so a crease angle of
+// 0 gives faceted normals and 180 fully smooth ones. Work is split across threads; every sum is taken in corner
+// order, so the result does not depend on the thread count.
+class NormalGenerator {
+private:
+    unsigned int m_thread_num;
+public:
+    NormalGenerator(unsigned int threadNum = 0);
+
+    ~NormalGenerator() {}
+
+    // Returns the number of corners that got a generated normal.
+    size_t generate(objData &data, float creaseAngle = CREASE_ANGLE) const;
+};
+
+
+#endif //LOCAL_ILLUMINATION_MODEL_NORMALGENERATOR_H
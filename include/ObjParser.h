@@ -0,0 +1,43 @@
+#ifndef LOCAL_ILLUMINATION_MODEL_OBJPARSER_H
+#define LOCAL_ILLUMINATION_MODEL_OBJPARSER_H
+
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+// One triangle corner: 0-based indices into the position and normal arrays, -1 if absent.
+struct objCorner {
+    int position;
+    int normal;
+};
+
+// Geometry of an OBJ file. Polygons are fan-triangulated, texture coordinates and groups are skipped.
+struct objData {
+    std::vector<float> positions; // xyz triples.
+    std::vector<float> normals;   // xyz triples.
+    std::vector<objCorner> corners;
+};
+
+// Parses OBJ files from a memory mapping, splitting the file into newline-aligned chunks parsed in parallel.
+class ObjParser {
+private:
+    unsigned int m_thread_num;
+    std::string m_error;
+public:
+    ObjParser(unsigned int threadNum = 0);
+
+    ~ObjParser() {}
+
+    bool parse(const std::string &filePath, objData &data);
+
+    bool parse(const char *begin, const char *end, objData &data);
+
+    inline const std::string &getError() const { return m_error; }
+
+    // Parses a decimal float without locale lookups, returning the position after it or nullptr on failure.
+    static const char *parseFloat(const char *p, const char *end, float &value);
+};
+
+
+#endif //LOCAL_ILLUMINATION_MODEL_OBJPARSER_H
@@ -0,0 +1,42 @@
+#ifndef LOCAL_ILLUMINATION_MODEL_OBJSTREAMER_H
+#define LOCAL_ILLUMINATION_MODEL_OBJSTREAMER_H
+
+
+#include <string>
+#include <functional>
+#include "glm/glm.hpp"
+#include "Mesh.h"
+
+#define DEFAULT_STREAM_BUDGET (256u * 1024u * 1024u) // Bytes of working memory for streamed meshes.
+#define DEFAULT_STREAM_THRESHOLD (512ull * 1024ull * 1024ull) // OBJ files at least this large are streamed.
+
+// Streams an OBJ file through fixed-size read windows and emits welded, indexed batches.
+// Heap use is bounded by the memory budget: the read window takes a quarter of it and the batch being built
+// the rest. The vertex attribute tables that faces index into live in a file-backed mapping the kernel may page out.
+class ObjStreamer {
+private:
+    size_t m_memory_budget;
+    size_t m_window_size;
+    size_t m_batch_corners; // Maximum triangle corners per batch.
+    unsigned int m_batch_num;
+    std::string m_error;
+public:
+    ObjStreamer(size_t memoryBudget = DEFAULT_STREAM_BUDGET);
+
+    ~ObjStreamer() {}
+
+    // Calls consume for every batch; each batch's indices refer to its own vertices. Stops if consume returns false.
+    bool stream(const std::string &filePath, const glm::vec3 &offset,
+                const std::function<bool(meshData &batch)> &consume);
+
+    inline const std::string &getError() const { return m_error; }
+
+    inline unsigned int getBatchNum() const { return m_batch_num; }
+
+    inline size_t getWindowSize() const { return m_window_size; }
+
+    inline size_t getBatchCorners() const { return m_batch_corners; }
+};
+
+
+#endif //LOCAL_ILLUMINATION_MODEL_OBJSTREAMER_H
@@ -0,0 +1,100 @@
+#ifndef LOCAL_ILLUMINATION_MODEL_OCCLUSIONCULLER_H
+#define LOCAL_ILLUMINATION_MODEL_OCCLUSIONCULLER_H
+
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include "glm/glm.hpp"
+
+#define OCCLUSION_WIDTH 320      // Depth buffer resolution, at the window's aspect ratio.
+#define OCCLUSION_HEIGHT 180
+#define OCCLUSION_TILE_WIDTH 64  // Tiles are rasterized in parallel; widths are multiples of SIMD_WIDTH.
+#define OCCLUSION_TILE_HEIGHT 36
+#define OCCLUSION_MIN_PARALLEL_TRIANGLES 1024 // Fewer binned triangles are not worth another thread.
+
+// An occluder triangle in pixel coordinates, set up for rasterization: its edge functions, positive inside, and the
+// plane of its depths.
+struct occluderTriangle {
+    float edgeA[3], edgeB[3], edgeC[3]; // Edge k is edgeA[k] * x + edgeB[k] * y + edgeC[k].
+    float depth, depthX, depthY;        // depth + depthX * x + depthY * y, already the farthest within a pixel.
+    float maxDepth;                     // Of its corners.
+    int minX, maxX, minY, maxY;         // The pixels whose centers may be inside.
+};
+
+// Hierarchical-Z occlusion culling on the CPU. Occluder meshes are transformed, clipped at the near plane and binned
+// into screen tiles; the tiles are then rasterized across threads into a low resolution depth buffer, four pixels
+// per SIMD step. Every level of the pyramid above it keeps the farthest depth of a 2x2 block of the level below, so
+// a box is tested by its nearest depth against at most 2x2 texels of the level where its screen rectangle is that
+// small. Pixels keep the farthest depth their triangle reaches in them, so boxes are not hidden by depth rounding;
+// coverage is sampled at pixel centers, as the GPU does. The worker threads are started once and wait between
+// frames.
+class OcclusionCuller {
+private:
+    std::vector<std::vector<float>> m_levels; // Level 0 is the depth buffer; each next one halves it, rounding up.
+    std::vector<unsigned int> m_level_widths, m_level_heights;
+    std::vector<occluderTriangle> m_triangles;
+    std::vector<glm::vec4> m_clip; // The current occluder's vertices in clip space.
+    std::vector<std::vector<unsigned int>> m_bins; // Triangles by tile.
+    size_t m_binned_num;
+    glm::mat4 m_view_projection;
+    std::vector<std::thread> m_workers; // The caller of rasterize() is one more.
+    std::mutex m_mutex;
+    std::condition_variable m_wake, m_done;
+    unsigned int m_generation, m_busy; // Rasterizations started, and workers still in the current one.
+    bool m_stop;
+    std::atomic<unsigned int> m_next_tile;
+public:
+    OcclusionCuller(unsigned int threadNum = 0);
+
+    ~OcclusionCuller();
+
+    OcclusionCuller(const OcclusionCuller &) = delete;
+
+    OcclusionCuller &operator=(const OcclusionCuller &) = delete;
+
+    // Clears the depth buffer and the occluders for a camera.
+    void begin(const glm::mat4 &viewProjection);
+
+    // Adds the triangles of an occluder, indices into its model-space positions.
+    void addOccluder(const glm::mat4 &model, const glm::vec3 *positions, size_t vertexNum,
+                     const unsigned int *indices, size_t indexNum);
+
+    void addOccluder(const glm::mat4 &model, const glm::vec3 *positions, size_t vertexNum,
+                     const unsigned short *indices, size_t indexNum);
+
+    // Rasterizes the occluders added since begin() and builds the pyramid.
+    void rasterize();
+
+    // Whether any part of the world-space box may be in front of the occluders. Boxes reaching behind the camera
+    // or off the screen are.
+    bool isVisible(const glm::vec3 &min, const glm::vec3 &max) const;
+
+    // Removes the objects whose boxes are hidden, keeping the order; returns how many were removed.
+    size_t cull(std::vector<unsigned int> &objects, const glm::vec3 *mins, const glm::vec3 *maxs) const;
+
+    inline size_t getTriangleNum() const { return m_triangles.size(); }
+
+    inline const float *getDepth() const { return m_levels[0].data(); }
+
+private:
+    template<typename Index>
+    void addIndexedOccluder(const glm::mat4 &model, const glm::vec3 *positions, size_t vertexNum, const Index *indices,
+                            size_t indexNum);
+
+    void addTriangle(const glm::vec3 &a, const glm::vec3 &b, const glm::vec3 &c);
+
+    void rasterizeTile(unsigned int tile);
+
+    // Takes tiles from m_next_tile until none are left.
+    void rasterizeTiles();
+
+    void workerLoop();
+
+    void buildPyramid();
+};
+
+
+#endif //LOCAL_ILLUMINATION_MODEL_OCCLUSIONCULLER_H
@@ -0,0 +1,82 @@
+#ifndef LOCAL_ILLUMINATION_MODEL_PVS_H
+#define LOCAL_ILLUMINATION_MODEL_PVS_H
+
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include "glm/glm.hpp"
+
+#define PVS_MAGIC 0x31535650u // "PVS1"
+#define PVS_VERSION 1u
+
+// How a cell's bitset is stored: its first byte.
+#define PVS_RAW 0u  // The bits, object 0 in the lowest bit of the first byte.
+#define PVS_RUNS 1u // Alternating runs of hidden and visible objects, hidden first, as LEB128 numbers.
+
+// On-disk layout of a potentially visible set.
+struct pvsHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t inputHash;    // Of the scene file and the contents of its mesh files.
+    uint32_t objectNum;
+    uint32_t cellsX;       // Cells along x and z; cell x + cellsX * z.
+    uint32_t cellsZ;
+    float originX;         // The grid's corner with the smallest coordinates.
+    float originZ;
+    float cellSize;
+    float minY;            // The band of heights every cell covers.
+    float maxY;
+    uint64_t offsetsOffset; // uint32_t per cell and one past the last: where each cell starts in the data.
+    uint64_t dataOffset;
+    uint64_t fileSize;
+};
+
+// A potentially visible set baked offline for a static scene: the walkable space is split into square cells over a
+// band of heights, and each cell keeps the bitset of the objects, in scene order, seen from anywhere inside it.
+// Bitsets are run-length encoded, or stored raw when that is smaller.
+class Pvs {
+private:
+    std::vector<unsigned char> m_file;
+    pvsHeader m_header;
+    std::string m_error;
+public:
+    Pvs() : m_header() {}
+
+    ~Pvs() {}
+
+    // Fails if the file is missing, damaged or baked from other inputs than the hash's.
+    bool load(const std::string &filePath, uint64_t inputHash);
+
+    void close();
+
+    inline bool isOpen() const { return !m_file.empty(); }
+
+    inline const pvsHeader &getHeader() const { return m_header; }
+
+    inline size_t getCellNum() const { return size_t(m_header.cellsX) * m_header.cellsZ; }
+
+    inline size_t getFileSize() const { return m_file.size(); }
+
+    // The cell holding the position, or -1 outside the grid.
+    int findCell(const glm::vec3 &position) const;
+
+    // One byte per object, 1 where it is visible from the cell.
+    void decode(unsigned int cell, std::vector<unsigned char> &visible) const;
+
+    inline const std::string &getError() const { return m_error; }
+
+    // The header's grid fields describe the cells; one byte per object and cell, cell by cell.
+    static bool write(const std::string &filePath, pvsHeader header,
+                      const std::vector<std::vector<unsigned char>> &cells);
+
+    // Appends a bitset's encoding, whichever is smaller.
+    static void encode(const std::vector<unsigned char> &visible, std::vector<unsigned char> &encoded);
+
+    // What a PVS is baked from: the contents of the scene file and of every mesh file it declares, by their FNV-1a
+    // hashes, so callers can take the mesh hashes from a cache of file identities.
+    static uint64_t hashInputs(uint64_t sceneHash, const std::vector<uint64_t> &meshHashes);
+};
+
+
+#endif //LOCAL_ILLUMINATION_MODEL_PVS_H
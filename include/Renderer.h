@@ -8,6 +8,9 @@
 
 #include "GL/glew.h"
 #include "cassert"
+#include <vector>
+#include <cstdint>
+#include <functional>
 #include "VertexArray.h"
 #include "IndexBuffer.h"
 #include "Shader.h"
@@ -22,11 +25,85 @@ void GLClearError();
 
 bool GLLogCall(const char *function, const char *file, int line);
 
+// Render command sort keys, from the most significant bits: the pass, the shader, the vertex array, a depth bucket and
+// the mesh. Commands sharing the first three share their GL state; within it they run by depth, and the heap merges
+// the instances of each mesh whatever their order, so the mesh only breaks depth ties.
+#define RENDER_KEY_PASS_SHIFT 56   // 8 bits: passes run in increasing order.
+#define RENDER_KEY_SHADER_SHIFT 52 // 4 bits.
+#define RENDER_KEY_VAO_SHIFT 48    // 4 bits: the vertex array, or the stream of the geometry heap's.
+#define RENDER_KEY_STATE_SHIFT 48  // The bits above it select the state.
+#define RENDER_KEY_DEPTH_SHIFT 24  // The top bits of the depth as a float, which order like it.
+#define RENDER_KEY_DEPTH_BITS 24
+#define RENDER_KEY_MESH_BITS 24
+
+// A draw waiting in the render queue; the payload tells the caller what to draw.
+struct renderCommand {
+    uint64_t key;
+    unsigned int payload;
+};
+
+// Render queue counts since the last takeQueueStats().
+struct renderQueueStats {
+    unsigned int commandNum;
+    unsigned int stateChangeNum; // Runs of commands sharing pass, shader and vertex array.
+    unsigned int executeNum;
+    double sortSeconds;
+};
+
+// One instanced draw, laid out as glMultiDrawElementsIndirect reads it from the indirect buffer.
+struct drawElementsIndirectCommand {
+    GLuint count;
+    GLuint instanceCount;
+    GLuint firstIndex;   // In indices of the draw's index type, not bytes.
+    GLint baseVertex;
+    GLuint baseInstance; // First element of the per-instance attributes.
+};
+
 class Renderer {
+private:
+    std::vector<renderCommand> m_commands, m_sorted; // As submitted, and the radix sort's other buffer.
+    renderQueueStats m_queue_stats;
 public:
+    Renderer() : m_queue_stats() {}
+
     void draw(const VertexArray &va, const IndexBuffer &ib, const Shader &shader) const;
 
+    void draw(const VertexArray &va, unsigned int index, const IndexBuffer &ib, const Shader &shader) const;
+
+    // Draws count indices starting at first, e.g. one level of detail.
+    void draw(const VertexArray &va, unsigned int index, const IndexBuffer &ib, const Shader &shader,
+              unsigned int first, unsigned int count) const;
+
+    // Draws count commands of the buffer bound to GL_DRAW_INDIRECT_BUFFER, from a byte offset, in one call; the index
+    // buffer is the one bound in the VAO. Needs GL 4.3 or ARB_multi_draw_indirect and ARB_base_instance.
+    void multiDrawIndirect(const VertexArray &va, unsigned int index, const Shader &shader, unsigned int type,
+                           size_t offset, unsigned int count) const;
+
+    // Draws one command without an indirect buffer, for GL 3.3. Its base instance is ignored: there is none before
+    // GL 4.2, so the caller points the per-instance attributes at it instead.
+    void drawInstanced(const VertexArray &va, unsigned int index, const Shader &shader, unsigned int type,
+                       const drawElementsIndirectCommand &command) const;
+
     void clear() const;
+
+    // Depth is the distance from the eye along its view, negative ones counting as 0. Back-to-front commands, for
+    // blending, invert it.
+    static uint64_t makeKey(unsigned int pass, unsigned int shader, unsigned int vertexArray, float depth,
+                            bool backToFront, unsigned int mesh);
+
+    static inline unsigned int getPass(uint64_t key) { return key >> RENDER_KEY_PASS_SHIFT; }
+
+    static inline unsigned int getState(uint64_t key) { return key >> RENDER_KEY_STATE_SHIFT; }
+
+    inline void submit(uint64_t key, unsigned int payload) { m_commands.push_back({key, payload}); }
+
+    // Radix-sorts the submitted commands by key, keeping the submission order of equal keys, runs them and empties
+    // the queue. Each run of commands sharing a state is bracketed by beginState and endState, given its first key;
+    // draw gets the payload of every command.
+    void execute(const std::function<void(uint64_t)> &beginState, const std::function<void(unsigned int)> &draw,
+                 const std::function<void(uint64_t)> &endState);
+
+    renderQueueStats takeQueueStats();
 };
 
 
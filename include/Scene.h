@@ -0,0 +1,105 @@
+#ifndef LOCAL_ILLUMINATION_MODEL_SCENE_H
+#define LOCAL_ILLUMINATION_MODEL_SCENE_H
+
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <string_view>
+#include "glm/glm.hpp"
+#include "TextTokenizer.h"
+
+// Material defaults for objects that do not set them.
+#define MATERIAL_COLOR 1.0f, 0.5f, 0.31f
+#define MATERIAL_AMBIENT 0.1f
+#define MATERIAL_DIFFUSE 0.8f
+#define MATERIAL_SPECULAR 0.5f
+#define MATERIAL_SHININESS 2
+#define MATERIAL_ALPHA 0.3f // Only translucent objects use it.
+
+#define SCENE_ROOT (~0u) // Parent of the objects placed in world space.
+
+struct sceneMaterial {
+    glm::vec3 color = glm::vec3(MATERIAL_COLOR);
+    float ambient = MATERIAL_AMBIENT;
+    float diffuse = MATERIAL_DIFFUSE;
+    float specular = MATERIAL_SPECULAR;
+    int shininess = MATERIAL_SHININESS;
+    float alpha = MATERIAL_ALPHA;
+};
+
+// A scene description: mesh assets declared once by name, and any number of objects placing them.
+//
+//   mesh <name> <file>           The file is relative to the scene file.
+//   object <mesh> [<key> <values>...]
+//
+// Object keys, all optional: position x y z, rotation x y z (degrees about x, then y, then z), scale x y z (or one
+// uniform factor), translucent, occluder, color r g b, ambient a, diffuse d, specular s, shininess n, alpha a,
+// name <id> and parent <id>. Occluders are drawn into the CPU depth buffer that hides objects behind them; they
+// should be large and opaque, like walls. An object with a parent is placed relative to it; the parent must be named
+// on an earlier line. Lines starting with '#' are comments. Objects are stored as parallel arrays, one element per
+// object.
+class Scene {
+private:
+    std::vector<std::string> m_mesh_names, m_mesh_paths;
+    std::vector<unsigned int> m_meshes; // Index into the mesh names and paths.
+    std::vector<unsigned int> m_parents; // An earlier object, or SCENE_ROOT.
+    std::vector<glm::vec3> m_positions, m_rotations, m_scales;
+    std::vector<unsigned char> m_translucent;
+    std::vector<unsigned char> m_occluders;
+    std::vector<sceneMaterial> m_materials;
+    std::string m_error;
+public:
+    Scene() {}
+
+    ~Scene() {}
+
+    // Replaces the scene with the file's; on failure the scene is left empty and getError() says where.
+    bool load(const std::string &filePath);
+
+    // Builds a scene in code; the mesh of an object is an index returned by addMesh.
+    unsigned int addMesh(const std::string &name, const std::string &path);
+
+    void addObject(unsigned int mesh, const glm::vec3 &position, const glm::vec3 &rotation, const glm::vec3 &scale,
+                   bool translucent, bool occluder, const sceneMaterial &material, unsigned int parent = SCENE_ROOT);
+
+    void reserve(size_t objectNum);
+
+    inline size_t getMeshNum() const { return m_mesh_paths.size(); }
+
+    inline const std::string &getMeshName(size_t i) const { return m_mesh_names[i]; }
+
+    inline const std::string &getMeshPath(size_t i) const { return m_mesh_paths[i]; }
+
+    inline size_t getObjectNum() const { return m_meshes.size(); }
+
+    inline unsigned int getMesh(size_t i) const { return m_meshes[i]; }
+
+    inline unsigned int getParent(size_t i) const { return m_parents[i]; }
+
+    inline const glm::vec3 &getPosition(size_t i) const { return m_positions[i]; }
+
+    inline const glm::vec3 &getRotation(size_t i) const { return m_rotations[i]; }
+
+    inline const glm::vec3 &getScale(size_t i) const { return m_scales[i]; }
+
+    inline bool isTranslucent(size_t i) const { return m_translucent[i]; }
+
+    inline bool isOccluder(size_t i) const { return m_occluders[i]; }
+
+    inline const sceneMaterial &getMaterial(size_t i) const { return m_materials[i]; }
+
+    // Relative to the parent.
+    glm::mat4 getModel(size_t i) const;
+
+    inline const std::string &getError() const { return m_error; }
+
+private:
+    void clear();
+
+    // Reads the optional keys of the object just added; objects are named in the map as they are read.
+    bool parseObjectKeys(TextTokenizer &tokens, std::unordered_map<std::string_view, unsigned int> &objects);
+};
+
+
+#endif //LOCAL_ILLUMINATION_MODEL_SCENE_H
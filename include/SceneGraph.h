@@ -0,0 +1,63 @@
+#ifndef LOCAL_ILLUMINATION_MODEL_SCENEGRAPH_H
+#define LOCAL_ILLUMINATION_MODEL_SCENEGRAPH_H
+
+
+#include <vector>
+#include "glm/glm.hpp"
+#include "glm/gtc/quaternion.hpp"
+
+#define INVALID_NODE (~0u)
+
+// A transform hierarchy. Each node stores its local translation, rotation and scale; update() recomputes the world
+// and normal matrices of the nodes whose local transform, or an ancestor's, changed since the last update. Nodes
+// are created after their parents and every attribute lives in its own contiguous array in creation order, so one
+// forward pass over the dirty flags updates whole subtrees.
+class SceneGraph {
+private:
+    std::vector<unsigned int> m_parents;
+    std::vector<glm::vec3> m_translations, m_scales;
+    std::vector<glm::quat> m_rotations;
+    std::vector<glm::mat4> m_worlds;
+    std::vector<glm::mat3> m_normals; // Inverse transpose of the world matrices' upper 3x3.
+    std::vector<unsigned char> m_dirty;
+    std::vector<unsigned int> m_updated;
+    bool m_any_dirty;
+public:
+    SceneGraph() : m_any_dirty(false) {}
+
+    ~SceneGraph() {}
+
+    // The parent must already exist; INVALID_NODE makes a root.
+    unsigned int add(unsigned int parent, const glm::vec3 &translation, const glm::quat &rotation,
+                     const glm::vec3 &scale);
+
+    void setLocal(unsigned int node, const glm::vec3 &translation, const glm::quat &rotation,
+                  const glm::vec3 &scale);
+
+    void reserve(size_t nodeNum);
+
+    void clear();
+
+    // Recomputes the dirty subtrees and returns the nodes whose world matrix was recomputed, in creation order.
+    const std::vector<unsigned int> &update();
+
+    // Rotation about x, then y, then z, in degrees.
+    static glm::quat eulerRotation(const glm::vec3 &degrees);
+
+    inline size_t getNodeNum() const { return m_parents.size(); }
+
+    inline unsigned int getParent(unsigned int node) const { return m_parents[node]; }
+
+    inline const glm::vec3 &getTranslation(unsigned int node) const { return m_translations[node]; }
+
+    inline const glm::quat &getRotation(unsigned int node) const { return m_rotations[node]; }
+
+    inline const glm::vec3 &getScale(unsigned int node) const { return m_scales[node]; }
+
+    inline const glm::mat4 &getWorld(unsigned int node) const { return m_worlds[node]; }
+
+    inline const glm::mat3 &getNormal(unsigned int node) const { return m_normals[node]; }
+};
+
+
+#endif //LOCAL_ILLUMINATION_MODEL_SCENEGRAPH_H
@@ -0,0 +1,117 @@
+#ifndef LOCAL_ILLUMINATION_MODEL_SCENESNAPSHOT_H
+#define LOCAL_ILLUMINATION_MODEL_SCENESNAPSHOT_H
+
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include "glm/glm.hpp"
+#include "Scene.h"
+#include "Lights.h"
+#include "AssetRegistry.h"
+
+#define SCENE_SNAPSHOT_MAGIC 0x5353494Cu // "LISS"
+#define SCENE_SNAPSHOT_VERSION 4u // Version 2: object hierarchy. Version 3: bounding boxes. Version 4: occluders.
+
+// Where an object ends up once its mesh is resolved.
+struct resolvedPlacement {
+    glm::vec3 center; // World-space bounding sphere.
+    float radius;
+    float scale;      // Largest axis scale.
+    glm::vec3 boxMin; // World-space bounding box.
+    glm::vec3 boxMax;
+};
+
+// A mesh declaration of the scene and the identity of its file when the snapshot was written.
+struct snapshotMesh {
+    uint32_t nameOffset, nameLength; // Into the string blob.
+    uint32_t pathOffset, pathLength;
+    fileIdentity identity;
+};
+
+// On-disk layout of a scene snapshot. The arrays follow the header, each aligned to 16 bytes.
+struct sceneSnapshotHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t inputHash;        // Of the scene and lights files and the identities of the mesh files.
+    uint32_t meshNum;
+    uint32_t objectNum;
+    uint32_t lightNum;
+    uint32_t stringSize;
+    uint64_t meshesOffset;     // snapshotMesh per declaration.
+    uint64_t stringsOffset;
+    uint64_t objectMeshesOffset; // uint32_t per object, likewise parents.
+    uint64_t parentsOffset;
+    uint64_t positionsOffset;  // glm::vec3 per object, likewise rotations and scales.
+    uint64_t rotationsOffset;
+    uint64_t scalesOffset;
+    uint64_t translucentOffset; // One byte per object, likewise occluders.
+    uint64_t occludersOffset;
+    uint64_t materialsOffset;  // sceneMaterial per object.
+    uint64_t placementsOffset; // resolvedPlacement per object.
+    uint64_t lightsOffset;     // glm::vec3 per light.
+    uint64_t lightSpacesOffset; // glm::mat4 per light.
+    uint64_t fileSize;
+};
+
+// Read-only memory mapping of a scene snapshot: the fully resolved scene, so that startup only has to open the mesh
+// caches, compose the object transforms and upload the meshes. The snapshot is valid while the scene and lights files have the same contents and every
+// mesh file the same modification time and size.
+class SceneSnapshot {
+private:
+    void *m_data;
+    size_t m_size;
+    const sceneSnapshotHeader *m_header;
+    std::string m_error;
+public:
+    SceneSnapshot();
+
+    ~SceneSnapshot();
+
+    SceneSnapshot(const SceneSnapshot &) = delete;
+
+    SceneSnapshot &operator=(const SceneSnapshot &) = delete;
+
+    // Maps the snapshot and checks it against its inputs; getError() says why it cannot be used.
+    bool open(const std::string &snapshotPath, const std::string &scenePath, const std::string &lightsPath);
+
+    void close();
+
+    // Mesh identities are indexed like the scene's mesh declarations.
+    static bool write(const std::string &snapshotPath, const std::string &scenePath, const std::string &lightsPath,
+                      const Scene &scene, const std::vector<fileIdentity> &meshIdentities,
+                      const std::vector<resolvedPlacement> &placements, const Lights &lights,
+                      const std::vector<glm::mat4> &lightSpaceMatrices);
+
+    // Rebuilds the scene and lights the snapshot was written from.
+    void restore(Scene &scene, Lights &lights) const;
+
+    inline bool isOpen() const { return m_header != nullptr; }
+
+    inline unsigned int getMeshNum() const { return m_header->meshNum; }
+
+    inline const fileIdentity &getMeshIdentity(size_t i) const { return getMeshes()[i].identity; }
+
+    inline size_t getObjectNum() const { return m_header->objectNum; }
+
+    inline const resolvedPlacement &getPlacement(size_t i) const { return ((const resolvedPlacement *) at(m_header->placementsOffset))[i]; }
+
+    inline unsigned int getLightNum() const { return m_header->lightNum; }
+
+    inline const glm::mat4 &getLightSpaceMatrix(size_t i) const { return ((const glm::mat4 *) at(m_header->lightSpacesOffset))[i]; }
+
+    inline const std::string &getError() const { return m_error; }
+
+private:
+    inline const void *at(uint64_t offset) const { return (const char *) m_data + offset; }
+
+    inline const snapshotMesh *getMeshes() const { return (const snapshotMesh *) at(m_header->meshesOffset); }
+
+    std::string getString(uint32_t offset, uint32_t length) const;
+
+    // Whether every array lies inside the file and every object refers to a declared mesh and an earlier parent.
+    bool isConsistent() const;
+};
+
+
+#endif //LOCAL_ILLUMINATION_MODEL_SCENESNAPSHOT_H
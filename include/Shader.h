@@ -9,8 +9,15 @@
 #include "GL/glew.h"
 #include <string>
 #include <unordered_map>
+#include <vector>
 #include "glm/matrix.hpp"
 
+// The last value set for a uniform location, to skip setting it again.
+struct uniformValue {
+    float data[16];
+    unsigned int size; // In floats; 0 until it is first set.
+};
+
 struct shaderProgramSource {
     std::string vertexShaderSource;
     std::string fragmentShaderSource;
@@ -21,6 +28,7 @@ private:
     std::string m_file_path1, m_file_path2;
     unsigned int m_renderer_ID;
     std::unordered_map<std::string, int> m_uniform_location_cache; // Caching for uniforms.
+    std::vector<uniformValue> m_uniform_values; // By location.
 public:
     Shader(const std::string &filePath);
 
@@ -32,7 +40,7 @@ public:
 
     void unbind() const;
 
-    // Set uniforms.
+    // Set uniforms. Values equal to the last ones set are not sent again.
     void setUniform1i(const std::string &name, int value);
 
     void setUniform1f(const std::string &name, float value);
@@ -41,11 +49,16 @@ public:
 
     void setUniform4f(const std::string &name, float f0, float f1, float f2, float f3);
 
+    void setUniformMatrix3fv(const std::string &name, unsigned int count, bool transpose, glm::mat3 value);
+
     void setUniformMatrix4fv(const std::string &name, unsigned int count, bool transpose, glm::mat4 value);
 
 private:
     int getUniformLocation(const std::string &name);
 
+    // Whether the location already holds the value; otherwise records it. Unused locations always hold it.
+    bool holds(int location, const void *value, unsigned int size);
+
     shaderProgramSource parseShader(const std::string &filePath);
 
     shaderProgramSource parseShader(const std::string &vertexShader, const std::string &fragmentShader);
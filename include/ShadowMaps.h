@@ -0,0 +1,61 @@
+#ifndef LOCAL_ILLUMINATION_MODEL_SHADOWMAPS_H
+#define LOCAL_ILLUMINATION_MODEL_SHADOWMAPS_H
+
+
+#include <vector>
+#include <memory>
+#include "glm/glm.hpp"
+#include "Texture.h"
+#include "FrameBuffer.h"
+
+// Depth maps of the opaque and the translucent objects for every light. Nothing in the scene moves between
+// frames, so a light's maps are kept until something marks them dirty. Maps only hold the casters that shadowed
+// a visible receiver when they were rendered, so they are also re-rendered when the view needs one they lack.
+class ShadowMaps {
+private:
+    std::unique_ptr<Texture> m_opaque, m_translucent;
+    std::vector<FrameBuffer> m_opaque_FB, m_translucent_FB;
+    std::vector<bool> m_dirty;
+    std::vector<std::vector<bool>> m_casters; // By light: the objects its maps were rendered with.
+    unsigned int m_width, m_height;
+public:
+    ShadowMaps(unsigned int lightNum, unsigned int width, unsigned int height);
+
+    ~ShadowMaps() {}
+
+    // Recreates the maps for another number of lights; all of them start dirty.
+    void resize(unsigned int lightNum);
+
+    // Binds a light's framebuffer with a cleared depth buffer and a matching viewport.
+    void bindOpaque(unsigned int light) const;
+
+    void bindTranslucent(unsigned int light) const;
+
+    void unbind() const;
+
+    inline unsigned int getLightNum() const { return m_dirty.size(); }
+
+    inline unsigned int getOpaqueMap(unsigned int light) const { return m_opaque->getID(light); }
+
+    inline unsigned int getTranslucentMap(unsigned int light) const { return m_translucent->getID(light); }
+
+    inline bool isDirty(unsigned int light) const { return m_dirty[light]; }
+
+    inline void markDirty(unsigned int light) { m_dirty[light] = true; }
+
+    // Whether any of the casters is missing from the light's maps.
+    bool missesCasters(unsigned int light, const std::vector<unsigned int> &casters) const;
+
+    // Records that the light's maps were rendered with exactly these casters.
+    void markClean(unsigned int light, const std::vector<unsigned int> &casters);
+
+    void markAllDirty();
+
+    // The light space matrix cropped to what can shadow the receivers' box: its light-space rectangle, from the
+    // light's near plane to the farthest receiver. Returns false when no receiver is inside the light's frustum.
+    static bool cropToReceivers(const glm::mat4 &lightSpaceMatrix, const glm::vec3 &receiverMin,
+                                const glm::vec3 &receiverMax, glm::mat4 &cropped);
+};
+
+
+#endif //LOCAL_ILLUMINATION_MODEL_SHADOWMAPS_H
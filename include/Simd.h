@@ -0,0 +1,110 @@
+#ifndef LOCAL_ILLUMINATION_MODEL_SIMD_H
+#define LOCAL_ILLUMINATION_MODEL_SIMD_H
+
+
+#include <cmath>
+#include <algorithm>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define SIMD_SSE
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define SIMD_NEON
+#endif
+
+#define SIMD_WIDTH 4 // Lanes in a simdFloat4.
+
+// Four floats processed together: SSE on x86, NEON on Apple silicon and other 64-bit ARM, plain loops elsewhere.
+struct simdFloat4 {
+#if defined(SIMD_SSE)
+    __m128 v;
+#elif defined(SIMD_NEON)
+    float32x4_t v;
+#else
+    float v[4];
+#endif
+};
+
+inline simdFloat4 simdLoad(const float *p) {
+#if defined(SIMD_SSE)
+    return {_mm_loadu_ps(p)};
+#elif defined(SIMD_NEON)
+    return {vld1q_f32(p)};
+#else
+    return {{p[0], p[1], p[2], p[3]}};
+#endif
+}
+
+inline void simdStore(float *p, simdFloat4 a) {
+#if defined(SIMD_SSE)
+    _mm_storeu_ps(p, a.v);
+#elif defined(SIMD_NEON)
+    vst1q_f32(p, a.v);
+#else
+    std::copy(a.v, a.v + 4, p);
+#endif
+}
+
+inline simdFloat4 simdSet(float x) {
+#if defined(SIMD_SSE)
+    return {_mm_set1_ps(x)};
+#elif defined(SIMD_NEON)
+    return {vdupq_n_f32(x)};
+#else
+    return {{x, x, x, x}};
+#endif
+}
+
+#if defined(SIMD_SSE)
+#define SIMD_BINARY(name, sse, neon, scalar) \
+    inline simdFloat4 name(simdFloat4 a, simdFloat4 b) { return {sse(a.v, b.v)}; }
+#elif defined(SIMD_NEON)
+#define SIMD_BINARY(name, sse, neon, scalar) \
+    inline simdFloat4 name(simdFloat4 a, simdFloat4 b) { return {neon(a.v, b.v)}; }
+#else
+#define SIMD_BINARY(name, sse, neon, scalar) \
+    inline simdFloat4 name(simdFloat4 a, simdFloat4 b) { \
+        simdFloat4 r; \
+        for (int i = 0; i < 4; i++) { float x = a.v[i], y = b.v[i]; r.v[i] = scalar; } \
+        return r; \
+    }
+#endif
+
+SIMD_BINARY(operator+, _mm_add_ps, vaddq_f32, x + y)
+SIMD_BINARY(operator-, _mm_sub_ps, vsubq_f32, x - y)
+SIMD_BINARY(operator*, _mm_mul_ps, vmulq_f32, x * y)
+SIMD_BINARY(operator/, _mm_div_ps, vdivq_f32, x / y)
+SIMD_BINARY(simdMin, _mm_min_ps, vminq_f32, std::min(x, y))
+SIMD_BINARY(simdMax, _mm_max_ps, vmaxq_f32, std::max(x, y))
+
+#undef SIMD_BINARY
+
+inline simdFloat4 simdSqrt(simdFloat4 a) {
+#if defined(SIMD_SSE)
+    return {_mm_sqrt_ps(a.v)};
+#elif defined(SIMD_NEON)
+    return {vsqrtq_f32(a.v)};
+#else
+    return {{std::sqrt(a.v[0]), std::sqrt(a.v[1]), std::sqrt(a.v[2]), std::sqrt(a.v[3])}};
+#endif
+}
+
+// Bit i is set where a[i] < b[i].
+inline int simdLessMask(simdFloat4 a, simdFloat4 b) {
+#if defined(SIMD_SSE)
+    return _mm_movemask_ps(_mm_cmplt_ps(a.v, b.v));
+#elif defined(SIMD_NEON)
+    static const uint32_t bits[4] = {1, 2, 4, 8};
+    return vaddvq_u32(vandq_u32(vcltq_f32(a.v, b.v), vld1q_u32(bits)));
+#else
+    int mask = 0;
+    for (int i = 0; i < 4; i++) {
+        mask |= (a.v[i] < b.v[i]) << i;
+    }
+    return mask;
+#endif
+}
+
+
+#endif //LOCAL_ILLUMINATION_MODEL_SIMD_H
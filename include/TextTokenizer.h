@@ -0,0 +1,76 @@
+#ifndef LOCAL_ILLUMINATION_MODEL_TEXTTOKENIZER_H
+#define LOCAL_ILLUMINATION_MODEL_TEXTTOKENIZER_H
+
+
+#include <string>
+#include <string_view>
+
+// Line-oriented tokenizer over a memory-mapped text file. Tokens are views into the mapping and numbers are parsed in
+// place, so nothing is allocated per token; the views stay valid while the tokenizer lives. Blank lines and lines
+// starting with '#' are skipped. Errors name the file, line and column.
+class TextTokenizer {
+private:
+    void *m_data;
+    size_t m_size;
+    const char *m_begin, *m_end;
+    const char *m_p, *m_line_begin;
+    const char *m_token; // Start of the last token looked at; errors point there.
+    unsigned int m_line;
+    bool m_in_line;
+    std::string m_name, m_error;
+public:
+    TextTokenizer();
+
+    ~TextTokenizer();
+
+    TextTokenizer(const TextTokenizer &) = delete;
+
+    TextTokenizer &operator=(const TextTokenizer &) = delete;
+
+    bool open(const std::string &filePath);
+
+    // Tokenizes text already in memory; the name is used in errors.
+    void reset(const char *begin, const char *end, const std::string &name);
+
+    // Lines whose first token starts with the prefix; for sizing arrays before parsing.
+    size_t countLines(std::string_view prefix) const;
+
+    // Moves to the first token of the next line that has one. Returns false at the end of the text.
+    bool nextLine();
+
+    // Whether only whitespace is left on the current line.
+    bool atLineEnd();
+
+    // The next whitespace-delimited token of the current line; false at its end.
+    bool word(std::string_view &token);
+
+    // Parses a number, failing with a diagnostic if there is none or it runs into other characters.
+    bool number(float &value);
+
+    bool number(int &value);
+
+    // Whether the next token starts like a number.
+    bool peekNumber();
+
+    // Consumes the character if it comes next.
+    bool character(char c);
+
+    // Records "<file>:<line>:<column>: <message>" for the last token looked at. Always returns false.
+    bool fail(const std::string &message);
+
+    inline unsigned int getLine() const { return m_line; }
+
+    inline unsigned int getColumn() const { return m_token - m_line_begin + 1; }
+
+    inline const std::string &getError() const { return m_error; }
+
+private:
+    void close();
+
+    void skipSpaces();
+
+    bool endNumber(const char *end);
+};
+
+
+#endif //LOCAL_ILLUMINATION_MODEL_TEXTTOKENIZER_H
@@ -28,7 +28,7 @@ public:
 
     void bind(unsigned int slot = 0) const;
 
-    void unBind() const;
+    void unBind(unsigned int slot = 0) const;
 
     inline int getWidth() const { return m_width; }
 
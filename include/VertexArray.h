@@ -6,6 +6,7 @@
 #define OPENGL_TEST_VERTEXARRAY_H
 
 
+#include <vector>
 #include "VertexBuffer.h"
 
 class VertexBufferLayout;
@@ -19,9 +20,14 @@ public:
 
     ~VertexArray();
 
-    void addBuffer(unsigned int index,const VertexBuffer &vb, const VertexBufferLayout &layout);
+    // Binds the layout's attributes to consecutive locations starting at firstAttribute; returns the next free one.
+    // The attributes read from offset bytes into the buffer.
+    unsigned int addBuffer(unsigned int index, const VertexBuffer &vb, const VertexBufferLayout &layout,
+                           unsigned int firstAttribute = 0, size_t offset = 0);
 
-    void addBuffers(unsigned int index,const std::vector<VertexBuffer> &buffers, const std::vector<VertexBufferLayout> &layout, unsigned num);
+    // One stream per buffer, their attributes numbered in order across all of them.
+    void addBuffers(unsigned int index, const std::vector<const VertexBuffer *> &buffers,
+                    const std::vector<VertexBufferLayout> &layouts);
 
     void bind(unsigned int index) const;
 
@@ -17,11 +17,22 @@ public:
 
     VertexBuffer(const std::vector<glm::vec3> &data, unsigned int size);
 
+    // Uninitialised storage for sub-allocation, filled with update().
+    VertexBuffer(unsigned int size);
+
     ~VertexBuffer();
 
     void bind() const;
 
     void unbind() const;
+
+    void update(size_t offset, const void *data, size_t size) const;
+
+    // Replaces the whole storage, resizing it. The old storage is orphaned rather than overwritten, so draws still
+    // reading it do not stall the upload.
+    void replace(const void *data, size_t size) const;
+
+    inline unsigned int getID() const { return m_renderer_ID; }
 };
 
 
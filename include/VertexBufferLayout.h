@@ -13,6 +13,7 @@ struct vertexBufferElement {
     unsigned int type;
     unsigned int count;
     unsigned char normalized;
+    bool integer; // Read by the shader as int rather than converted to float.
 
     static unsigned int getSizeOfType(unsigned int type) {
         switch (type) {
@@ -20,21 +21,36 @@ struct vertexBufferElement {
                 return 4;
             case GL_UNSIGNED_INT:
                 return 4;
+            case GL_SHORT:
+                return 2;
             case GL_UNSIGNED_BYTE:
                 return 1;
+            case GL_INT_2_10_10_10_REV:
+                return 4; // The whole packed vector.
         }
         ASSERT(false);
         return 0;
     }
+
+    // Bytes the attribute takes up in a vertex.
+    inline unsigned int getSize() const {
+        return type == GL_INT_2_10_10_10_REV ? getSizeOfType(type) : count * getSizeOfType(type);
+    }
 };
 
 class VertexBufferLayout {
 private:
     std::vector<vertexBufferElement> m_elements; // Different attributes of vertices.
     unsigned int m_stride;
+    unsigned int m_divisor; // 0 advances per vertex, n per n instances.
+
+    void add(unsigned int type, unsigned int count, unsigned char normalized, bool integer = false) {
+        m_elements.push_back({type, count, normalized, integer});
+        m_stride += m_elements.back().getSize();
+    }
 public:
     VertexBufferLayout()
-            : m_stride(0) {};
+            : m_stride(0), m_divisor(0) {};
 
     ~VertexBufferLayout() {}
 
@@ -43,28 +59,58 @@ public:
         ASSERT(false);
     }
 
-    template<>
-    void push<float>(unsigned int count) {
-        m_elements.push_back({GL_FLOAT, count, GL_FALSE});
-        m_stride += count * vertexBufferElement::getSizeOfType(GL_FLOAT);
+    template<class T>
+    void pushInteger(unsigned int count) {
+        ASSERT(false);
     }
 
-    template<>
-    void push<unsigned int>(unsigned int count) {
-        m_elements.push_back({GL_UNSIGNED_INT, count, GL_FALSE});
-        m_stride += count * vertexBufferElement::getSizeOfType(GL_UNSIGNED_INT);
+    // Four signed 10/10/10/2-bit components in one 32-bit word, normalized to [-1, 1].
+    void pushPacked() {
+        add(GL_INT_2_10_10_10_REV, 4, GL_TRUE);
     }
 
-    template<>
-    void push<unsigned char>(unsigned int count) {
-        m_elements.push_back({GL_UNSIGNED_BYTE, count, GL_TRUE});
-        m_stride += count * vertexBufferElement::getSizeOfType(GL_UNSIGNED_BYTE);
+    // Makes every attribute of the layout advance per instance instead of per vertex.
+    void setDivisor(unsigned int divisor) {
+        m_divisor = divisor;
     }
 
     inline const std::vector<vertexBufferElement> &getElements() const { return m_elements; };
 
     inline unsigned int getStride() const { return m_stride; };
+
+    inline unsigned int getDivisor() const { return m_divisor; };
 };
 
+template<>
+inline void VertexBufferLayout::push<float>(unsigned int count) {
+    add(GL_FLOAT, count, GL_FALSE);
+}
+
+template<>
+inline void VertexBufferLayout::push<unsigned int>(unsigned int count) {
+    add(GL_UNSIGNED_INT, count, GL_FALSE);
+}
+
+// Signed 16-bit components, normalized to [-1, 1].
+template<>
+inline void VertexBufferLayout::push<short>(unsigned int count) {
+    add(GL_SHORT, count, GL_TRUE);
+}
+
+template<>
+inline void VertexBufferLayout::push<unsigned char>(unsigned int count) {
+    add(GL_UNSIGNED_BYTE, count, GL_TRUE);
+}
+
+template<>
+inline void VertexBufferLayout::pushInteger<short>(unsigned int count) {
+    add(GL_SHORT, count, GL_FALSE, true);
+}
+
+template<>
+inline void VertexBufferLayout::pushInteger<unsigned int>(unsigned int count) {
+    add(GL_UNSIGNED_INT, count, GL_FALSE, true);
+}
+
 
 #endif //OPENGL_TEST_VERTEXBUFFERLAYOUT_H
@@ -1,10 +1,10 @@
 #version 330 core
 
-layout (location = 0) in vec3 aPos;
+layout (location = 0) in vec3 aPos;   // Quantized within the mesh's bounding box.
+layout (location = 3) in mat4 aModel; // Per instance, at HEAP_INSTANCE_ATTRIBUTE; includes the dequantization.
 
 uniform mat4 lightSpaceMatrix;
-uniform mat4 model;
 
 void main() {
-    gl_Position = lightSpaceMatrix * model * vec4(aPos, 1.0);
+    gl_Position = lightSpaceMatrix * aModel * vec4(aPos, 1.0);
 }
\ No newline at end of file
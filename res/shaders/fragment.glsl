@@ -8,21 +8,21 @@ in vec3 Normal;// 片元法向量
 uniform vec3 lightPos[LIGHT_NUM];// 光源的位置
 uniform vec3 lightColor[LIGHT_NUM];// 光源的颜色
 uniform vec3 viewPos;// 观察者位置，即摄像机位置
-uniform vec3 objectColor;// 物体的颜色
-uniform float alpha;// 半透明物体的透明度
+flat in vec3 objectColor;// 物体的颜色
+flat in float alpha;// 半透明物体的透明度
 uniform bool flag;// 片元是否位于半透明物体上
 
-// 材质属性
-uniform float ambientStrength;// Ambient light coefficient.
-uniform float specularStrength;// Specular light coefficient.
-uniform float diffuseStrength;// Diffuse coefficient.
+// 材质属性，随实例传入
+flat in float ambientStrength;// Ambient light coefficient.
+flat in float specularStrength;// Specular light coefficient.
+flat in float diffuseStrength;// Diffuse coefficient.
 
 // 光照衰减参数
 uniform float att_a;// 衰减参数 a
 uniform float att_b;// 衰减参数 b
 uniform float att_c;// 衰减参数 c
 
-uniform int n;// 幂次
+flat in int n;// 幂次
 
 // 阴影相关
 uniform sampler2D opShadowMap[LIGHT_NUM];// 不透明物体的阴影贴图
@@ -1,18 +1,43 @@
 #version 330 core
 
-layout (location = 0) in vec3 aPos;
-layout (location = 1) in vec3 aNormal;
+layout (location = 0) in vec3 aPos;    // Quantized within the mesh's bounding box.
+layout (location = 1) in vec2 aNormal; // Octahedral encoding.
+// Per instance, from HEAP_INSTANCE_ATTRIBUTE on.
+layout (location = 3) in mat4 aModel;        // Includes the mesh's dequantization.
+layout (location = 7) in mat3 aNormalMatrix; // Inverse transpose of the object's model matrix, computed on the CPU.
+layout (location = 10) in vec4 aColor;       // Object color and alpha.
+layout (location = 11) in vec4 aMaterial;    // Ambient, diffuse and specular strengths, and shininess.
 
 out vec3 FragPos;
 out vec3 Normal;
+// The instance's material, constant across its triangles.
+flat out vec3 objectColor;
+flat out float alpha;
+flat out float ambientStrength;
+flat out float diffuseStrength;
+flat out float specularStrength;
+flat out int n;
 
-uniform mat4 model;
 uniform mat4 view;
 uniform mat4 projection;
 
+vec3 decodeOctahedral(vec2 e) {
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+    return normalize(n);
+}
+
 void main() {
-    FragPos = vec3(model * vec4(aPos, 1.0));
-    Normal = mat3(transpose(inverse(model))) * aNormal;
+    FragPos = vec3(aModel * vec4(aPos, 1.0));
+    Normal = aNormalMatrix * decodeOctahedral(aNormal);
+
+    objectColor = aColor.rgb;
+    alpha = aColor.a;
+    ambientStrength = aMaterial.x;
+    diffuseStrength = aMaterial.y;
+    specularStrength = aMaterial.z;
+    n = int(aMaterial.w);
 
     gl_Position = projection * view * vec4(FragPos, 1.0);
 }
\ No newline at end of file
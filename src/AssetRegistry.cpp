@@ -0,0 +1,84 @@
+#include "AssetRegistry.h"
+#include "MeshCache.h"
+#include <sys/stat.h>
+
+AssetRegistry::AssetRegistry(const loader &load, const unloader &unload)
+        : m_load(load), m_unload(unload) {}
+
+bool AssetRegistry::identify(const std::string &path, fileIdentity &identity) {
+    struct stat st{};
+    if (stat(path.c_str(), &st) != 0) {
+        return false;
+    }
+
+    fileIdentity &file = m_identities[path];
+    if (file.mtime != (int64_t) st.st_mtime || file.size != (uint64_t) st.st_size || file.hash == 0) {
+        file = {(int64_t) st.st_mtime, (uint64_t) st.st_size, MeshCache::hashFile(path)};
+    }
+    identity = file;
+    return true;
+}
+
+unsigned int AssetRegistry::acquire(const std::string &path) {
+    fileIdentity identity;
+    if (!identify(path, identity)) {
+        return INVALID_ASSET_HANDLE;
+    }
+    uint64_t hash = identity.hash, size = identity.size;
+
+    // The size guards against hash collisions.
+    auto it = m_by_hash.find(hash);
+    if (it != m_by_hash.end() && m_assets[it->second].sourceSize == size) {
+        m_assets[it->second].refCount++;
+        return it->second;
+    }
+
+    meshAsset asset{path, hash, size, 1, 0, 0, {}, glm::vec3(0.0f), 0.0f, glm::vec3(0.0f), glm::mat4(1.0f), nullptr};
+    if (!m_load(path, asset)) {
+        return INVALID_ASSET_HANDLE;
+    }
+
+    unsigned int handle;
+    if (!m_free_handles.empty()) {
+        handle = m_free_handles.back();
+        m_free_handles.pop_back();
+        m_assets[handle] = asset;
+    } else {
+        handle = m_assets.size();
+        m_assets.push_back(asset);
+    }
+    if (it == m_by_hash.end()) {
+        m_by_hash[hash] = handle;
+    }
+
+    return handle;
+}
+
+void AssetRegistry::release(unsigned int handle) {
+    meshAsset &asset = m_assets[handle];
+    if (asset.refCount == 0 || --asset.refCount > 0) {
+        return;
+    }
+
+    m_unload(asset);
+    auto it = m_by_hash.find(asset.hash);
+    if (it != m_by_hash.end() && it->second == handle) {
+        m_by_hash.erase(it);
+    }
+    asset.lods.clear();
+    asset.cache.reset();
+    m_free_handles.push_back(handle);
+}
+
+assetStats AssetRegistry::getStats() const {
+    assetStats stats{0, 0, 0, 0};
+    for (const meshAsset &asset: m_assets) {
+        if (asset.refCount > 0) {
+            stats.assetNum++;
+            stats.placementNum += asset.refCount;
+            stats.loadedBytes += asset.bytes;
+            stats.placedBytes += asset.bytes * asset.refCount;
+        }
+    }
+    return stats;
+}
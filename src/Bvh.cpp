@@ -0,0 +1,198 @@
+#include "Bvh.h"
+#include <algorithm>
+#include <numeric>
+#include <cfloat>
+#include "Simd.h"
+
+#define BVH_STACK_SIZE 256 // Median splits keep the depth near log4 of the object count.
+
+static inline void setChildBox(bvhNode &node, unsigned int c, const glm::vec3 &min, const glm::vec3 &max) {
+    node.minX[c] = min.x;
+    node.minY[c] = min.y;
+    node.minZ[c] = min.z;
+    node.maxX[c] = max.x;
+    node.maxY[c] = max.y;
+    node.maxZ[c] = max.z;
+}
+
+// The union of a node's children.
+static void nodeBounds(const bvhNode &node, glm::vec3 &min, glm::vec3 &max) {
+    min = glm::vec3(FLT_MAX);
+    max = glm::vec3(-FLT_MAX);
+    for (unsigned int c = 0; c < BVH_WIDTH; c++) {
+        if (node.children[c] != BVH_EMPTY) {
+            min = glm::min(min, glm::vec3(node.minX[c], node.minY[c], node.minZ[c]));
+            max = glm::max(max, glm::vec3(node.maxX[c], node.maxY[c], node.maxZ[c]));
+        }
+    }
+}
+
+void Bvh::build(const glm::vec3 *mins, const glm::vec3 *maxs, size_t objectNum) {
+    m_nodes.clear();
+    m_order.resize(objectNum);
+    std::iota(m_order.begin(), m_order.end(), 0u);
+    m_centroids.resize(objectNum);
+    for (size_t i = 0; i < objectNum; i++) {
+        m_centroids[i] = (mins[i] + maxs[i]) * 0.5f;
+    }
+    if (objectNum == 0) {
+        return;
+    }
+
+    m_nodes.reserve(objectNum / (BVH_WIDTH - 1) + 1);
+    glm::vec3 boundsMin, boundsMax;
+    buildNode(0, objectNum, mins, maxs, boundsMin, boundsMax);
+}
+
+unsigned int Bvh::split(unsigned int first, unsigned int count) {
+    glm::vec3 min(FLT_MAX), max(-FLT_MAX);
+    for (unsigned int i = first; i < first + count; i++) {
+        min = glm::min(min, m_centroids[m_order[i]]);
+        max = glm::max(max, m_centroids[m_order[i]]);
+    }
+    glm::vec3 extent = max - min;
+    int axis = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2);
+
+    unsigned int median = first + count / 2;
+    std::nth_element(m_order.begin() + first, m_order.begin() + median, m_order.begin() + first + count,
+                     [this, axis](unsigned int a, unsigned int b) {
+                         return m_centroids[a][axis] < m_centroids[b][axis];
+                     });
+    return median;
+}
+
+unsigned int Bvh::buildNode(unsigned int first, unsigned int count, const glm::vec3 *mins, const glm::vec3 *maxs,
+                            glm::vec3 &boundsMin, glm::vec3 &boundsMax) {
+    unsigned int index = m_nodes.size();
+    m_nodes.emplace_back();
+
+    // Four runs: single objects when few are left, otherwise the quarters of two levels of median splits.
+    unsigned int groupFirst[BVH_WIDTH], groupCount[BVH_WIDTH], groupNum;
+    if (count <= BVH_WIDTH) {
+        for (groupNum = 0; groupNum < count; groupNum++) {
+            groupFirst[groupNum] = first + groupNum;
+            groupCount[groupNum] = 1;
+        }
+    } else {
+        unsigned int half = split(first, count);
+        unsigned int quarter = split(first, half - first), threeQuarters = split(half, first + count - half);
+        unsigned int bounds[BVH_WIDTH + 1] = {first, quarter, half, threeQuarters, first + count};
+        for (groupNum = 0; groupNum < BVH_WIDTH; groupNum++) {
+            groupFirst[groupNum] = bounds[groupNum];
+            groupCount[groupNum] = bounds[groupNum + 1] - bounds[groupNum];
+        }
+    }
+
+    boundsMin = glm::vec3(FLT_MAX);
+    boundsMax = glm::vec3(-FLT_MAX);
+    for (unsigned int c = 0; c < BVH_WIDTH; c++) {
+        glm::vec3 childMin(0.0f), childMax(0.0f);
+        unsigned int child = BVH_EMPTY;
+        if (c < groupNum && groupCount[c] == 1) {
+            child = BVH_LEAF | groupFirst[c];
+            childMin = mins[m_order[groupFirst[c]]];
+            childMax = maxs[m_order[groupFirst[c]]];
+        } else if (c < groupNum) {
+            child = buildNode(groupFirst[c], groupCount[c], mins, maxs, childMin, childMax);
+        }
+
+        // Children are appended, so the node is looked up again.
+        bvhNode &node = m_nodes[index];
+        setChildBox(node, c, childMin, childMax);
+        node.children[c] = child;
+        node.first[c] = c < groupNum ? groupFirst[c] : 0;
+        node.count[c] = c < groupNum ? groupCount[c] : 0;
+        if (child != BVH_EMPTY) {
+            boundsMin = glm::min(boundsMin, childMin);
+            boundsMax = glm::max(boundsMax, childMax);
+        }
+    }
+    return index;
+}
+
+void Bvh::refit(const glm::vec3 *mins, const glm::vec3 *maxs) {
+    // Children follow their parents, so they are refitted first.
+    for (size_t i = m_nodes.size(); i-- > 0;) {
+        bvhNode &node = m_nodes[i];
+        for (unsigned int c = 0; c < BVH_WIDTH; c++) {
+            unsigned int child = node.children[c];
+            if (child == BVH_EMPTY) {
+                continue;
+            }
+            if (child & BVH_LEAF) {
+                unsigned int object = m_order[child & ~BVH_LEAF];
+                setChildBox(node, c, mins[object], maxs[object]);
+            } else {
+                glm::vec3 min, max;
+                nodeBounds(m_nodes[child], min, max);
+                setChildBox(node, c, min, max);
+            }
+        }
+    }
+}
+
+void Bvh::cull(const Frustum &frustum, std::vector<unsigned int> &visible) const {
+    if (m_nodes.empty()) {
+        return;
+    }
+
+    // A box is outside a plane when its corner farthest along the normal is behind it, and entirely in front of it
+    // when its nearest corner is not; which corners those are only depends on the normal's signs.
+    simdFloat4 planeX[6], planeY[6], planeZ[6], planeW[6];
+    bool positive[6][3];
+    for (int p = 0; p < 6; p++) {
+        const glm::vec4 &plane = frustum.getPlane(p);
+        planeX[p] = simdSet(plane.x);
+        planeY[p] = simdSet(plane.y);
+        planeZ[p] = simdSet(plane.z);
+        planeW[p] = simdSet(plane.w);
+        positive[p][0] = plane.x >= 0.0f;
+        positive[p][1] = plane.y >= 0.0f;
+        positive[p][2] = plane.z >= 0.0f;
+    }
+    simdFloat4 zero = simdSet(0.0f);
+
+    // Each entry carries the planes its node straddles; the others are passed already.
+    unsigned int stackNodes[BVH_STACK_SIZE], stackPlanes[BVH_STACK_SIZE];
+    int top = 0;
+    stackNodes[0] = 0;
+    stackPlanes[0] = 0x3f;
+    while (top >= 0) {
+        const bvhNode &node = m_nodes[stackNodes[top]];
+        unsigned int planes = stackPlanes[top--];
+
+        simdFloat4 minX = simdLoad(node.minX), minY = simdLoad(node.minY), minZ = simdLoad(node.minZ);
+        simdFloat4 maxX = simdLoad(node.maxX), maxY = simdLoad(node.maxY), maxZ = simdLoad(node.maxZ);
+        int outside = 0, straddles[6] = {0, 0, 0, 0, 0, 0};
+        for (int p = 0; p < 6; p++) {
+            if (!(planes & (1u << p))) {
+                continue;
+            }
+            simdFloat4 farX = positive[p][0] ? maxX : minX, nearX = positive[p][0] ? minX : maxX;
+            simdFloat4 farY = positive[p][1] ? maxY : minY, nearY = positive[p][1] ? minY : maxY;
+            simdFloat4 farZ = positive[p][2] ? maxZ : minZ, nearZ = positive[p][2] ? minZ : maxZ;
+            outside |= simdLessMask(farX * planeX[p] + farY * planeY[p] + farZ * planeZ[p] + planeW[p], zero);
+            straddles[p] = simdLessMask(nearX * planeX[p] + nearY * planeY[p] + nearZ * planeZ[p] + planeW[p],
+                                        zero);
+        }
+
+        for (unsigned int c = 0; c < BVH_WIDTH; c++) {
+            unsigned int child = node.children[c];
+            if (child == BVH_EMPTY || (outside & (1 << c))) {
+                continue;
+            }
+            unsigned int childPlanes = 0;
+            for (int p = 0; p < 6; p++) {
+                childPlanes |= ((straddles[p] >> c) & 1u) << p;
+            }
+            if (childPlanes == 0 || (child & BVH_LEAF)) {
+                visible.insert(visible.end(), m_order.begin() + node.first[c],
+                               m_order.begin() + node.first[c] + node.count[c]);
+            } else {
+                top++;
+                stackNodes[top] = child;
+                stackPlanes[top] = childPlanes;
+            }
+        }
+    }
+}
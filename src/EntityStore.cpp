@@ -0,0 +1,108 @@
+#include "EntityStore.h"
+
+unsigned int EntityStore::create(unsigned int node, unsigned int asset, const sceneMaterial &material,
+                                 unsigned char flags) {
+    unsigned int slot;
+    if (!m_free_slots.empty()) {
+        slot = m_free_slots.back();
+        m_free_slots.pop_back();
+    } else if (m_slot_indices.size() < MAX_ENTITIES) {
+        slot = m_slot_indices.size();
+        m_slot_indices.push_back(0);
+        m_slot_generations.push_back(0);
+    } else {
+        return INVALID_ENTITY;
+    }
+
+    unsigned int handle = slot | (m_slot_generations[slot] << ENTITY_INDEX_BITS);
+    m_slot_indices[slot] = m_handles.size();
+    m_nodes.push_back(node);
+    m_centers.emplace_back(0.0f);
+    m_radii.push_back(0.0f);
+    m_scales.push_back(1.0f);
+    m_box_mins.emplace_back(0.0f);
+    m_box_maxs.emplace_back(0.0f);
+    m_assets.push_back(asset);
+    m_materials.push_back(material);
+    m_flags.push_back(flags);
+    m_handles.push_back(handle);
+    return handle;
+}
+
+bool EntityStore::isAlive(unsigned int handle) const {
+    unsigned int slot = handle & (MAX_ENTITIES - 1);
+    return handle != INVALID_ENTITY && slot < m_slot_indices.size() &&
+           m_slot_generations[slot] == handle >> ENTITY_INDEX_BITS;
+}
+
+void EntityStore::destroy(unsigned int handle) {
+    if (!isAlive(handle)) {
+        return;
+    }
+    unsigned int slot = handle & (MAX_ENTITIES - 1);
+    unsigned int index = m_slot_indices[slot], last = m_handles.size() - 1;
+
+    // The last entity fills the hole.
+    m_nodes[index] = m_nodes[last];
+    m_centers[index] = m_centers[last];
+    m_radii[index] = m_radii[last];
+    m_scales[index] = m_scales[last];
+    m_box_mins[index] = m_box_mins[last];
+    m_box_maxs[index] = m_box_maxs[last];
+    m_assets[index] = m_assets[last];
+    m_materials[index] = m_materials[last];
+    m_flags[index] = m_flags[last];
+    m_handles[index] = m_handles[last];
+    m_slot_indices[m_handles[index] & (MAX_ENTITIES - 1)] = index;
+
+    m_nodes.pop_back();
+    m_centers.pop_back();
+    m_radii.pop_back();
+    m_scales.pop_back();
+    m_box_mins.pop_back();
+    m_box_maxs.pop_back();
+    m_assets.pop_back();
+    m_materials.pop_back();
+    m_flags.pop_back();
+    m_handles.pop_back();
+
+    freeSlot(slot);
+}
+
+void EntityStore::freeSlot(unsigned int slot) {
+    // Wraps within the bits left of the handle; INVALID_ENTITY is never handed out.
+    m_slot_generations[slot] = (m_slot_generations[slot] + 1) & ((1u << (32 - ENTITY_INDEX_BITS)) - 1);
+    if ((slot | (m_slot_generations[slot] << ENTITY_INDEX_BITS)) == INVALID_ENTITY) {
+        m_slot_generations[slot] = 0;
+    }
+    m_free_slots.push_back(slot);
+}
+
+void EntityStore::reserve(size_t entityNum) {
+    m_nodes.reserve(entityNum);
+    m_centers.reserve(entityNum);
+    m_radii.reserve(entityNum);
+    m_scales.reserve(entityNum);
+    m_box_mins.reserve(entityNum);
+    m_box_maxs.reserve(entityNum);
+    m_assets.reserve(entityNum);
+    m_materials.reserve(entityNum);
+    m_flags.reserve(entityNum);
+    m_handles.reserve(entityNum);
+}
+
+void EntityStore::clear() {
+    for (unsigned int handle: m_handles) {
+        freeSlot(handle & (MAX_ENTITIES - 1));
+    }
+    m_nodes.clear();
+    m_centers.clear();
+    m_radii.clear();
+    m_scales.clear();
+    m_box_mins.clear();
+    m_box_maxs.clear();
+    m_assets.clear();
+    m_materials.clear();
+    m_flags.clear();
+    m_handles.clear();
+}
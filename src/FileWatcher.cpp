@@ -0,0 +1,106 @@
+#include "FileWatcher.h"
+#include <algorithm>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <climits>
+#endif
+
+FileWatcher::FileWatcher()
+        : m_inotify_fd(-1) {
+#ifdef __linux__
+    m_inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+#endif
+}
+
+FileWatcher::~FileWatcher() {
+    if (m_inotify_fd >= 0) {
+        close(m_inotify_fd);
+    }
+}
+
+bool FileWatcher::stat(const std::string &filePath, int64_t &mtime, int64_t &size) {
+    struct ::stat st{};
+    if (::stat(filePath.c_str(), &st) != 0) {
+        mtime = size = -1;
+        return false;
+    }
+#ifdef __APPLE__
+    mtime = (int64_t) st.st_mtimespec.tv_sec * 1000000000 + st.st_mtimespec.tv_nsec;
+#else
+    mtime = (int64_t) st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+#endif
+    size = st.st_size;
+    return true;
+}
+
+unsigned int FileWatcher::add(const std::string &filePath) {
+    watchedFile file;
+    file.path = filePath;
+    size_t slash = filePath.find_last_of('/');
+    file.directory = slash == std::string::npos ? "." : filePath.substr(0, slash);
+    file.name = slash == std::string::npos ? filePath : filePath.substr(slash + 1);
+    file.watch = -1;
+    stat(filePath, file.mtime, file.size);
+    file.seenMtime = file.mtime;
+    file.seenSize = file.size;
+
+#ifdef __linux__
+    if (m_inotify_fd >= 0) {
+        // Adding a directory twice returns the same descriptor.
+        file.watch = inotify_add_watch(m_inotify_fd, file.directory.c_str(),
+                                       IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+    }
+#endif
+
+    m_files.push_back(file);
+    return m_files.size() - 1;
+}
+
+std::vector<unsigned int> FileWatcher::poll() {
+    std::vector<unsigned int> changed;
+
+#ifdef __linux__
+    if (m_inotify_fd >= 0) {
+        alignas(inotify_event) char buffer[64 * (sizeof(inotify_event) + NAME_MAX + 1)];
+        ssize_t bytes;
+        while ((bytes = read(m_inotify_fd, buffer, sizeof(buffer))) > 0) {
+            for (char *p = buffer; p < buffer + bytes;) {
+                const inotify_event *event = (const inotify_event *) p;
+                p += sizeof(inotify_event) + event->len;
+                if (event->len == 0) {
+                    continue;
+                }
+                for (unsigned int i = 0; i < m_files.size(); i++) {
+                    if (m_files[i].watch == event->wd && m_files[i].name == event->name) {
+                        changed.push_back(i);
+                    }
+                }
+            }
+        }
+    }
+#endif
+
+    for (unsigned int i = 0; i < m_files.size(); i++) {
+        watchedFile &file = m_files[i];
+        if (file.watch >= 0) {
+            continue;
+        }
+        int64_t mtime, size;
+        stat(file.path, mtime, size);
+        bool settled = mtime == file.seenMtime && size == file.seenSize;
+        file.seenMtime = mtime;
+        file.seenSize = size;
+        if (settled && (mtime != file.mtime || size != file.size) && mtime >= 0) {
+            file.mtime = mtime;
+            file.size = size;
+            changed.push_back(i);
+        }
+    }
+
+    std::sort(changed.begin(), changed.end());
+    changed.erase(std::unique(changed.begin(), changed.end()), changed.end());
+    return changed;
+}
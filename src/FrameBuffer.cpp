@@ -4,24 +4,28 @@
 
 #include "FrameBuffer.h"
 #include "GL/glew.h"
+#include "GLState.h"
 
 FrameBuffer::FrameBuffer() {
     glGenFramebuffers(1, &m_renderer_ID);
 }
 
 FrameBuffer::~FrameBuffer() {
-
+    glState().deleteFramebuffers(1, &m_renderer_ID);
 }
 
 void FrameBuffer::bind() const {
-    glBindFramebuffer(GL_FRAMEBUFFER, m_renderer_ID);
+    glState().bindFramebuffer(m_renderer_ID);
 }
 
 void FrameBuffer::unbind() const {
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glState().bindFramebuffer(0);
 }
 
 void FrameBuffer::addTexutre(unsigned int texture) {
     bind();
     glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, texture, 0);
+    // Depth only: no colour buffers to draw to or read from.
+    glDrawBuffer(GL_NONE);
+    glReadBuffer(GL_NONE);
 }
@@ -0,0 +1,148 @@
+#include "GLState.h"
+
+GLState &glState() {
+    static GLState state;
+    return state;
+}
+
+GLState::GLState()
+        : m_program(GL_STATE_UNKNOWN), m_vertex_array(GL_STATE_UNKNOWN), m_array_buffer(GL_STATE_UNKNOWN),
+          m_indirect_buffer(GL_STATE_UNKNOWN), m_framebuffer(GL_STATE_UNKNOWN), m_active_unit(GL_STATE_UNKNOWN),
+          m_viewport{-1, -1, -1, -1}, m_stats() {
+    for (unsigned int &texture: m_textures) {
+        texture = GL_STATE_UNKNOWN;
+    }
+}
+
+bool GLState::isBound(unsigned int &binding, unsigned int value) {
+    if (binding == value) {
+        m_stats.skippedBinds++;
+        return true;
+    }
+    binding = value;
+    m_stats.issuedBinds++;
+    return false;
+}
+
+void GLState::useProgram(unsigned int program) {
+    if (!isBound(m_program, program)) {
+        glUseProgram(program);
+    }
+}
+
+void GLState::bindVertexArray(unsigned int vertexArray) {
+    if (!isBound(m_vertex_array, vertexArray)) {
+        glBindVertexArray(vertexArray);
+    }
+}
+
+void GLState::bindBuffer(unsigned int target, unsigned int buffer) {
+    unsigned int *binding = nullptr;
+    if (target == GL_ARRAY_BUFFER) {
+        binding = &m_array_buffer;
+    } else if (target == GL_DRAW_INDIRECT_BUFFER) {
+        binding = &m_indirect_buffer;
+    } else if (target == GL_ELEMENT_ARRAY_BUFFER && m_vertex_array != GL_STATE_UNKNOWN) {
+        binding = &m_element_buffers.emplace(m_vertex_array, GL_STATE_UNKNOWN).first->second;
+    }
+    if (!binding) {
+        m_stats.issuedBinds++;
+        glBindBuffer(target, buffer);
+    } else if (!isBound(*binding, buffer)) {
+        glBindBuffer(target, buffer);
+    }
+}
+
+void GLState::bindTexture(unsigned int unit, unsigned int texture) {
+    if (unit >= GL_STATE_TEXTURE_UNITS) {
+        m_active_unit = GL_STATE_UNKNOWN;
+        m_stats.issuedBinds += 2;
+        glActiveTexture(GL_TEXTURE0 + unit);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        return;
+    }
+    if (!isBound(m_active_unit, unit)) {
+        glActiveTexture(GL_TEXTURE0 + unit);
+    }
+    if (!isBound(m_textures[unit], texture)) {
+        glBindTexture(GL_TEXTURE_2D, texture);
+    }
+}
+
+void GLState::bindFramebuffer(unsigned int framebuffer) {
+    if (!isBound(m_framebuffer, framebuffer)) {
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    }
+}
+
+void GLState::viewport(int x, int y, int width, int height) {
+    if (m_viewport[0] == x && m_viewport[1] == y && m_viewport[2] == width && m_viewport[3] == height) {
+        m_stats.skippedBinds++;
+        return;
+    }
+    m_viewport[0] = x;
+    m_viewport[1] = y;
+    m_viewport[2] = width;
+    m_viewport[3] = height;
+    m_stats.issuedBinds++;
+    glViewport(x, y, width, height);
+}
+
+void GLState::deleteProgram(unsigned int program) {
+    // A current program stays in use until another replaces it, so it is left bound.
+    glDeleteProgram(program);
+}
+
+void GLState::deleteVertexArrays(unsigned int count, const unsigned int *vertexArrays) {
+    for (unsigned int i = 0; i < count; i++) {
+        m_element_buffers.erase(vertexArrays[i]);
+        if (m_vertex_array == vertexArrays[i]) {
+            m_vertex_array = 0;
+        }
+    }
+    glDeleteVertexArrays(count, vertexArrays);
+}
+
+void GLState::deleteBuffers(unsigned int count, const unsigned int *buffers) {
+    for (unsigned int i = 0; i < count; i++) {
+        if (m_array_buffer == buffers[i]) {
+            m_array_buffer = 0;
+        }
+        if (m_indirect_buffer == buffers[i]) {
+            m_indirect_buffer = 0;
+        }
+        // Only the bound vertex array is detached from it; the others are no longer known.
+        for (auto &element: m_element_buffers) {
+            if (element.second == buffers[i]) {
+                element.second = element.first == m_vertex_array ? 0 : GL_STATE_UNKNOWN;
+            }
+        }
+    }
+    glDeleteBuffers(count, buffers);
+}
+
+void GLState::deleteTextures(unsigned int count, const unsigned int *textures) {
+    for (unsigned int i = 0; i < count; i++) {
+        for (unsigned int &texture: m_textures) {
+            if (texture == textures[i]) {
+                texture = 0;
+            }
+        }
+    }
+    glDeleteTextures(count, textures);
+}
+
+void GLState::deleteFramebuffers(unsigned int count, const unsigned int *framebuffers) {
+    for (unsigned int i = 0; i < count; i++) {
+        if (m_framebuffer == framebuffers[i]) {
+            m_framebuffer = 0;
+        }
+    }
+    glDeleteFramebuffers(count, framebuffers);
+}
+
+glStateStats GLState::takeStats() {
+    glStateStats stats = m_stats;
+    m_stats = glStateStats();
+    return stats;
+}
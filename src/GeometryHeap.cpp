@@ -0,0 +1,411 @@
+#include "GeometryHeap.h"
+#include <algorithm>
+#include <cstring>
+#include "GLState.h"
+
+RangeAllocator::RangeAllocator(size_t capacity)
+        : m_capacity(0), m_used(0) {
+    grow(capacity);
+}
+
+bool RangeAllocator::allocate(size_t size, size_t &offset) {
+    if (size == 0) {
+        offset = 0;
+        return true;
+    }
+    for (auto it = m_free.begin(); it != m_free.end(); ++it) {
+        if (it->second >= size) {
+            offset = it->first;
+            size_t rest = it->second - size;
+            m_free.erase(it);
+            if (rest > 0) {
+                m_free[offset + size] = rest;
+            }
+            m_used += size;
+            return true;
+        }
+    }
+    return false;
+}
+
+void RangeAllocator::free(size_t offset, size_t size) {
+    if (size == 0) {
+        return;
+    }
+    m_used -= size;
+
+    // Merge with the free blocks on either side.
+    auto next = m_free.lower_bound(offset);
+    if (next != m_free.end() && offset + size == next->first) {
+        size += next->second;
+        next = m_free.erase(next);
+    }
+    if (next != m_free.begin()) {
+        auto previous = std::prev(next);
+        if (previous->first + previous->second == offset) {
+            previous->second += size;
+            return;
+        }
+    }
+    m_free[offset] = size;
+}
+
+void RangeAllocator::grow(size_t newCapacity) {
+    if (newCapacity <= m_capacity) {
+        return;
+    }
+    size_t oldCapacity = m_capacity;
+    m_capacity = newCapacity;
+    m_used += newCapacity - oldCapacity; // free() takes it back off.
+    free(oldCapacity, newCapacity - oldCapacity);
+}
+
+void RangeAllocator::reset(size_t used) {
+    m_free.clear();
+    m_used = used;
+    if (used < m_capacity) {
+        m_free[used] = m_capacity - used;
+    }
+}
+
+size_t RangeAllocator::getLargestFree() const {
+    size_t largest = 0;
+    for (const auto &block: m_free) {
+        largest = std::max(largest, block.second);
+    }
+    return largest;
+}
+
+float RangeAllocator::getFragmentation() const {
+    size_t free = m_capacity - m_used;
+    return free == 0 ? 0.0f : 1.0f - float(getLargestFree()) / free;
+}
+
+static inline size_t indexSize(unsigned int type) {
+    return type == GL_UNSIGNED_SHORT ? sizeof(unsigned short) : sizeof(unsigned int);
+}
+
+// Index ranges are kept 4-byte aligned so 32-bit indices can follow 16-bit ones.
+static inline size_t indexBytes(unsigned int count, unsigned int type) {
+    return (count * indexSize(type) + 3) & ~size_t(3);
+}
+
+static void copyBuffer(const VertexBuffer &source, const VertexBuffer &target, size_t sourceOffset,
+                       size_t targetOffset, size_t size) {
+    if (size == 0) {
+        return;
+    }
+    glBindBuffer(GL_COPY_READ_BUFFER, source.getID());
+    glBindBuffer(GL_COPY_WRITE_BUFFER, target.getID());
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, sourceOffset, targetOffset, size);
+}
+
+GeometryHeap::GeometryHeap(const VertexBufferLayout &vertexLayout, const VertexBufferLayout &positionLayout,
+                           const VertexBufferLayout &instanceLayout, const VertexBufferLayout &depthInstanceLayout)
+        : m_vertex_layout(vertexLayout), m_position_layout(positionLayout),
+          m_instance_layouts{instanceLayout, depthInstanceLayout},
+          m_vertices(new VertexBuffer(HEAP_INITIAL_VERTICES * vertexLayout.getStride())),
+          m_positions(new VertexBuffer(HEAP_INITIAL_VERTICES * positionLayout.getStride())),
+          m_indices(new VertexBuffer(HEAP_INITIAL_INDEX_BYTES)),
+          m_instances{std::unique_ptr<VertexBuffer>(new VertexBuffer(0u)),
+                      std::unique_ptr<VertexBuffer>(new VertexBuffer(0u))},
+          m_commands(new VertexBuffer(0u)), m_VA(2),
+          m_vertex_allocator(HEAP_INITIAL_VERTICES), m_index_allocator(HEAP_INITIAL_INDEX_BYTES),
+          m_indirect(GLEW_VERSION_4_3 || (GLEW_ARB_multi_draw_indirect && GLEW_ARB_base_instance)),
+          m_draw_stats{0, 0, 0, 0}, m_defragment_num(0), m_grow_num(0) {
+    m_instance_layouts[0].setDivisor(1);
+    m_instance_layouts[1].setDivisor(1);
+    bindStreams();
+}
+
+void GeometryHeap::bindStreams() {
+    m_VA.addBuffer(0, *m_vertices, m_vertex_layout);
+    m_VA.addBuffer(0, *m_instances[0], m_instance_layouts[0], HEAP_INSTANCE_ATTRIBUTE);
+    glState().bindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_indices->getID());
+    m_VA.addBuffer(1, *m_positions, m_position_layout);
+    m_VA.addBuffer(1, *m_instances[1], m_instance_layouts[1], HEAP_INSTANCE_ATTRIBUTE);
+    glState().bindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_indices->getID());
+    m_VA.unbind();
+}
+
+unsigned int GeometryHeap::allocate(unsigned int vertexCount, unsigned int indexCount, unsigned int indexType) {
+    unsigned int handle;
+    if (!m_free_handles.empty()) {
+        handle = m_free_handles.back();
+        m_free_handles.pop_back();
+    } else {
+        handle = m_allocations.size();
+        m_allocations.push_back({});
+    }
+
+    heapAllocation &allocation = m_allocations[handle];
+    allocation = {0, vertexCount, 0, indexCount, indexType, true};
+    size_t bytes = indexBytes(indexCount, indexType), vertexOffset = 0;
+
+    // Out of contiguous room: compact if that frees enough, grow otherwise.
+    bool fits = m_vertex_allocator.allocate(vertexCount, vertexOffset);
+    if (fits && !m_index_allocator.allocate(bytes, allocation.indexOffset)) {
+        m_vertex_allocator.free(vertexOffset, vertexCount);
+        fits = false;
+    }
+    if (!fits) {
+        allocation.live = false;
+        size_t vertexCapacity = m_vertex_allocator.getCapacity(), indexCapacity = m_index_allocator.getCapacity();
+        while (vertexCapacity - m_vertex_allocator.getUsed() < vertexCount) {
+            vertexCapacity *= 2;
+        }
+        while (indexCapacity - m_index_allocator.getUsed() < bytes) {
+            indexCapacity *= 2;
+        }
+        if (vertexCapacity > m_vertex_allocator.getCapacity() || indexCapacity > m_index_allocator.getCapacity()) {
+            m_grow_num++;
+        } else {
+            m_defragment_num++;
+        }
+        relocate(vertexCapacity, indexCapacity);
+        m_vertex_allocator.allocate(vertexCount, vertexOffset);
+        m_index_allocator.allocate(bytes, allocation.indexOffset);
+        allocation.live = true;
+    }
+    allocation.vertexOffset = vertexOffset;
+
+    return handle;
+}
+
+void GeometryHeap::upload(unsigned int handle, const void *vertices, const void *positions, const void *indices) {
+    const heapAllocation &allocation = m_allocations[handle];
+    m_vertices->update(allocation.vertexOffset * m_vertex_layout.getStride(), vertices,
+                       allocation.vertexCount * m_vertex_layout.getStride());
+    m_positions->update(allocation.vertexOffset * m_position_layout.getStride(), positions,
+                        allocation.vertexCount * m_position_layout.getStride());
+    m_indices->update(allocation.indexOffset, indices, allocation.indexCount * indexSize(allocation.indexType));
+}
+
+void GeometryHeap::free(unsigned int handle) {
+    heapAllocation &allocation = m_allocations[handle];
+    if (!allocation.live) {
+        return;
+    }
+    m_vertex_allocator.free(allocation.vertexOffset, allocation.vertexCount);
+    m_index_allocator.free(allocation.indexOffset, indexBytes(allocation.indexCount, allocation.indexType));
+    allocation.live = false;
+    m_free_handles.push_back(handle);
+}
+
+void GeometryHeap::defragment() {
+    m_defragment_num++;
+    relocate(m_vertex_allocator.getCapacity(), m_index_allocator.getCapacity());
+}
+
+void GeometryHeap::relocate(size_t vertexCapacity, size_t indexCapacity) {
+    unsigned int vertexStride = m_vertex_layout.getStride(), positionStride = m_position_layout.getStride();
+    std::unique_ptr<VertexBuffer> vertices(new VertexBuffer(vertexCapacity * vertexStride));
+    std::unique_ptr<VertexBuffer> positions(new VertexBuffer(vertexCapacity * positionStride));
+    std::unique_ptr<VertexBuffer> indices(new VertexBuffer(indexCapacity));
+
+    // Live meshes keep their relative order, so repeated compaction moves little.
+    std::vector<unsigned int> live;
+    for (unsigned int handle = 0; handle < m_allocations.size(); handle++) {
+        if (m_allocations[handle].live) {
+            live.push_back(handle);
+        }
+    }
+
+    std::sort(live.begin(), live.end(), [this](unsigned int a, unsigned int b) {
+        return m_allocations[a].vertexOffset < m_allocations[b].vertexOffset;
+    });
+    size_t vertexEnd = 0;
+    for (unsigned int handle: live) {
+        heapAllocation &allocation = m_allocations[handle];
+        copyBuffer(*m_vertices, *vertices, allocation.vertexOffset * vertexStride, vertexEnd * vertexStride,
+                   allocation.vertexCount * vertexStride);
+        copyBuffer(*m_positions, *positions, allocation.vertexOffset * positionStride,
+                   vertexEnd * positionStride, allocation.vertexCount * positionStride);
+        allocation.vertexOffset = vertexEnd;
+        vertexEnd += allocation.vertexCount;
+    }
+
+    std::sort(live.begin(), live.end(), [this](unsigned int a, unsigned int b) {
+        return m_allocations[a].indexOffset < m_allocations[b].indexOffset;
+    });
+    size_t indexEnd = 0;
+    for (unsigned int handle: live) {
+        heapAllocation &allocation = m_allocations[handle];
+        size_t bytes = indexBytes(allocation.indexCount, allocation.indexType);
+        copyBuffer(*m_indices, *indices, allocation.indexOffset, indexEnd, bytes);
+        allocation.indexOffset = indexEnd;
+        indexEnd += bytes;
+    }
+
+    m_vertex_allocator.grow(vertexCapacity);
+    m_vertex_allocator.reset(vertexEnd);
+    m_index_allocator.grow(indexCapacity);
+    m_index_allocator.reset(indexEnd);
+
+    m_vertices.swap(vertices);
+    m_positions.swap(positions);
+    m_indices.swap(indices);
+    bindStreams();
+}
+
+heapStats GeometryHeap::getStats() const {
+    heapStats stats;
+    stats.vertexCapacity = m_vertex_allocator.getCapacity();
+    stats.vertexUsed = m_vertex_allocator.getUsed();
+    stats.indexCapacity = m_index_allocator.getCapacity();
+    stats.indexUsed = m_index_allocator.getUsed();
+    stats.vertexFragmentation = m_vertex_allocator.getFragmentation();
+    stats.indexFragmentation = m_index_allocator.getFragmentation();
+    stats.meshNum = m_allocations.size() - m_free_handles.size();
+    stats.defragmentNum = m_defragment_num;
+    stats.growNum = m_grow_num;
+    return stats;
+}
+
+void GeometryHeap::addDraw(unsigned int handle, unsigned int firstIndex, unsigned int indexCount,
+                           const void *instance, bool depthOnly, bool ordered) {
+    const heapAllocation &allocation = m_allocations[handle];
+    instanceQueue &queue = m_queues[depthOnly ? 1 : 0];
+    unsigned int type = allocation.indexType == GL_UNSIGNED_SHORT ? 0 : 1;
+    GLuint first = allocation.indexOffset / indexSize(allocation.indexType) + firstIndex;
+
+    // A mesh has a handful of ranges in use, one per level of detail.
+    unsigned int command = INVALID_HEAP_HANDLE;
+    if (ordered) {
+        unsigned int last = queue.order.empty() ? INVALID_HEAP_HANDLE : queue.order.back();
+        if (last != INVALID_HEAP_HANDLE && last >> 31 == type &&
+            queue.commands[type][last & ~(1u << 31)].firstIndex == first) {
+            command = last;
+        }
+    } else {
+        if (handle >= queue.ranges.size()) {
+            queue.ranges.resize(m_allocations.size());
+        }
+        for (const auto &range: queue.ranges[handle]) {
+            if (range.first == firstIndex) {
+                command = range.second;
+                break;
+            }
+        }
+    }
+    if (command == INVALID_HEAP_HANDLE) {
+        command = (type << 31) | queue.commands[type].size();
+        if (ordered) {
+            queue.order.push_back(command);
+        } else {
+            queue.ranges[handle].emplace_back(firstIndex, command);
+        }
+        queue.commands[type].push_back({indexCount, 0, first, (GLint) allocation.vertexOffset, 0});
+    }
+    queue.commands[type][command & ~(1u << 31)].instanceCount++;
+    queue.instanceCommands.push_back(command);
+
+    size_t stride = m_instance_layouts[depthOnly ? 1 : 0].getStride();
+    queue.instances.insert(queue.instances.end(), (const unsigned char *) instance,
+                           (const unsigned char *) instance + stride);
+}
+
+void GeometryHeap::flush(const Renderer &renderer, const Shader &shader, bool depthOnly) {
+    unsigned int stream = depthOnly ? 1 : 0;
+    instanceQueue &queue = m_queues[stream];
+    if (queue.instanceCommands.empty()) {
+        return;
+    }
+    const VertexBufferLayout &layout = m_instance_layouts[stream];
+    size_t stride = layout.getStride();
+
+    // Each command's instances become one run, 16-bit commands first; instanceCount counts them back up.
+    unsigned int instanceNum = 0;
+    for (auto &commands: queue.commands) {
+        for (auto &command: commands) {
+            command.baseInstance = instanceNum;
+            instanceNum += command.instanceCount;
+            command.instanceCount = 0;
+        }
+    }
+    queue.sorted.resize(instanceNum * stride);
+    for (size_t i = 0; i < queue.instanceCommands.size(); i++) {
+        unsigned int c = queue.instanceCommands[i];
+        drawElementsIndirectCommand &command = queue.commands[c >> 31][c & ~(1u << 31)];
+        std::memcpy(queue.sorted.data() + (command.baseInstance + command.instanceCount++) * stride,
+                    queue.instances.data() + i * stride, stride);
+    }
+    m_instances[stream]->replace(queue.sorted.data(), queue.sorted.size());
+
+    unsigned int callNum = 0;
+    if (!queue.order.empty()) {
+        // One call per run of commands of an index type, so the commands keep their order.
+        m_submitted.clear();
+        for (unsigned int c: queue.order) {
+            m_submitted.push_back(queue.commands[c >> 31][c & ~(1u << 31)]);
+        }
+        if (m_indirect) {
+            m_commands->replace(m_submitted.data(), m_submitted.size() * sizeof(drawElementsIndirectCommand));
+            glState().bindBuffer(GL_DRAW_INDIRECT_BUFFER, m_commands->getID());
+        }
+        for (size_t start = 0, end; start < queue.order.size(); start = end) {
+            unsigned int type = queue.order[start] >> 31;
+            GLenum indexType = type == 0 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+            end = start + 1;
+            while (end < queue.order.size() && queue.order[end] >> 31 == type) {
+                end++;
+            }
+            if (m_indirect) {
+                renderer.multiDrawIndirect(m_VA, stream, shader, indexType,
+                                           start * sizeof(drawElementsIndirectCommand), end - start);
+                callNum++;
+                continue;
+            }
+            for (size_t i = start; i < end; i++) {
+                m_VA.addBuffer(stream, *m_instances[stream], layout, HEAP_INSTANCE_ATTRIBUTE,
+                               m_submitted[i].baseInstance * stride);
+                renderer.drawInstanced(m_VA, stream, shader, indexType, m_submitted[i]);
+            }
+            callNum += end - start;
+        }
+        if (m_indirect) {
+            glState().bindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+        }
+    } else if (m_indirect) {
+        m_submitted.assign(queue.commands[0].begin(), queue.commands[0].end());
+        m_submitted.insert(m_submitted.end(), queue.commands[1].begin(), queue.commands[1].end());
+        m_commands->replace(m_submitted.data(), m_submitted.size() * sizeof(drawElementsIndirectCommand));
+        glState().bindBuffer(GL_DRAW_INDIRECT_BUFFER, m_commands->getID());
+        renderer.multiDrawIndirect(m_VA, stream, shader, GL_UNSIGNED_SHORT, 0, queue.commands[0].size());
+        renderer.multiDrawIndirect(m_VA, stream, shader, GL_UNSIGNED_INT,
+                                   queue.commands[0].size() * sizeof(drawElementsIndirectCommand),
+                                   queue.commands[1].size());
+        glState().bindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+        callNum = !queue.commands[0].empty() + !queue.commands[1].empty();
+    } else {
+        for (unsigned int type = 0; type < 2; type++) {
+            for (const auto &command: queue.commands[type]) {
+                m_VA.addBuffer(stream, *m_instances[stream], layout, HEAP_INSTANCE_ATTRIBUTE,
+                               command.baseInstance * stride);
+                renderer.drawInstanced(m_VA, stream, shader, type == 0 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT,
+                                       command);
+            }
+        }
+        callNum = queue.commands[0].size() + queue.commands[1].size();
+    }
+
+    m_draw_stats.flushNum++;
+    m_draw_stats.drawCallNum += callNum;
+    m_draw_stats.commandNum += queue.commands[0].size() + queue.commands[1].size();
+    m_draw_stats.instanceNum += instanceNum;
+
+    queue.commands[0].clear();
+    queue.commands[1].clear();
+    for (auto &ranges: queue.ranges) {
+        ranges.clear();
+    }
+    queue.instanceCommands.clear();
+    queue.instances.clear();
+    queue.order.clear();
+}
+
+heapDrawStats GeometryHeap::takeDrawStats() {
+    heapDrawStats stats = m_draw_stats;
+    m_draw_stats = {0, 0, 0, 0};
+    return stats;
+}
@@ -4,22 +4,30 @@
 
 #include "IndexBuffer.h"
 #include "Renderer.h"
+#include "GLState.h"
 
 IndexBuffer::IndexBuffer(const unsigned int *data, unsigned int count)
-        : m_count(count) {
+        : m_count(count), m_type(GL_UNSIGNED_INT) {
     glGenBuffers(1, &m_renderer_ID);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_renderer_ID);
+    glState().bindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_renderer_ID);
     glBufferData(GL_ELEMENT_ARRAY_BUFFER, count * sizeof(unsigned int), data, GL_STATIC_DRAW);
 }
 
+IndexBuffer::IndexBuffer(const unsigned short *data, unsigned int count)
+        : m_count(count), m_type(GL_UNSIGNED_SHORT) {
+    glGenBuffers(1, &m_renderer_ID);
+    glState().bindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_renderer_ID);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, count * sizeof(unsigned short), data, GL_STATIC_DRAW);
+}
+
 IndexBuffer::~IndexBuffer() {
-    glDeleteBuffers(1, &m_renderer_ID);
+    glState().deleteBuffers(1, &m_renderer_ID);
 }
 
 void IndexBuffer::bind() const {
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_renderer_ID);
+    glState().bindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_renderer_ID);
 }
 
 void IndexBuffer::unbind() const {
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    glState().bindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 }
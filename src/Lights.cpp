@@ -3,8 +3,8 @@
 //
 
 #include "Lights.h"
-#include <fstream>
 #include <iostream>
+#include "TextTokenizer.h"
 
 bool Lights::loadLights(const std::string &filePath) {
     m_lights_pos = parseLights(filePath);
@@ -15,33 +15,33 @@ bool Lights::loadLights(const std::string &filePath) {
     }
 }
 
-std::vector<glm::vec3> Lights::parseLights(const std::string &filePath) {
-    std::ifstream stream(filePath);
+void Lights::setLights(const glm::vec3 *positions, unsigned int count) {
+    m_lights_pos.assign(positions, positions + count);
+    m_count = count;
+}
 
-    std::string line;
+std::vector<glm::vec3> Lights::parseLights(const std::string &filePath) {
+    TextTokenizer tokens;
     std::vector<glm::vec3> lights;
+    if (!tokens.open(filePath)) {
+        std::cout << tokens.getError() << std::endl;
+        return lights;
+    }
+    lights.reserve(tokens.countLines("x/y/z:"));
 
-    while (getline(stream, line)) {
-        if (line.find('#') == std::string::npos && line != "") { // Skip if encounter comment lines or blank lines.
-            if (line.find("x/y/z: ") != std::string::npos) {
-                std::vector<float> coordinate;
-                std::string::iterator it = line.begin() + 7;
-                while (it != line.end()) {
-                    std::string pos;
-                    while (it != line.end() && (*it) != '/') {
-                        pos += *(it++);
-                    }
-                    coordinate.push_back(stof(pos));
-                    if (it != line.end() && (*it) == '/') {
-                        it++;
-                    }
-                }
-                lights.push_back({coordinate[0], coordinate[1], coordinate[2]});
-            } else {
-                std::cout << "Failed to parse light coordinates from " << filePath << std::endl;
-                return std::vector<glm::vec3>{};
-            }
+    std::string_view key;
+    while (tokens.nextLine()) {
+        glm::vec3 light;
+        tokens.word(key);
+        bool valid = key == "x/y/z:" ? tokens.number(light.x) : tokens.fail("expected 'x/y/z:'");
+        valid = valid && (tokens.character('/') || tokens.fail("expected '/'")) && tokens.number(light.y) &&
+                (tokens.character('/') || tokens.fail("expected '/'")) && tokens.number(light.z) &&
+                (tokens.atLineEnd() || tokens.fail("unexpected text at the end of the line"));
+        if (!valid) {
+            std::cout << "Failed to parse light coordinates: " << tokens.getError() << std::endl;
+            return std::vector<glm::vec3>{};
         }
+        lights.push_back(light);
     }
 
     m_count = lights.size();
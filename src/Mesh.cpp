@@ -0,0 +1,90 @@
+#include "Mesh.h"
+#include <cstring>
+#include <algorithm>
+
+std::vector<unsigned short> meshData::getShortIndices() const {
+    return std::vector<unsigned short>(indices.begin(), indices.end());
+}
+
+// Bit pattern of a float with -0.0 folded into +0.0, so both weld together.
+static inline uint32_t floatBits(float f) {
+    uint32_t bits;
+    std::memcpy(&bits, &f, sizeof(bits));
+    return bits == 0x80000000u ? 0u : bits;
+}
+
+static inline uint32_t hashVertex(const glm::vec3 &p, const glm::vec3 &n) {
+    const uint32_t words[6] = {floatBits(p.x), floatBits(p.y), floatBits(p.z),
+                               floatBits(n.x), floatBits(n.y), floatBits(n.z)};
+    uint32_t h = 2166136261u;
+    for (uint32_t w: words) {
+        h ^= w;
+        h *= 16777619u;
+        h ^= h >> 15;
+    }
+    return h;
+}
+
+static inline bool sameVertex(const glm::vec3 &p0, const glm::vec3 &n0, const glm::vec3 &p1, const glm::vec3 &n1) {
+    return floatBits(p0.x) == floatBits(p1.x) && floatBits(p0.y) == floatBits(p1.y) &&
+           floatBits(p0.z) == floatBits(p1.z) && floatBits(n0.x) == floatBits(n1.x) &&
+           floatBits(n0.y) == floatBits(n1.y) && floatBits(n0.z) == floatBits(n1.z);
+}
+
+VertexWelder::VertexWelder(meshData &mesh, size_t expectedVertices)
+        : m_mesh(mesh) {
+    size_t capacity = 16;
+    while (capacity < expectedVertices * 2) {
+        capacity <<= 1;
+    }
+    m_table.assign(capacity, 0);
+    m_mask = capacity - 1;
+
+    // Vertices already in the mesh take part in welding too.
+    for (unsigned int i = 0; i < m_mesh.positions.size(); i++) {
+        unsigned int slot = hashVertex(m_mesh.positions[i], m_mesh.normals[i]) & m_mask;
+        while (m_table[slot] != 0) {
+            slot = (slot + 1) & m_mask;
+        }
+        m_table[slot] = i + 1;
+    }
+}
+
+unsigned int VertexWelder::insert(const glm::vec3 &position, const glm::vec3 &normal) {
+    unsigned int slot = hashVertex(position, normal) & m_mask;
+    while (m_table[slot] != 0) {
+        unsigned int index = m_table[slot] - 1;
+        if (sameVertex(m_mesh.positions[index], m_mesh.normals[index], position, normal)) {
+            return index;
+        }
+        slot = (slot + 1) & m_mask;
+    }
+
+    unsigned int index = m_mesh.positions.size();
+    m_mesh.positions.push_back(position);
+    m_mesh.normals.push_back(normal);
+    m_table[slot] = index + 1;
+
+    // Keep the load factor under one half.
+    if (m_mesh.positions.size() * 2 > m_table.size()) {
+        grow();
+    }
+
+    return index;
+}
+
+void VertexWelder::clear() {
+    std::fill(m_table.begin(), m_table.end(), 0);
+}
+
+void VertexWelder::grow() {
+    m_table.assign(m_table.size() * 2, 0);
+    m_mask = m_table.size() - 1;
+    for (unsigned int i = 0; i < m_mesh.positions.size(); i++) {
+        unsigned int slot = hashVertex(m_mesh.positions[i], m_mesh.normals[i]) & m_mask;
+        while (m_table[slot] != 0) {
+            slot = (slot + 1) & m_mask;
+        }
+        m_table[slot] = i + 1;
+    }
+}
@@ -0,0 +1,495 @@
+#include "MeshCache.h"
+#include "MeshQuantizer.h"
+#include <fstream>
+#include <iostream>
+#include <vector>
+#include <cstring>
+#include <cstdio>
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+static inline uint64_t alignUp(uint64_t value) {
+    return (value + 15) & ~uint64_t(15);
+}
+
+// Whether count bytes (or elements) from offset stay within size, without overflowing.
+static inline bool fitsIn(uint64_t offset, uint64_t count, uint64_t size) {
+    return offset <= size && count <= size - offset;
+}
+
+MeshCache::MeshCache()
+        : m_data(nullptr), m_size(0), m_header(nullptr) {}
+
+MeshCache::~MeshCache() {
+    close();
+}
+
+void MeshCache::close() {
+    if (m_data) {
+        munmap(m_data, m_size);
+    }
+    m_data = nullptr;
+    m_size = 0;
+    m_header = nullptr;
+}
+
+uint64_t MeshCache::hashFile(const std::string &filePath) {
+    uint64_t hash = 14695981039346656037ull;
+    int fd = ::open(filePath.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return 0;
+    }
+
+    struct stat st{};
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        void *data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data != MAP_FAILED) {
+            const unsigned char *bytes = (const unsigned char *) data;
+            for (off_t i = 0; i < st.st_size; i++) {
+                hash ^= bytes[i];
+                hash *= 1099511628211ull;
+            }
+            munmap(data, st.st_size);
+        }
+    }
+    ::close(fd);
+
+    return hash;
+}
+
+bool MeshCache::open(const std::string &cachePath, const std::string &sourcePath, const glm::vec3 &offset) {
+    if (!map(cachePath, sourcePath)) {
+        return false;
+    }
+    if (m_header->offset[0] != offset.x || m_header->offset[1] != offset.y || m_header->offset[2] != offset.z) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+bool MeshCache::map(const std::string &cachePath, const std::string &sourcePath) {
+    close();
+
+    struct stat source{};
+    if (stat(sourcePath.c_str(), &source) != 0) {
+        return false;
+    }
+
+    int fd = ::open(cachePath.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat st{};
+    if (fstat(fd, &st) != 0 || (size_t) st.st_size < sizeof(meshCacheHeader)) {
+        ::close(fd);
+        return false;
+    }
+    void *data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (data == MAP_FAILED) {
+        return false;
+    }
+    m_data = data;
+    m_size = st.st_size;
+
+    const meshCacheHeader *header = (const meshCacheHeader *) m_data;
+    bool valid = header->magic == MESH_CACHE_MAGIC && header->version == MESH_CACHE_VERSION &&
+                 header->fileSize == m_size && (header->indexSize == 2 || header->indexSize == 4) &&
+                 header->sourceSize == (uint64_t) source.st_size && header->lodCount >= 1 &&
+                 header->lodCount <= MAX_LOD_LEVELS;
+
+    // Every blob and level of detail must lie inside the file, so a corrupt header is never read past the mapping.
+    if (valid) {
+        uint64_t vertexBytes = (uint64_t) header->vertexCount * sizeof(glm::vec3);
+        valid = fitsIn(header->positionsOffset, vertexBytes, m_size) &&
+                fitsIn(header->verticesOffset, (uint64_t) header->vertexCount * QUANTIZED_VERTEX_SIZE * sizeof(short),
+                       m_size) &&
+                fitsIn(header->quantizedPositionsOffset,
+                       (uint64_t) header->vertexCount * QUANTIZED_POSITION_SIZE * sizeof(short), m_size) &&
+                fitsIn(header->indicesOffset, (uint64_t) header->indexCount * header->indexSize, m_size) &&
+                header->positionsOffset % 16 == 0 && header->verticesOffset % 16 == 0 &&
+                header->quantizedPositionsOffset % 16 == 0 && header->indicesOffset % 16 == 0;
+        for (uint32_t level = 0; valid && level < header->lodCount; level++) {
+            valid = fitsIn(header->lods[level].indexOffset, header->lods[level].indexCount, header->indexCount);
+        }
+    }
+
+    // The hash is only needed when the source was touched since the cache was built.
+    if (valid && header->sourceMtime != (int64_t) source.st_mtime) {
+        valid = header->sourceHash == hashFile(sourcePath);
+    }
+
+    if (!valid) {
+        close();
+        return false;
+    }
+
+    m_header = header;
+    return true;
+}
+
+bool MeshCache::rebase(const std::string &cachePath, const std::string &sourcePath, const glm::vec3 &offset) {
+    MeshCache cache;
+    if (!cache.map(cachePath, sourcePath)) {
+        return false;
+    }
+
+    meshCacheHeader header = *cache.m_header;
+    glm::vec3 delta = offset - glm::vec3(header.offset[0], header.offset[1], header.offset[2]);
+    for (int i = 0; i < 3; i++) {
+        header.offset[i] = offset[i];
+        header.boundsMin[i] += delta[i];
+        header.boundsMax[i] += delta[i];
+        header.dequantizeOffset[i] += delta[i]; // The quantized streams stay valid within the moved box.
+    }
+
+    std::string tempPath = cachePath + ".tmp";
+    std::ofstream outFile(tempPath, std::ios::binary | std::ios::trunc);
+    if (!outFile.is_open()) {
+        std::cerr << "Could not write the mesh cache " << cachePath << std::endl;
+        return false;
+    }
+    const char *data = (const char *) cache.m_data;
+    outFile.write((const char *) &header, sizeof(header));
+    outFile.write(data + sizeof(header), header.positionsOffset - sizeof(header));
+
+    // Positions are moved a chunk at a time; everything after them, the quantized streams included, is copied as is.
+    std::vector<glm::vec3> chunk;
+    const glm::vec3 *positions = cache.getPositions();
+    for (uint32_t begin = 0; begin < header.vertexCount; begin += 65536) {
+        uint32_t end = std::min<uint32_t>(header.vertexCount, begin + 65536);
+        chunk.assign(positions + begin, positions + end);
+        for (auto &position: chunk) {
+            position += delta;
+        }
+        outFile.write((const char *) chunk.data(), chunk.size() * sizeof(glm::vec3));
+    }
+    uint64_t positionsEnd = header.positionsOffset + (uint64_t) header.vertexCount * sizeof(glm::vec3);
+    outFile.write(data + positionsEnd, header.fileSize - positionsEnd);
+    outFile.close();
+
+    cache.close();
+    if (!outFile || rename(tempPath.c_str(), cachePath.c_str()) != 0) {
+        remove(tempPath.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+// Fills in everything but the bounds and the blob layout.
+static bool initHeader(meshCacheHeader &header, const std::string &sourcePath, const glm::vec3 &offset,
+                       uint32_t vertexCount, uint32_t indexCount, uint32_t cornerCount) {
+    struct stat source{};
+    if (stat(sourcePath.c_str(), &source) != 0) {
+        return false;
+    }
+
+    header = meshCacheHeader{};
+    header.magic = MESH_CACHE_MAGIC;
+    header.version = MESH_CACHE_VERSION;
+    header.sourceHash = MeshCache::hashFile(sourcePath);
+    header.sourceMtime = source.st_mtime;
+    header.sourceSize = source.st_size;
+    header.offset[0] = offset.x;
+    header.offset[1] = offset.y;
+    header.offset[2] = offset.z;
+    header.vertexCount = vertexCount;
+    header.indexCount = indexCount;
+    header.cornerCount = cornerCount;
+    header.indexSize = vertexCount <= 0xFFFF ? 2 : 4;
+
+    // The float positions stay first, so rebase() only has to move them.
+    uint64_t vertexBytes = (uint64_t) vertexCount * sizeof(glm::vec3);
+    header.positionsOffset = alignUp(sizeof(meshCacheHeader));
+    header.verticesOffset = alignUp(header.positionsOffset + vertexBytes);
+    header.quantizedPositionsOffset = alignUp(header.verticesOffset +
+                                              (uint64_t) vertexCount * QUANTIZED_VERTEX_SIZE * sizeof(short));
+    header.indicesOffset = alignUp(header.quantizedPositionsOffset +
+                                   (uint64_t) vertexCount * QUANTIZED_POSITION_SIZE * sizeof(short));
+    header.fileSize = header.indicesOffset + (uint64_t) indexCount * header.indexSize;
+
+    // A single full-detail level unless the caller provides more.
+    header.lodCount = 1;
+    header.lods[0] = {0, indexCount, 0.0f};
+
+    return true;
+}
+
+// Sets the bounds and the box the positions are quantized within.
+static void setBounds(meshCacheHeader &header, const glm::vec3 &boundsMin, const glm::vec3 &boundsMax) {
+    glm::vec3 scale, offset;
+    quantizationBox(boundsMin, boundsMax, scale, offset);
+    for (int i = 0; i < 3; i++) {
+        header.boundsMin[i] = boundsMin[i];
+        header.boundsMax[i] = boundsMax[i];
+        header.dequantizeScale[i] = scale[i];
+        header.dequantizeOffset[i] = offset[i];
+    }
+}
+
+static glm::vec3 getDequantizeScale(const meshCacheHeader &header) {
+    return glm::vec3(header.dequantizeScale[0], header.dequantizeScale[1], header.dequantizeScale[2]);
+}
+
+static glm::vec3 getDequantizeOffset(const meshCacheHeader &header) {
+    return glm::vec3(header.dequantizeOffset[0], header.dequantizeOffset[1], header.dequantizeOffset[2]);
+}
+
+// Fills in the header of an in-memory mesh, its bounds and levels of detail included.
+static bool initMeshHeader(meshCacheHeader &header, const std::string &sourcePath, const glm::vec3 &offset,
+                           const meshData &mesh) {
+    if (!initHeader(header, sourcePath, offset, mesh.positions.size(), mesh.indices.size(), mesh.cornerCount)) {
+        return false;
+    }
+
+    glm::vec3 boundsMin(0.0f), boundsMax(0.0f);
+    if (!mesh.positions.empty()) {
+        boundsMin = boundsMax = mesh.positions[0];
+        for (const auto &p: mesh.positions) {
+            boundsMin = glm::min(boundsMin, p);
+            boundsMax = glm::max(boundsMax, p);
+        }
+    }
+    setBounds(header, boundsMin, boundsMax);
+    if (!mesh.lods.empty()) {
+        header.lodCount = std::min<size_t>(mesh.lods.size(), MAX_LOD_LEVELS);
+        std::copy(mesh.lods.begin(), mesh.lods.begin() + header.lodCount, header.lods);
+    }
+    return true;
+}
+
+// Lays the header and the mesh out in image, which holds header.fileSize zeroed bytes, quantizing its vertices and
+// recording the error in the header.
+static void copyMesh(char *image, meshCacheHeader &header, const meshData &mesh) {
+    uint64_t vertexBytes = header.vertexCount * sizeof(glm::vec3);
+
+    quantizationError error{0.0f, 0.0f};
+    quantizeVertices(mesh.positions.data(), mesh.normals.data(), header.vertexCount, getDequantizeScale(header),
+                     getDequantizeOffset(header), (short *) (image + header.verticesOffset),
+                     (short *) (image + header.quantizedPositionsOffset), error);
+    header.positionError = error.position;
+    header.normalError = error.normal;
+
+    std::memcpy(image, &header, sizeof(header));
+    std::memcpy(image + header.positionsOffset, mesh.positions.data(), vertexBytes);
+    if (header.indexSize == 2) {
+        std::vector<unsigned short> indices = mesh.getShortIndices();
+        std::memcpy(image + header.indicesOffset, indices.data(), indices.size() * sizeof(unsigned short));
+    } else {
+        std::memcpy(image + header.indicesOffset, mesh.indices.data(), mesh.indices.size() * sizeof(unsigned int));
+    }
+}
+
+bool MeshCache::write(const std::string &cachePath, const std::string &sourcePath, const glm::vec3 &offset,
+                      const meshData &mesh) {
+    meshCacheHeader header;
+    if (!initMeshHeader(header, sourcePath, offset, mesh)) {
+        return false;
+    }
+
+    std::vector<char> buffer(header.fileSize, 0);
+    copyMesh(buffer.data(), header, mesh);
+
+    // Write to a temporary file first so an interrupted run never leaves a truncated cache behind.
+    std::string tempPath = cachePath + ".tmp";
+    std::ofstream outFile(tempPath, std::ios::binary | std::ios::trunc);
+    if (!outFile.is_open()) {
+        std::cerr << "Could not write the mesh cache " << cachePath << std::endl;
+        return false;
+    }
+    outFile.write(buffer.data(), buffer.size());
+    outFile.close();
+    if (!outFile || rename(tempPath.c_str(), cachePath.c_str()) != 0) {
+        remove(tempPath.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+bool MeshCache::hold(const std::string &sourcePath, const glm::vec3 &offset, const meshData &mesh) {
+    close();
+
+    meshCacheHeader header;
+    if (!initMeshHeader(header, sourcePath, offset, mesh)) {
+        return false;
+    }
+    // Anonymous memory, so close() releases it like a mapped file.
+    void *data = mmap(nullptr, header.fileSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (data == MAP_FAILED) {
+        return false;
+    }
+    copyMesh((char *) data, header, mesh);
+
+    m_data = data;
+    m_size = header.fileSize;
+    m_header = (const meshCacheHeader *) m_data;
+    return true;
+}
+
+MeshCacheWriter::MeshCacheWriter(const std::string &cachePath, const std::string &sourcePath, const glm::vec3 &offset)
+        : m_cache_path(cachePath), m_source_path(sourcePath), m_offset(offset), m_vertex_count(0), m_index_count(0),
+          m_corner_count(0), m_bounds_min(0.0f), m_bounds_max(0.0f) {
+    m_positions = tmpfile();
+    m_normals = tmpfile();
+    m_indices = tmpfile();
+}
+
+MeshCacheWriter::~MeshCacheWriter() {
+    for (FILE *file: {m_positions, m_normals, m_indices}) {
+        if (file) {
+            fclose(file);
+        }
+    }
+}
+
+bool MeshCacheWriter::append(const meshData &batch) {
+    if (!m_positions || !m_normals || !m_indices) {
+        return false;
+    }
+    if ((uint64_t) m_vertex_count + batch.positions.size() > 0xFFFFFFFFull) {
+        std::cerr << "Mesh " << m_source_path << " has too many vertices for the cache" << std::endl;
+        return false;
+    }
+
+    if (m_vertex_count == 0 && !batch.positions.empty()) {
+        m_bounds_min = m_bounds_max = batch.positions[0];
+    }
+    for (const auto &p: batch.positions) {
+        m_bounds_min = glm::min(m_bounds_min, p);
+        m_bounds_max = glm::max(m_bounds_max, p);
+    }
+
+    // Batch indices are local, rebase them onto the vertices written so far.
+    std::vector<uint32_t> indices(batch.indices.begin(), batch.indices.end());
+    for (auto &index: indices) {
+        index += m_vertex_count;
+    }
+
+    bool ok = fwrite(batch.positions.data(), sizeof(glm::vec3), batch.positions.size(), m_positions) ==
+              batch.positions.size() &&
+              fwrite(batch.normals.data(), sizeof(glm::vec3), batch.normals.size(), m_normals) ==
+              batch.normals.size() &&
+              fwrite(indices.data(), sizeof(uint32_t), indices.size(), m_indices) == indices.size();
+
+    m_vertex_count += batch.positions.size();
+    m_index_count += batch.indices.size();
+    m_corner_count += batch.cornerCount;
+
+    return ok;
+}
+
+// Copies the whole stream into out, bufferSize bytes at a time.
+static bool copyStream(FILE *in, FILE *out, std::vector<char> &buffer) {
+    rewind(in);
+    size_t read;
+    while ((read = fread(buffer.data(), 1, buffer.size(), in)) > 0) {
+        if (fwrite(buffer.data(), 1, read, out) != read) {
+            return false;
+        }
+    }
+    return !ferror(in);
+}
+
+static bool padTo(FILE *out, uint64_t offset) {
+    long position = ftell(out);
+    while (position >= 0 && (uint64_t) position < offset) {
+        fputc(0, out);
+        position++;
+    }
+    return position >= 0;
+}
+
+// Quantizes the staged positions and normals a chunk at a time, within the header's box: the interleaved stream goes
+// to out, the positions alone to quantizedPositions. The error is recorded in the header.
+static bool quantizeStreams(FILE *positions, FILE *normals, meshCacheHeader &header, FILE *out,
+                            FILE *quantizedPositions, size_t bufferSize) {
+    size_t vertexBytes = 2 * sizeof(glm::vec3) + (QUANTIZED_VERTEX_SIZE + QUANTIZED_POSITION_SIZE) * sizeof(short);
+    size_t chunkSize = std::max<size_t>(bufferSize / vertexBytes, 1);
+    std::vector<glm::vec3> chunkPositions(chunkSize), chunkNormals(chunkSize);
+    std::vector<short> vertices(chunkSize * QUANTIZED_VERTEX_SIZE), quantized(chunkSize * QUANTIZED_POSITION_SIZE);
+    glm::vec3 scale = getDequantizeScale(header), offset = getDequantizeOffset(header);
+    quantizationError error{0.0f, 0.0f};
+
+    rewind(positions);
+    rewind(normals);
+    for (uint64_t begin = 0; begin < header.vertexCount; begin += chunkSize) {
+        size_t count = std::min<size_t>(chunkSize, header.vertexCount - begin);
+        if (fread(chunkPositions.data(), sizeof(glm::vec3), count, positions) != count ||
+            fread(chunkNormals.data(), sizeof(glm::vec3), count, normals) != count) {
+            return false;
+        }
+        quantizeVertices(chunkPositions.data(), chunkNormals.data(), count, scale, offset, vertices.data(),
+                         quantized.data(), error);
+        if (fwrite(vertices.data(), sizeof(short) * QUANTIZED_VERTEX_SIZE, count, out) != count ||
+            fwrite(quantized.data(), sizeof(short) * QUANTIZED_POSITION_SIZE, count, quantizedPositions) != count) {
+            return false;
+        }
+    }
+    header.positionError = error.position;
+    header.normalError = error.normal;
+    return true;
+}
+
+bool MeshCacheWriter::finish(size_t bufferSize) {
+    if (!m_positions || !m_normals || !m_indices) {
+        return false;
+    }
+
+    meshCacheHeader header;
+    if (!initHeader(header, m_source_path, m_offset, m_vertex_count, m_index_count, m_corner_count)) {
+        return false;
+    }
+    setBounds(header, m_bounds_min, m_bounds_max);
+
+    std::string tempPath = m_cache_path + ".tmp";
+    FILE *out = fopen(tempPath.c_str(), "wb");
+    if (!out) {
+        std::cerr << "Could not write the mesh cache " << m_cache_path << std::endl;
+        return false;
+    }
+
+    // The quantized positions are staged too, since their blob follows the interleaved one.
+    FILE *quantizedPositions = tmpfile();
+    std::vector<char> buffer(std::max<size_t>(bufferSize, 4096) & ~size_t(3));
+    bool ok = quantizedPositions && fwrite(&header, sizeof(header), 1, out) == 1 &&
+              padTo(out, header.positionsOffset) && copyStream(m_positions, out, buffer) &&
+              padTo(out, header.verticesOffset) &&
+              quantizeStreams(m_positions, m_normals, header, out, quantizedPositions, buffer.size()) &&
+              padTo(out, header.quantizedPositionsOffset) && copyStream(quantizedPositions, out, buffer) &&
+              padTo(out, header.indicesOffset);
+    if (quantizedPositions) {
+        fclose(quantizedPositions);
+    }
+
+    if (ok && header.indexSize == 4) {
+        ok = copyStream(m_indices, out, buffer);
+    } else if (ok) {
+        // Narrow to 16 bits in place, a buffer at a time.
+        rewind(m_indices);
+        size_t read;
+        while (ok && (read = fread(buffer.data(), sizeof(uint32_t), buffer.size() / sizeof(uint32_t), m_indices)) > 0) {
+            const uint32_t *wide = (const uint32_t *) buffer.data();
+            uint16_t *narrow = (uint16_t *) buffer.data();
+            for (size_t i = 0; i < read; i++) {
+                narrow[i] = (uint16_t) wide[i];
+            }
+            ok = fwrite(narrow, sizeof(uint16_t), read, out) == read;
+        }
+    }
+
+    // The header again, now with the quantization error.
+    ok = ok && fseek(out, 0, SEEK_SET) == 0 && fwrite(&header, sizeof(header), 1, out) == 1;
+    ok = fclose(out) == 0 && ok;
+    if (!ok || rename(tempPath.c_str(), m_cache_path.c_str()) != 0) {
+        remove(tempPath.c_str());
+        return false;
+    }
+
+    return true;
+}
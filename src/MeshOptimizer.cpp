@@ -0,0 +1,295 @@
+#include "MeshOptimizer.h"
+#include <cmath>
+#include <algorithm>
+
+#define FORSYTH_CACHE_SIZE 32 // Modelled LRU cache size for the triangle scoring.
+
+// Simulates a FIFO cache of the given size with timestamps: a vertex is cached while it was added less than
+// `size` misses ago. reset() empties the cache without touching every vertex.
+class fifoCache {
+private:
+    std::vector<unsigned int> m_stamps;
+    unsigned int m_time, m_size;
+public:
+    fifoCache(size_t vertexNum, unsigned int size)
+            : m_stamps(vertexNum, 0), m_time(size + 1), m_size(size) {}
+
+    // Returns the number of misses a triangle causes.
+    unsigned int access(const unsigned int *triangle) {
+        unsigned int misses = 0;
+        for (int i = 0; i < 3; i++) {
+            if (m_time - m_stamps[triangle[i]] > m_size) {
+                m_stamps[triangle[i]] = m_time++;
+                misses++;
+            }
+        }
+        return misses;
+    }
+
+    void reset() {
+        m_time += m_size + 1;
+    }
+};
+
+vertexCacheStats analyzeVertexCache(const meshData &mesh, unsigned int cacheSize) {
+    vertexCacheStats stats{0.0f, 0.0f};
+    size_t triangleNum = mesh.indices.size() / 3;
+    if (triangleNum == 0 || mesh.positions.empty()) {
+        return stats;
+    }
+
+    fifoCache cache(mesh.positions.size(), cacheSize);
+    size_t misses = 0;
+    for (size_t t = 0; t < triangleNum; t++) {
+        misses += cache.access(&mesh.indices[3 * t]);
+    }
+    stats.acmr = float(misses) / triangleNum;
+    stats.atvr = float(misses) / mesh.positions.size();
+
+    return stats;
+}
+
+static float forsythVertexScore(int cachePosition, unsigned int remaining) {
+    if (remaining == 0) {
+        return -1.0f; // No triangle needs this vertex any more.
+    }
+
+    float score = 0.0f;
+    if (cachePosition >= 0) {
+        if (cachePosition < 3) {
+            score = 0.75f; // Used by the last triangle; fixed so the algorithm does not prefer one of its edges.
+        } else {
+            score = std::pow(1.0f - float(cachePosition - 3) / (FORSYTH_CACHE_SIZE - 3), 1.5f);
+        }
+    }
+    // Prefer vertices with few triangles left so they can be finished off.
+    score += 2.0f / std::sqrt(float(remaining));
+
+    return score;
+}
+
+void optimizeVertexCache(meshData &mesh) {
+    optimizeVertexCache(mesh.indices, mesh.positions.size());
+}
+
+void optimizeVertexCache(std::vector<unsigned int> &indices, size_t vertexNum) {
+    size_t triangleNum = indices.size() / 3;
+    if (triangleNum == 0) {
+        return;
+    }
+
+    // Vertex -> triangle adjacency; each vertex's live triangles are kept at the front of its range.
+    std::vector<unsigned int> remaining(vertexNum, 0), offsets(vertexNum + 1, 0);
+    for (unsigned int index: indices) {
+        remaining[index]++;
+    }
+    for (size_t v = 0; v < vertexNum; v++) {
+        offsets[v + 1] = offsets[v] + remaining[v];
+    }
+    std::vector<unsigned int> adjacency(indices.size()), cursor(offsets.begin(), offsets.end() - 1);
+    for (size_t t = 0; t < triangleNum; t++) {
+        for (int i = 0; i < 3; i++) {
+            adjacency[cursor[indices[3 * t + i]]++] = t;
+        }
+    }
+
+    std::vector<int> cachePosition(vertexNum, -1);
+    std::vector<float> vertexScore(vertexNum), triangleScore(triangleNum, 0.0f);
+    for (size_t v = 0; v < vertexNum; v++) {
+        vertexScore[v] = forsythVertexScore(-1, remaining[v]);
+    }
+    for (size_t t = 0; t < triangleNum; t++) {
+        for (int i = 0; i < 3; i++) {
+            triangleScore[t] += vertexScore[indices[3 * t + i]];
+        }
+    }
+
+    std::vector<bool> emitted(triangleNum, false);
+    std::vector<unsigned int> output, cache, newCache;
+    output.reserve(indices.size());
+    cache.reserve(FORSYTH_CACHE_SIZE + 3);
+    newCache.reserve(FORSYTH_CACHE_SIZE + 3);
+
+    long long best = std::max_element(triangleScore.begin(), triangleScore.end()) - triangleScore.begin();
+    size_t scan = 0; // Fallback cursor for when no cached vertex has triangles left.
+
+    for (size_t emittedNum = 0; emittedNum < triangleNum; emittedNum++) {
+        if (best < 0) {
+            while (emitted[scan]) {
+                scan++;
+            }
+            best = scan;
+        }
+
+        const unsigned int *triangle = &indices[3 * best];
+        output.insert(output.end(), triangle, triangle + 3);
+        emitted[best] = true;
+
+        // Remove the triangle from its vertices' live lists.
+        for (int i = 0; i < 3; i++) {
+            unsigned int v = triangle[i];
+            unsigned int *begin = &adjacency[offsets[v]], *end = begin + remaining[v];
+            unsigned int *it = std::find(begin, end, (unsigned int) best);
+            std::swap(*it, *(end - 1));
+            remaining[v]--;
+        }
+
+        // The triangle's vertices move to the front of the cache.
+        newCache.assign(triangle, triangle + 3);
+        for (unsigned int v: cache) {
+            if (v != triangle[0] && v != triangle[1] && v != triangle[2]) {
+                newCache.push_back(v);
+            }
+        }
+
+        // Rescore everything that was or is in the cache, and pick the best triangle around it.
+        float bestScore = -1e30f;
+        best = -1;
+        for (size_t i = 0; i < newCache.size(); i++) {
+            unsigned int v = newCache[i];
+            cachePosition[v] = i < FORSYTH_CACHE_SIZE ? (int) i : -1;
+            float score = forsythVertexScore(cachePosition[v], remaining[v]);
+            float delta = score - vertexScore[v];
+            vertexScore[v] = score;
+            for (unsigned int j = offsets[v]; j < offsets[v] + remaining[v]; j++) {
+                unsigned int t = adjacency[j];
+                triangleScore[t] += delta;
+                if (triangleScore[t] > bestScore) {
+                    bestScore = triangleScore[t];
+                    best = t;
+                }
+            }
+        }
+
+        if (newCache.size() > FORSYTH_CACHE_SIZE) {
+            newCache.resize(FORSYTH_CACHE_SIZE);
+        }
+        std::swap(cache, newCache);
+    }
+
+    indices.swap(output);
+}
+
+void optimizeOverdraw(meshData &mesh, float threshold) {
+    size_t triangleNum = mesh.indices.size() / 3;
+    if (triangleNum == 0) {
+        return;
+    }
+    fifoCache cache(mesh.positions.size(), VERTEX_CACHE_SIZE);
+
+    // Hard boundaries: a triangle missing all three vertices starts from a cold cache anyway.
+    std::vector<unsigned int> hard;
+    for (size_t t = 0; t < triangleNum; t++) {
+        if (cache.access(&mesh.indices[3 * t]) == 3) {
+            hard.push_back(t);
+        }
+    }
+    if (hard.empty() || hard[0] != 0) {
+        hard.insert(hard.begin(), 0);
+    }
+    hard.push_back(triangleNum);
+
+    // Soft boundaries: split a hard cluster wherever restarting the cache keeps ACMR within the threshold.
+    std::vector<unsigned int> clusters;
+    for (size_t c = 0; c + 1 < hard.size(); c++) {
+        unsigned int begin = hard[c], end = hard[c + 1];
+
+        cache.reset();
+        unsigned int misses = 0;
+        for (unsigned int t = begin; t < end; t++) {
+            misses += cache.access(&mesh.indices[3 * t]);
+        }
+        float target = threshold * float(misses) / (end - begin);
+
+        cache.reset();
+        clusters.push_back(begin);
+        misses = 0;
+        unsigned int start = begin;
+        for (unsigned int t = begin; t < end; t++) {
+            misses += cache.access(&mesh.indices[3 * t]);
+            if (t + 1 < end && float(misses) / (t + 1 - start) <= target) {
+                clusters.push_back(t + 1);
+                cache.reset();
+                misses = 0;
+                start = t + 1;
+            }
+        }
+    }
+    clusters.push_back(triangleNum);
+
+    // Area-weighted centroid of the whole mesh.
+    glm::vec3 meshCentroid(0.0f);
+    float meshArea = 0.0f;
+    std::vector<glm::vec3> faceNormals(triangleNum), faceCentroids(triangleNum);
+    for (size_t t = 0; t < triangleNum; t++) {
+        const glm::vec3 &p0 = mesh.positions[mesh.indices[3 * t]];
+        const glm::vec3 &p1 = mesh.positions[mesh.indices[3 * t + 1]];
+        const glm::vec3 &p2 = mesh.positions[mesh.indices[3 * t + 2]];
+        faceNormals[t] = glm::cross(p1 - p0, p2 - p0); // Length is twice the area.
+        faceCentroids[t] = (p0 + p1 + p2) / 3.0f;
+        float area = glm::length(faceNormals[t]);
+        meshCentroid += faceCentroids[t] * area;
+        meshArea += area;
+    }
+    if (meshArea > 0.0f) {
+        meshCentroid /= meshArea;
+    }
+
+    // Clusters facing outward from far out are drawn first: they are the likeliest occluders from any view.
+    size_t clusterNum = clusters.size() - 1;
+    std::vector<float> keys(clusterNum);
+    for (size_t c = 0; c < clusterNum; c++) {
+        glm::vec3 centroid(0.0f), normal(0.0f);
+        float area = 0.0f;
+        for (unsigned int t = clusters[c]; t < clusters[c + 1]; t++) {
+            float a = glm::length(faceNormals[t]);
+            centroid += faceCentroids[t] * a;
+            normal += faceNormals[t];
+            area += a;
+        }
+        centroid = area > 0.0f ? centroid / area : faceCentroids[clusters[c]];
+        float length = glm::length(normal);
+        keys[c] = length > 0.0f ? glm::dot(centroid - meshCentroid, normal / length) : 0.0f;
+    }
+
+    std::vector<unsigned int> order(clusterNum);
+    for (size_t c = 0; c < clusterNum; c++) {
+        order[c] = c;
+    }
+    std::stable_sort(order.begin(), order.end(), [&keys](unsigned int a, unsigned int b) { return keys[a] > keys[b]; });
+
+    std::vector<unsigned int> output;
+    output.reserve(mesh.indices.size());
+    for (unsigned int c: order) {
+        output.insert(output.end(), mesh.indices.begin() + 3 * clusters[c], mesh.indices.begin() + 3 * clusters[c + 1]);
+    }
+    mesh.indices.swap(output);
+}
+
+void optimizeVertexFetch(meshData &mesh) {
+    const unsigned int unused = ~0u;
+    std::vector<unsigned int> remap(mesh.positions.size(), unused);
+    std::vector<glm::vec3> positions, normals;
+    positions.reserve(mesh.positions.size());
+    normals.reserve(mesh.normals.size());
+
+    for (auto &index: mesh.indices) {
+        if (remap[index] == unused) {
+            remap[index] = positions.size();
+            positions.push_back(mesh.positions[index]);
+            normals.push_back(mesh.normals[index]);
+        }
+        index = remap[index];
+    }
+
+    mesh.positions.swap(positions);
+    mesh.normals.swap(normals);
+}
+
+void optimizeMesh(meshData &mesh, vertexCacheStats &before, vertexCacheStats &after) {
+    before = analyzeVertexCache(mesh);
+    optimizeVertexCache(mesh);
+    optimizeOverdraw(mesh);
+    optimizeVertexFetch(mesh);
+    after = analyzeVertexCache(mesh);
+}
@@ -0,0 +1,117 @@
+#include "MeshQuantizer.h"
+#include <cmath>
+#include <algorithm>
+
+short quantizeSnorm16(float value) {
+    value = std::max(-1.0f, std::min(1.0f, value));
+    return (short) std::lround(value * 32767.0f);
+}
+
+float dequantizeSnorm16(short value) {
+    return std::max(value / 32767.0f, -1.0f);
+}
+
+static glm::vec2 octahedralWrap(const glm::vec2 &v) {
+    return glm::vec2((1.0f - std::fabs(v.y)) * (v.x >= 0.0f ? 1.0f : -1.0f),
+                     (1.0f - std::fabs(v.x)) * (v.y >= 0.0f ? 1.0f : -1.0f));
+}
+
+glm::vec3 decodeOctahedral(short x, short y) {
+    glm::vec3 n(dequantizeSnorm16(x), dequantizeSnorm16(y), 0.0f);
+    n.z = 1.0f - std::fabs(n.x) - std::fabs(n.y);
+    float t = std::max(-n.z, 0.0f);
+    n.x += n.x >= 0.0f ? -t : t;
+    n.y += n.y >= 0.0f ? -t : t;
+    return glm::normalize(n);
+}
+
+void encodeOctahedral(const glm::vec3 &normal, short &x, short &y) {
+    float l1 = std::fabs(normal.x) + std::fabs(normal.y) + std::fabs(normal.z);
+    if (l1 == 0.0f) {
+        x = 0;
+        y = 32767; // Degenerate normals decode to +Y.
+        return;
+    }
+    glm::vec2 p(normal.x / l1, normal.y / l1);
+    if (normal.z < 0.0f) {
+        p = octahedralWrap(p);
+    }
+
+    // Try all four neighbouring grid points.
+    glm::vec3 unit = normal / glm::length(normal);
+    float fx = std::floor(std::max(-1.0f, std::min(1.0f, p.x)) * 32767.0f);
+    float fy = std::floor(std::max(-1.0f, std::min(1.0f, p.y)) * 32767.0f);
+    float bestDot = -2.0f;
+    for (int i = 0; i < 4; i++) {
+        short cx = (short) std::min(fx + (i & 1), 32767.0f);
+        short cy = (short) std::min(fy + (i >> 1), 32767.0f);
+        float d = glm::dot(decodeOctahedral(cx, cy), unit);
+        if (d > bestDot) {
+            bestDot = d;
+            x = cx;
+            y = cy;
+        }
+    }
+}
+
+void quantizationBox(const glm::vec3 &boundsMin, const glm::vec3 &boundsMax, glm::vec3 &scale, glm::vec3 &offset) {
+    offset = (boundsMin + boundsMax) * 0.5f;
+    scale = (boundsMax - boundsMin) * 0.5f;
+}
+
+void quantizeVertices(const glm::vec3 *positions, const glm::vec3 *normals, size_t vertexNum, const glm::vec3 &scale,
+                      const glm::vec3 &offset, short *vertices, short *quantizedPositions, quantizationError &error) {
+    glm::vec3 inverseScale;
+    for (int i = 0; i < 3; i++) {
+        inverseScale[i] = scale[i] > 0.0f ? 1.0f / scale[i] : 0.0f; // Flat axes quantize to zero.
+    }
+
+    float maxAngle = glm::radians(error.normal);
+    for (size_t v = 0; v < vertexNum; v++) {
+        short *position = &vertices[v * QUANTIZED_VERTEX_SIZE];
+        glm::vec3 normalized = (positions[v] - offset) * inverseScale;
+        glm::vec3 decoded;
+        for (int i = 0; i < 3; i++) {
+            position[i] = quantizeSnorm16(normalized[i]);
+            decoded[i] = dequantizeSnorm16(position[i]) * scale[i] + offset[i];
+        }
+        position[3] = 0;
+        error.position = std::max(error.position, glm::length(decoded - positions[v]));
+
+        std::copy(position, position + QUANTIZED_POSITION_SIZE, &quantizedPositions[v * QUANTIZED_POSITION_SIZE]);
+
+        short *normal = position + QUANTIZED_POSITION_SIZE;
+        encodeOctahedral(normals[v], normal[0], normal[1]);
+        float length = glm::length(normals[v]);
+        if (length > 0.0f) {
+            // atan2 stays accurate for the tiny angles acos would round to zero.
+            glm::vec3 restored = decodeOctahedral(normal[0], normal[1]), source = normals[v] / length;
+            maxAngle = std::max(maxAngle, std::atan2(glm::length(glm::cross(restored, source)),
+                                                     glm::dot(restored, source)));
+        }
+    }
+    error.normal = glm::degrees(maxAngle);
+}
+
+quantizationError quantizeMesh(const glm::vec3 *positions, const glm::vec3 *normals, size_t vertexNum,
+                               quantizedMesh &mesh) {
+    quantizationError error{0.0f, 0.0f};
+    mesh.vertices.resize(vertexNum * QUANTIZED_VERTEX_SIZE);
+    mesh.positions.resize(vertexNum * QUANTIZED_POSITION_SIZE);
+    mesh.scale = glm::vec3(1.0f);
+    mesh.offset = glm::vec3(0.0f);
+    if (vertexNum == 0) {
+        return error;
+    }
+
+    glm::vec3 boundsMin = positions[0], boundsMax = positions[0];
+    for (size_t v = 1; v < vertexNum; v++) {
+        boundsMin = glm::min(boundsMin, positions[v]);
+        boundsMax = glm::max(boundsMax, positions[v]);
+    }
+    quantizationBox(boundsMin, boundsMax, mesh.scale, mesh.offset);
+    quantizeVertices(positions, normals, vertexNum, mesh.scale, mesh.offset, mesh.vertices.data(),
+                     mesh.positions.data(), error);
+
+    return error;
+}
@@ -0,0 +1,305 @@
+#include "MeshSimplifier.h"
+#include "MeshOptimizer.h"
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
+
+#define BORDER_WEIGHT 10.0 // Keeps open borders in place.
+
+// Symmetric 4x4 error quadric with the total weight of its planes.
+struct quadric {
+    double a00, a01, a02, a03, a11, a12, a13, a22, a23, a33, w;
+};
+
+static void addPlane(quadric &q, const glm::dvec3 &n, double d, double weight) {
+    q.a00 += weight * n.x * n.x;
+    q.a01 += weight * n.x * n.y;
+    q.a02 += weight * n.x * n.z;
+    q.a03 += weight * n.x * d;
+    q.a11 += weight * n.y * n.y;
+    q.a12 += weight * n.y * n.z;
+    q.a13 += weight * n.y * d;
+    q.a22 += weight * n.z * n.z;
+    q.a23 += weight * n.z * d;
+    q.a33 += weight * d * d;
+    q.w += weight;
+}
+
+static void addQuadric(quadric &q, const quadric &r) {
+    q.a00 += r.a00;
+    q.a01 += r.a01;
+    q.a02 += r.a02;
+    q.a03 += r.a03;
+    q.a11 += r.a11;
+    q.a12 += r.a12;
+    q.a13 += r.a13;
+    q.a22 += r.a22;
+    q.a23 += r.a23;
+    q.a33 += r.a33;
+    q.w += r.w;
+}
+
+// Weighted mean squared distance from p to the quadric's planes.
+static double evaluate(const quadric &q, const glm::dvec3 &p) {
+    double e = q.a00 * p.x * p.x + 2.0 * q.a01 * p.x * p.y + 2.0 * q.a02 * p.x * p.z + 2.0 * q.a03 * p.x +
+               q.a11 * p.y * p.y + 2.0 * q.a12 * p.y * p.z + 2.0 * q.a13 * p.y +
+               q.a22 * p.z * p.z + 2.0 * q.a23 * p.z + q.a33;
+    return q.w > 0.0 ? std::fabs(e) / q.w : 0.0;
+}
+
+struct positionHash {
+    size_t operator()(const glm::vec3 &p) const {
+        uint32_t bits[3];
+        std::memcpy(bits, &p, sizeof(bits));
+        return (bits[0] * 73856093u) ^ (bits[1] * 19349663u) ^ (bits[2] * 83492791u);
+    }
+};
+
+static inline uint64_t edgeKey(unsigned int a, unsigned int b) {
+    return (uint64_t(a) << 32) | b;
+}
+
+struct collapseCandidate {
+    unsigned int from, to;
+    double cost;
+};
+
+float simplifyMesh(const meshData &mesh, const std::vector<unsigned int> &indices, size_t targetIndexCount,
+                   std::vector<unsigned int> &result) {
+    result = indices;
+    size_t vertexNum = mesh.positions.size();
+    if (result.size() <= targetIndexCount || vertexNum == 0) {
+        return 0.0f;
+    }
+
+    // Vertices sharing a position (normal seams) collapse together, so topology is taken over positions.
+    std::vector<unsigned int> canonical(vertexNum);
+    std::unordered_map<glm::vec3, unsigned int, positionHash> firstAt;
+    firstAt.reserve(vertexNum);
+    for (size_t i = 0; i < vertexNum; i++) {
+        canonical[i] = firstAt.emplace(mesh.positions[i], (unsigned int) i).first->second;
+    }
+    std::vector<unsigned int> wedgeOffsets(vertexNum + 1, 0), wedges(vertexNum);
+    for (size_t i = 0; i < vertexNum; i++) {
+        wedgeOffsets[canonical[i] + 1]++;
+    }
+    for (size_t i = 0; i < vertexNum; i++) {
+        wedgeOffsets[i + 1] += wedgeOffsets[i];
+    }
+    std::vector<unsigned int> cursor(wedgeOffsets.begin(), wedgeOffsets.end() - 1);
+    for (size_t i = 0; i < vertexNum; i++) {
+        wedges[cursor[canonical[i]]++] = i;
+    }
+
+    // Errors are measured in a unit cube so thresholds do not depend on the mesh scale.
+    glm::vec3 boundsMin = mesh.positions[0], boundsMax = mesh.positions[0];
+    for (const auto &p: mesh.positions) {
+        boundsMin = glm::min(boundsMin, p);
+        boundsMax = glm::max(boundsMax, p);
+    }
+    glm::vec3 extent = boundsMax - boundsMin;
+    double scale = 1.0 / std::max(1e-12, (double) std::max(extent.x, std::max(extent.y, extent.z)));
+    std::vector<glm::dvec3> points(vertexNum);
+    for (size_t i = 0; i < vertexNum; i++) {
+        points[i] = glm::dvec3(mesh.positions[i] - boundsMin) * scale;
+    }
+
+    std::vector<quadric> quadrics(vertexNum, quadric{});
+    std::unordered_set<uint64_t> edges;
+    auto collectEdges = [&]() {
+        edges.clear();
+        for (size_t i = 0; i < result.size(); i += 3) {
+            for (int k = 0; k < 3; k++) {
+                edges.insert(edgeKey(canonical[result[i + k]], canonical[result[i + (k + 1) % 3]]));
+            }
+        }
+    };
+    auto isBorder = [&edges](unsigned int a, unsigned int b) {
+        return edges.count(edgeKey(b, a)) == 0;
+    };
+
+    collectEdges();
+    for (size_t i = 0; i < result.size(); i += 3) {
+        unsigned int c[3] = {canonical[result[i]], canonical[result[i + 1]], canonical[result[i + 2]]};
+        glm::dvec3 normal = glm::cross(points[c[1]] - points[c[0]], points[c[2]] - points[c[0]]);
+        double length = glm::length(normal);
+        if (length <= 0.0) {
+            continue;
+        }
+        normal /= length;
+        double area = 0.5 * length, d = -glm::dot(normal, points[c[0]]);
+        for (int k = 0; k < 3; k++) {
+            addPlane(quadrics[c[k]], normal, d, area);
+
+            // Border edges get a plane through them perpendicular to the face.
+            unsigned int a = c[k], b = c[(k + 1) % 3];
+            if (isBorder(a, b)) {
+                glm::dvec3 edge = points[b] - points[a];
+                glm::dvec3 side = glm::cross(edge, normal);
+                double sideLength = glm::length(side);
+                if (sideLength > 0.0) {
+                    side /= sideLength;
+                    double weight = BORDER_WEIGHT * glm::dot(edge, edge);
+                    addPlane(quadrics[a], side, -glm::dot(side, points[a]), weight);
+                    addPlane(quadrics[b], side, -glm::dot(side, points[b]), weight);
+                }
+            }
+        }
+    }
+
+    double maxError = 0.0;
+    std::vector<unsigned int> collapse(vertexNum), triangleOffsets(vertexNum + 1), adjacency, remap(vertexNum);
+    std::vector<bool> locked(vertexNum), border(vertexNum);
+    std::vector<collapseCandidate> candidates;
+
+    while (result.size() > targetIndexCount) {
+        size_t triangleNum = result.size() / 3;
+
+        // Vertex -> triangle adjacency over canonical vertices.
+        std::fill(triangleOffsets.begin(), triangleOffsets.end(), 0);
+        for (unsigned int index: result) {
+            triangleOffsets[canonical[index] + 1]++;
+        }
+        for (size_t i = 0; i < vertexNum; i++) {
+            triangleOffsets[i + 1] += triangleOffsets[i];
+        }
+        adjacency.resize(result.size());
+        cursor.assign(triangleOffsets.begin(), triangleOffsets.end() - 1);
+        for (size_t t = 0; t < triangleNum; t++) {
+            for (int k = 0; k < 3; k++) {
+                adjacency[cursor[canonical[result[3 * t + k]]]++] = t;
+            }
+        }
+
+        collectEdges();
+        std::fill(border.begin(), border.end(), false);
+        candidates.clear();
+        for (size_t t = 0; t < triangleNum; t++) {
+            for (int k = 0; k < 3; k++) {
+                unsigned int a = canonical[result[3 * t + k]], b = canonical[result[3 * t + (k + 1) % 3]];
+                if (isBorder(a, b)) {
+                    border[a] = border[b] = true;
+                }
+                candidates.push_back({a, b, evaluate(quadrics[a], points[b])});
+                candidates.push_back({b, a, evaluate(quadrics[b], points[a])});
+            }
+        }
+        std::sort(candidates.begin(), candidates.end(),
+                  [](const collapseCandidate &x, const collapseCandidate &y) { return x.cost < y.cost; });
+
+        // Greedily take the cheapest collapses that do not touch each other's neighbourhoods.
+        std::fill(collapse.begin(), collapse.end(), ~0u);
+        std::fill(locked.begin(), locked.end(), false);
+        size_t removed = 0, collapsed = 0;
+        for (const auto &candidate: candidates) {
+            if ((triangleNum - removed) * 3 <= targetIndexCount) {
+                break;
+            }
+            unsigned int u = candidate.from, v = candidate.to;
+            if (u == v || locked[u] || locked[v]) {
+                continue;
+            }
+            // Border vertices may only slide along their border.
+            if (border[u] && !(isBorder(u, v) || isBorder(v, u))) {
+                continue;
+            }
+
+            // Reject collapses that flip a remaining triangle around u.
+            bool flips = false;
+            size_t shared = 0;
+            for (unsigned int j = triangleOffsets[u]; j < triangleOffsets[u + 1] && !flips; j++) {
+                const unsigned int *triangle = &result[3 * adjacency[j]];
+                unsigned int c[3] = {canonical[triangle[0]], canonical[triangle[1]], canonical[triangle[2]]};
+                if (c[0] == v || c[1] == v || c[2] == v) {
+                    shared++;
+                    continue;
+                }
+                glm::dvec3 before = glm::cross(points[c[1]] - points[c[0]], points[c[2]] - points[c[0]]);
+                for (auto &x: c) {
+                    x = x == u ? v : x;
+                }
+                glm::dvec3 after = glm::cross(points[c[1]] - points[c[0]], points[c[2]] - points[c[0]]);
+                flips = glm::dot(before, after) <= 0.0;
+            }
+            if (flips) {
+                continue;
+            }
+
+            collapse[u] = v;
+            for (unsigned int j = triangleOffsets[u]; j < triangleOffsets[u + 1]; j++) {
+                const unsigned int *triangle = &result[3 * adjacency[j]];
+                for (int k = 0; k < 3; k++) {
+                    locked[canonical[triangle[k]]] = true;
+                }
+            }
+            locked[v] = true;
+            addQuadric(quadrics[v], quadrics[u]);
+            maxError = std::max(maxError, candidate.cost);
+            removed += shared;
+            collapsed++;
+        }
+        if (collapsed == 0) {
+            break;
+        }
+
+        // Each wedge of a collapsed vertex moves to the wedge of the target whose normal matches best.
+        for (size_t i = 0; i < vertexNum; i++) {
+            unsigned int v = collapse[canonical[i]];
+            remap[i] = i;
+            if (v == ~0u) {
+                continue;
+            }
+            float bestDot = -2.0f;
+            for (unsigned int j = wedgeOffsets[v]; j < wedgeOffsets[v + 1]; j++) {
+                float d = glm::dot(mesh.normals[i], mesh.normals[wedges[j]]);
+                if (d > bestDot) {
+                    bestDot = d;
+                    remap[i] = wedges[j];
+                }
+            }
+        }
+
+        size_t write = 0;
+        for (size_t t = 0; t < triangleNum; t++) {
+            unsigned int a = remap[result[3 * t]], b = remap[result[3 * t + 1]], c = remap[result[3 * t + 2]];
+            if (canonical[a] == canonical[b] || canonical[b] == canonical[c] || canonical[a] == canonical[c]) {
+                continue;
+            }
+            result[write++] = a;
+            result[write++] = b;
+            result[write++] = c;
+        }
+        result.resize(write);
+    }
+
+    return float(std::sqrt(maxError) / scale);
+}
+
+void buildLodChain(meshData &mesh) {
+    if (!mesh.lods.empty()) {
+        return;
+    }
+    mesh.lods.push_back({0, (unsigned int) mesh.indices.size(), 0.0f});
+
+    std::vector<unsigned int> current = mesh.indices, next;
+    float error = 0.0f;
+    for (unsigned int level = 1; level < MAX_LOD_LEVELS; level++) {
+        size_t target = size_t(current.size() / 3 * LOD_REDUCTION) * 3;
+        if (target / 3 < LOD_MIN_TRIANGLES) {
+            break;
+        }
+
+        // Each level starts from the previous one, so the errors add up.
+        error += simplifyMesh(mesh, current, target, next);
+        if (next.size() > current.size() * 9 / 10) {
+            break; // Stuck on borders or flips; more levels would be near copies.
+        }
+        optimizeVertexCache(next, mesh.positions.size());
+
+        mesh.lods.push_back({(unsigned int) mesh.indices.size(), (unsigned int) next.size(), error});
+        mesh.indices.insert(mesh.indices.end(), next.begin(), next.end());
+        current.swap(next);
+    }
+}
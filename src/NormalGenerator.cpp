@@ -0,0 +1,151 @@
+#include "NormalGenerator.h"
+#include "Simd.h"
+#include <thread>
+#include <atomic>
+#include <memory>
+#include <functional>
+#include <cmath>
+#include <algorithm>
+
+#define MIN_PARALLEL_ITEMS 65536 // Smaller ranges are not worth another thread.
+
+// Runs body over [0, count) split into one contiguous range per thread.
+static void parallelFor(size_t count, unsigned int threadNum, const std::function<void(size_t, size_t)> &body) {
+    size_t rangeNum = std::max<size_t>(1, std::min<size_t>(threadNum, count / MIN_PARALLEL_ITEMS));
+    if (rangeNum == 1) {
+        body(0, count);
+        return;
+    }
+
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < rangeNum; i++) {
+        threads.emplace_back(body, count * i / rangeNum, count * (i + 1) / rangeNum);
+    }
+    for (auto &thread: threads) {
+        thread.join();
+    }
+}
+
+NormalGenerator::NormalGenerator(unsigned int threadNum)
+        : m_thread_num(threadNum) {
+    if (m_thread_num == 0) {
+        m_thread_num = std::max(1u, std::thread::hardware_concurrency());
+    }
+}
+
+size_t NormalGenerator::generate(objData &data, float creaseAngle) const {
+    size_t cornerNum = data.corners.size() - data.corners.size() % 3;
+    size_t missing = 0;
+    for (size_t c = 0; c < cornerNum; c++) {
+        missing += data.corners[c].normal < 0;
+    }
+    if (missing == 0) {
+        return 0;
+    }
+
+    // 1. Face normals, four triangles per SIMD step. Stored as unit vectors plus twice the area as the weight.
+    size_t faceNum = cornerNum / 3;
+    size_t paddedNum = (faceNum + SIMD_WIDTH - 1) / SIMD_WIDTH * SIMD_WIDTH;
+    std::vector<float> faceX(paddedNum), faceY(paddedNum), faceZ(paddedNum), faceWeight(paddedNum);
+    const float *positions = data.positions.data();
+    const objCorner *corners = data.corners.data();
+
+    parallelFor(paddedNum / SIMD_WIDTH, m_thread_num, [&](size_t begin, size_t end) {
+        float p[3][3][SIMD_WIDTH]; // Corner, axis, lane.
+        for (size_t block = begin; block < end; block++) {
+            for (size_t lane = 0; lane < SIMD_WIDTH; lane++) {
+                size_t f = std::min(block * SIMD_WIDTH + lane, faceNum - 1);
+                for (int k = 0; k < 3; k++) {
+                    const float *v = positions + 3 * corners[3 * f + k].position;
+                    p[k][0][lane] = v[0];
+                    p[k][1][lane] = v[1];
+                    p[k][2][lane] = v[2];
+                }
+            }
+
+            simdFloat4 ax = simdLoad(p[0][0]), ay = simdLoad(p[0][1]), az = simdLoad(p[0][2]);
+            simdFloat4 ux = simdLoad(p[1][0]) - ax, uy = simdLoad(p[1][1]) - ay, uz = simdLoad(p[1][2]) - az;
+            simdFloat4 vx = simdLoad(p[2][0]) - ax, vy = simdLoad(p[2][1]) - ay, vz = simdLoad(p[2][2]) - az;
+            simdFloat4 nx = uy * vz - uz * vy, ny = uz * vx - ux * vz, nz = ux * vy - uy * vx;
+            simdFloat4 length = simdSqrt(nx * nx + ny * ny + nz * nz);
+            simdFloat4 inverse = simdSet(1.0f) / simdMax(length, simdSet(1e-30f)); // Degenerate faces stay zero.
+
+            size_t f = block * SIMD_WIDTH;
+            simdStore(&faceX[f], nx * inverse);
+            simdStore(&faceY[f], ny * inverse);
+            simdStore(&faceZ[f], nz * inverse);
+            simdStore(&faceWeight[f], length);
+        }
+    });
+
+    // 2. Position -> corner adjacency: lock-free counting and scatter, then each range sorted so sums are ordered.
+    size_t positionNum = data.positions.size() / 3;
+    std::unique_ptr<std::atomic<unsigned int>[]> counts(new std::atomic<unsigned int>[positionNum + 1]());
+    parallelFor(cornerNum, m_thread_num, [&](size_t begin, size_t end) {
+        for (size_t c = begin; c < end; c++) {
+            counts[corners[c].position].fetch_add(1, std::memory_order_relaxed);
+        }
+    });
+    std::vector<unsigned int> offsets(positionNum + 1, 0);
+    for (size_t v = 0; v < positionNum; v++) {
+        offsets[v + 1] = offsets[v] + counts[v].load(std::memory_order_relaxed);
+        counts[v].store(offsets[v], std::memory_order_relaxed);
+    }
+    std::vector<unsigned int> adjacency(cornerNum);
+    parallelFor(cornerNum, m_thread_num, [&](size_t begin, size_t end) {
+        for (size_t c = begin; c < end; c++) {
+            adjacency[counts[corners[c].position].fetch_add(1, std::memory_order_relaxed)] = c;
+        }
+    });
+
+    // 3. Per corner, sum the faces around its position within the crease angle.
+    float cosCrease = std::cos(creaseAngle * float(M_PI) / 180.0f);
+    size_t normalBase = data.normals.size() / 3;
+    data.normals.resize(data.normals.size() + 3 * missing);
+    std::vector<unsigned int> target(cornerNum); // Where each missing corner's normal goes.
+    for (size_t c = 0, n = normalBase; c < cornerNum; c++) {
+        target[c] = data.corners[c].normal < 0 ? n++ : ~0u;
+    }
+    float *normals = data.normals.data();
+
+    parallelFor(positionNum, m_thread_num, [&](size_t begin, size_t end) {
+        std::vector<float> around; // Unit normal and weight of each face around the position, gathered once.
+        for (size_t v = begin; v < end; v++) {
+            unsigned int *first = &adjacency[offsets[v]], *last = &adjacency[offsets[v + 1]];
+            std::sort(first, last);
+            around.clear();
+            for (unsigned int *c = first; c != last; c++) {
+                size_t f = *c / 3;
+                around.insert(around.end(), {faceX[f], faceY[f], faceZ[f], faceWeight[f]});
+            }
+
+            size_t aroundNum = last - first;
+            for (size_t i = 0; i < aroundNum; i++) {
+                unsigned int c = first[i];
+                if (target[c] == ~0u) {
+                    continue;
+                }
+                const float *face = &around[4 * i];
+                bool degenerate = face[3] == 0.0f;
+                float sx = 0.0f, sy = 0.0f, sz = 0.0f;
+                for (size_t j = 0; j < aroundNum; j++) {
+                    const float *other = &around[4 * j];
+                    float cosine = face[0] * other[0] + face[1] * other[1] + face[2] * other[2];
+                    if (i == j || degenerate || cosine >= cosCrease) {
+                        sx += other[0] * other[3];
+                        sy += other[1] * other[3];
+                        sz += other[2] * other[3];
+                    }
+                }
+                float length = std::sqrt(sx * sx + sy * sy + sz * sz);
+                float *normal = normals + 3 * target[c];
+                normal[0] = length > 0.0f ? sx / length : 0.0f;
+                normal[1] = length > 0.0f ? sy / length : 0.0f;
+                normal[2] = length > 0.0f ? sz / length : 0.0f;
+                data.corners[c].normal = target[c];
+            }
+        }
+    });
+
+    return missing;
+}
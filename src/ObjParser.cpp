@@ -0,0 +1,376 @@
+#include "ObjParser.h"
+#include <thread>
+#include <algorithm>
+#include <functional>
+#include <cmath>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define MIN_CHUNK_SIZE (256 * 1024) // Smaller files are not worth another thread.
+
+// Result of parsing one newline-aligned slice of the file.
+struct objChunk {
+    const char *begin;
+    const char *end;
+    std::vector<float> positions;
+    std::vector<float> normals;
+    std::vector<objCorner> corners;
+    std::vector<unsigned int> relativePositions; // Corners whose position index is relative to this chunk.
+    std::vector<unsigned int> relativeNormals;
+    size_t positionBase, normalBase, cornerBase; // Prefix sums over the previous chunks.
+    std::string error;
+};
+
+static const double powersOf10[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+                                    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+static inline bool isDigit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+static inline bool isSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+static inline const char *skipSpaces(const char *p, const char *end) {
+    while (p < end && isSpace(*p)) {
+        p++;
+    }
+    return p;
+}
+
+static inline const char *skipLine(const char *p, const char *end) {
+    while (p < end && *p != '\n') {
+        p++;
+    }
+    return p < end ? p + 1 : end;
+}
+
+const char *ObjParser::parseFloat(const char *p, const char *end, float &value) {
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+')) {
+        negative = *p == '-';
+        p++;
+    }
+
+    uint64_t mantissa = 0;
+    int exponent = 0, digits = 0;
+    bool any = false;
+    while (p < end && isDigit(*p)) {
+        if (digits < 19) {
+            mantissa = mantissa * 10 + (*p - '0');
+            digits += mantissa != 0;
+        } else {
+            exponent++;
+        }
+        any = true;
+        p++;
+    }
+    if (p < end && *p == '.') {
+        p++;
+        while (p < end && isDigit(*p)) {
+            if (digits < 19) {
+                mantissa = mantissa * 10 + (*p - '0');
+                digits += mantissa != 0;
+                exponent--;
+            }
+            any = true;
+            p++;
+        }
+    }
+    if (!any) {
+        return nullptr;
+    }
+    if (p < end && (*p == 'e' || *p == 'E')) {
+        const char *q = p + 1;
+        bool negativeExp = false;
+        if (q < end && (*q == '-' || *q == '+')) {
+            negativeExp = *q == '-';
+            q++;
+        }
+        if (q < end && isDigit(*q)) {
+            int e = 0;
+            while (q < end && isDigit(*q)) {
+                if (e < 10000) {
+                    e = e * 10 + (*q - '0');
+                }
+                q++;
+            }
+            exponent += negativeExp ? -e : e;
+            p = q;
+        }
+    }
+
+    double result = (double) mantissa;
+    if (mantissa != 0) {
+        if (exponent >= 0 && exponent <= 22) {
+            result *= powersOf10[exponent];
+        } else if (exponent < 0 && exponent >= -22) {
+            result /= powersOf10[-exponent];
+        } else {
+            result *= std::pow(10.0, exponent);
+        }
+    }
+    value = (float) (negative ? -result : result);
+
+    return p;
+}
+
+static inline const char *parseInt(const char *p, const char *end, int &value) {
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+')) {
+        negative = *p == '-';
+        p++;
+    }
+    if (p >= end || !isDigit(*p)) {
+        return nullptr;
+    }
+    int result = 0;
+    while (p < end && isDigit(*p)) {
+        result = result * 10 + (*p - '0');
+        p++;
+    }
+    value = negative ? -result : result;
+    return p;
+}
+
+static const char *parseVector(const char *p, const char *end, std::vector<float> &out) {
+    for (int i = 0; i < 3; i++) {
+        float value;
+        p = skipSpaces(p, end);
+        p = ObjParser::parseFloat(p, end, value);
+        if (!p) {
+            return nullptr;
+        }
+        out.push_back(value);
+    }
+    return p;
+}
+
+// Resolves a 1-based or negative OBJ index. Negative ones are stored relative to the chunk and fixed up on merge.
+static inline bool resolveIndex(int index, size_t localCount, int &resolved, bool &relative) {
+    if (index > 0) {
+        resolved = index - 1;
+        relative = false;
+    } else if (index < 0) {
+        resolved = (int) localCount + index;
+        relative = true;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+static const char *parseFace(const char *p, const char *end, objChunk &chunk) {
+    objCorner first{}, previous{};
+    bool firstRelative[2] = {false, false}, previousRelative[2] = {false, false};
+    unsigned int count = 0;
+
+    while (true) {
+        p = skipSpaces(p, end);
+        if (p >= end || *p == '\n' || *p == '#') {
+            break;
+        }
+
+        objCorner corner{-1, -1};
+        bool relative[2] = {false, false};
+        int index;
+        p = parseInt(p, end, index);
+        if (!p || !resolveIndex(index, chunk.positions.size() / 3, corner.position, relative[0])) {
+            return nullptr;
+        }
+        if (p < end && *p == '/') {
+            p++;
+            if (p < end && *p != '/') { // Texture coordinate index, unused.
+                p = parseInt(p, end, index);
+                if (!p) {
+                    return nullptr;
+                }
+            }
+            if (p < end && *p == '/') {
+                p++;
+                p = parseInt(p, end, index);
+                if (!p || !resolveIndex(index, chunk.normals.size() / 3, corner.normal, relative[1])) {
+                    return nullptr;
+                }
+            }
+        }
+
+        // Fan triangulation.
+        if (count == 0) {
+            first = corner;
+            firstRelative[0] = relative[0];
+            firstRelative[1] = relative[1];
+        } else if (count >= 2) {
+            const objCorner triangle[3] = {first, previous, corner};
+            const bool *flags[3] = {firstRelative, previousRelative, relative};
+            for (int i = 0; i < 3; i++) {
+                unsigned int cornerIndex = chunk.corners.size();
+                if (flags[i][0]) {
+                    chunk.relativePositions.push_back(cornerIndex);
+                }
+                if (flags[i][1]) {
+                    chunk.relativeNormals.push_back(cornerIndex);
+                }
+                chunk.corners.push_back(triangle[i]);
+            }
+        }
+        previous = corner;
+        previousRelative[0] = relative[0];
+        previousRelative[1] = relative[1];
+        count++;
+    }
+
+    return count >= 3 ? p : nullptr;
+}
+
+static void parseChunk(objChunk &chunk) {
+    const char *p = chunk.begin, *end = chunk.end;
+    while (p < end) {
+        const char *line = p;
+        p = skipSpaces(p, end);
+        const char *next = nullptr;
+        if (p + 1 < end && p[0] == 'v' && isSpace(p[1])) {
+            next = parseVector(p + 2, end, chunk.positions);
+        } else if (p + 2 < end && p[0] == 'v' && p[1] == 'n' && isSpace(p[2])) {
+            next = parseVector(p + 3, end, chunk.normals);
+        } else if (p + 1 < end && p[0] == 'f' && isSpace(p[1])) {
+            next = parseFace(p + 2, end, chunk);
+        } else {
+            p = skipLine(p, end); // Comments, texture coordinates, groups, materials...
+            continue;
+        }
+
+        if (!next) {
+            const char *lineEnd = line;
+            while (lineEnd < end && *lineEnd != '\n' && *lineEnd != '\r') {
+                lineEnd++;
+            }
+            chunk.error = "Malformed line: " + std::string(line, lineEnd);
+            return;
+        }
+        p = skipLine(next, end);
+    }
+}
+
+ObjParser::ObjParser(unsigned int threadNum)
+        : m_thread_num(threadNum) {
+    if (m_thread_num == 0) {
+        m_thread_num = std::max(1u, std::thread::hardware_concurrency());
+    }
+}
+
+bool ObjParser::parse(const std::string &filePath, objData &data) {
+    int fd = open(filePath.c_str(), O_RDONLY);
+    if (fd < 0) {
+        m_error = "Could not open " + filePath;
+        return false;
+    }
+    struct stat st{};
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        m_error = "Could not stat " + filePath;
+        return false;
+    }
+    if (st.st_size == 0) {
+        close(fd);
+        data = objData();
+        return true;
+    }
+
+    void *mapped = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED) {
+        m_error = "Could not map " + filePath;
+        return false;
+    }
+    madvise(mapped, st.st_size, MADV_SEQUENTIAL);
+
+    const char *begin = (const char *) mapped;
+    bool result = parse(begin, begin + st.st_size, data);
+    munmap(mapped, st.st_size);
+    if (!result) {
+        m_error = filePath + ": " + m_error;
+    }
+
+    return result;
+}
+
+bool ObjParser::parse(const char *begin, const char *end, objData &data) {
+    m_error.clear();
+
+    // Split into newline-aligned chunks.
+    size_t size = end - begin;
+    size_t chunkNum = std::max<size_t>(1, std::min<size_t>(m_thread_num, size / MIN_CHUNK_SIZE));
+    std::vector<objChunk> chunks(chunkNum);
+    const char *p = begin;
+    for (size_t i = 0; i < chunkNum; i++) {
+        chunks[i].begin = p;
+        const char *q = i + 1 == chunkNum ? end : std::max(p, begin + size * (i + 1) / chunkNum);
+        while (q < end && q[-1] != '\n') {
+            q++;
+        }
+        chunks[i].end = q;
+        p = q;
+    }
+
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < chunkNum; i++) {
+        threads.emplace_back(parseChunk, std::ref(chunks[i]));
+    }
+    parseChunk(chunks[0]);
+    for (auto &thread: threads) {
+        thread.join();
+    }
+    threads.clear();
+
+    // Prefix sums give each chunk its place in the merged arrays.
+    size_t positionNum = 0, normalNum = 0, cornerNum = 0;
+    for (auto &chunk: chunks) {
+        if (!chunk.error.empty()) {
+            m_error = chunk.error;
+            return false;
+        }
+        chunk.positionBase = positionNum;
+        chunk.normalBase = normalNum;
+        chunk.cornerBase = cornerNum;
+        positionNum += chunk.positions.size();
+        normalNum += chunk.normals.size();
+        cornerNum += chunk.corners.size();
+    }
+    data.positions.resize(positionNum);
+    data.normals.resize(normalNum);
+    data.corners.resize(cornerNum);
+
+    auto merge = [&data](objChunk &chunk) {
+        std::copy(chunk.positions.begin(), chunk.positions.end(), data.positions.begin() + chunk.positionBase);
+        std::copy(chunk.normals.begin(), chunk.normals.end(), data.normals.begin() + chunk.normalBase);
+        objCorner *corners = data.corners.data() + chunk.cornerBase;
+        std::copy(chunk.corners.begin(), chunk.corners.end(), corners);
+        for (unsigned int i: chunk.relativePositions) {
+            corners[i].position += chunk.positionBase / 3;
+        }
+        for (unsigned int i: chunk.relativeNormals) {
+            corners[i].normal += chunk.normalBase / 3;
+        }
+    };
+    for (size_t i = 1; i < chunkNum; i++) {
+        threads.emplace_back(merge, std::ref(chunks[i]));
+    }
+    merge(chunks[0]);
+    for (auto &thread: threads) {
+        thread.join();
+    }
+
+    int vertexCount = positionNum / 3, normalCount = normalNum / 3;
+    for (const auto &corner: data.corners) {
+        if (corner.position < 0 || corner.position >= vertexCount || corner.normal >= normalCount) {
+            m_error = "Face index out of range";
+            return false;
+        }
+    }
+
+    return true;
+}
@@ -0,0 +1,282 @@
+#include "ObjStreamer.h"
+#include "ObjParser.h"
+#include <vector>
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#define MIN_WINDOW_SIZE (64 * 1024)
+#define BYTES_PER_CORNER 48 // Index, worst-case unique vertex and welder slots of one batch corner.
+
+// Growable vec3 array backed by an unlinked temporary file, so its pages can be written back and dropped.
+class spillArray {
+private:
+    FILE *m_file;
+    glm::vec3 *m_data;
+    size_t m_size, m_capacity;
+public:
+    spillArray()
+            : m_file(tmpfile()), m_data(nullptr), m_size(0), m_capacity(0) {}
+
+    ~spillArray() {
+        if (m_data) {
+            munmap(m_data, m_capacity * sizeof(glm::vec3));
+        }
+        if (m_file) {
+            fclose(m_file);
+        }
+    }
+
+    bool push(const glm::vec3 &value) {
+        if (m_size == m_capacity && !grow()) {
+            return false;
+        }
+        m_data[m_size++] = value;
+        return true;
+    }
+
+    inline size_t size() const { return m_size; }
+
+    inline const glm::vec3 &operator[](size_t index) const { return m_data[index]; }
+
+private:
+    bool grow() {
+        if (!m_file) {
+            return false;
+        }
+        size_t capacity = std::max<size_t>(m_capacity * 2, 1 << 16);
+        if (ftruncate(fileno(m_file), capacity * sizeof(glm::vec3)) != 0) {
+            return false;
+        }
+        void *data = mmap(nullptr, capacity * sizeof(glm::vec3), PROT_READ | PROT_WRITE, MAP_SHARED,
+                          fileno(m_file), 0);
+        if (data == MAP_FAILED) {
+            return false;
+        }
+        if (m_data) {
+            munmap(m_data, m_capacity * sizeof(glm::vec3));
+        }
+        m_data = (glm::vec3 *) data;
+        m_capacity = capacity;
+        return true;
+    }
+};
+
+static inline bool isSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+static inline const char *skipSpaces(const char *p, const char *end) {
+    while (p < end && isSpace(*p)) {
+        p++;
+    }
+    return p;
+}
+
+static bool parseVector(const char *p, const char *end, glm::vec3 &out) {
+    for (int i = 0; i < 3; i++) {
+        p = ObjParser::parseFloat(skipSpaces(p, end), end, out[i]);
+        if (!p) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Parses "v", "v/vt", "v//vn" or "v/vt/vn" into 0-based indices, resolving negative ones against the counts so far.
+static const char *parseCorner(const char *p, const char *end, long long positionNum, long long normalNum,
+                               long long &position, long long &normal) {
+    auto parseIndex = [&](long long count, long long &out) -> bool {
+        char *next;
+        long long value = strtoll(p, &next, 10);
+        if (next == p || value == 0) {
+            return false;
+        }
+        out = value > 0 ? value - 1 : count + value;
+        p = next;
+        return true;
+    };
+
+    normal = -1;
+    if (!parseIndex(positionNum, position)) {
+        return nullptr;
+    }
+    if (p < end && *p == '/') {
+        p++;
+        if (p < end && *p != '/') {
+            long long texcoord;
+            if (!parseIndex(1, texcoord)) {
+                return nullptr;
+            }
+        }
+        if (p < end && *p == '/') {
+            p++;
+            if (!parseIndex(normalNum, normal)) {
+                return nullptr;
+            }
+        }
+    }
+    return p;
+}
+
+ObjStreamer::ObjStreamer(size_t memoryBudget)
+        : m_memory_budget(memoryBudget), m_batch_num(0) {
+    m_window_size = std::max<size_t>(m_memory_budget / 4, MIN_WINDOW_SIZE);
+    m_batch_corners = std::max<size_t>((m_memory_budget - m_memory_budget / 4) / BYTES_PER_CORNER, 3);
+    m_batch_corners -= m_batch_corners % 3;
+}
+
+bool ObjStreamer::stream(const std::string &filePath, const glm::vec3 &offset,
+                         const std::function<bool(meshData &batch)> &consume) {
+    m_error.clear();
+    m_batch_num = 0;
+
+    int fd = open(filePath.c_str(), O_RDONLY);
+    if (fd < 0) {
+        m_error = "Could not open " + filePath;
+        return false;
+    }
+
+    spillArray positions, normals;
+    std::vector<char> window(m_window_size + 1); // One extra byte so strtoll always stops on a terminator.
+
+    meshData batch;
+    batch.positions.reserve(m_batch_corners);
+    batch.normals.reserve(m_batch_corners);
+    batch.indices.reserve(m_batch_corners);
+    VertexWelder welder(batch, m_batch_corners);
+
+    auto flush = [&]() -> bool {
+        if (batch.indices.empty()) {
+            return true;
+        }
+        m_batch_num++;
+        bool result = consume(batch);
+        batch.positions.clear();
+        batch.normals.clear();
+        batch.indices.clear();
+        batch.cornerCount = 0;
+        // The consumer may have swapped the storage out; keep the batch from growing past its share.
+        batch.positions.reserve(m_batch_corners);
+        batch.normals.reserve(m_batch_corners);
+        batch.indices.reserve(m_batch_corners);
+        welder.clear();
+        return result;
+    };
+
+    // Corners are (position, normal) index pairs. Smooth normals need the whole mesh, so corners without a normal
+    // get their face's.
+    auto addTriangle = [&](const long long *a, const long long *b, const long long *c) -> bool {
+        const long long *triangle[3] = {a, b, c};
+        for (const long long *corner: triangle) {
+            if (corner[0] < 0 || corner[0] >= (long long) positions.size() ||
+                corner[1] >= (long long) normals.size()) {
+                return false;
+            }
+        }
+        glm::vec3 p0 = positions[a[0]], p1 = positions[b[0]], p2 = positions[c[0]];
+        glm::vec3 faceNormal = glm::cross(p1 - p0, p2 - p0);
+        float length = glm::length(faceNormal);
+        faceNormal = length > 0.0f ? faceNormal / length : glm::vec3(0.0f);
+        for (const long long *corner: triangle) {
+            welder.addCorner(positions[corner[0]] + offset, corner[1] >= 0 ? normals[corner[1]] : faceNormal);
+        }
+        return true;
+    };
+
+    auto parseLine = [&](const char *p, const char *end) -> bool {
+        p = skipSpaces(p, end);
+        if (p + 1 < end && p[0] == 'v' && isSpace(p[1])) {
+            glm::vec3 v;
+            return parseVector(p + 2, end, v) && positions.push(v);
+        } else if (p + 2 < end && p[0] == 'v' && p[1] == 'n' && isSpace(p[2])) {
+            glm::vec3 n;
+            return parseVector(p + 3, end, n) && normals.push(n);
+        } else if (p + 1 < end && p[0] == 'f' && isSpace(p[1])) {
+            p += 2;
+            long long first[2], previous[2], current[2];
+            unsigned int count = 0;
+            while ((p = skipSpaces(p, end)) < end && *p != '#') {
+                p = parseCorner(p, end, positions.size(), normals.size(), current[0], current[1]);
+                if (!p) {
+                    return false;
+                }
+                if (count == 0) {
+                    first[0] = current[0];
+                    first[1] = current[1];
+                } else if (count >= 2) {
+                    // Fan triangulation; batches are only ever cut between whole triangles.
+                    if (batch.indices.size() + 3 > m_batch_corners && !flush()) {
+                        return false;
+                    }
+                    if (!addTriangle(first, previous, current)) {
+                        return false;
+                    }
+                }
+                previous[0] = current[0];
+                previous[1] = current[1];
+                count++;
+            }
+            return count >= 3;
+        }
+        return true; // Comments, texture coordinates, groups, materials...
+    };
+
+    size_t filled = 0, lineNum = 0;
+    bool eof = false, ok = true;
+    while (ok && !(eof && filled == 0)) {
+        if (!eof) {
+            ssize_t bytes = read(fd, window.data() + filled, m_window_size - filled);
+            if (bytes < 0) {
+                m_error = "Could not read " + filePath;
+                ok = false;
+                break;
+            }
+            eof = bytes == 0;
+            filled += bytes;
+        }
+
+        // Only whole lines are parsed; the tail is carried over to the next window.
+        size_t consumed = filled;
+        if (!eof) {
+            const char *lastNewline = window.data() + filled;
+            while (lastNewline > window.data() && lastNewline[-1] != '\n') {
+                lastNewline--;
+            }
+            if (lastNewline == window.data()) {
+                m_error = filePath + ": line " + std::to_string(lineNum + 1) + " is longer than the read window";
+                ok = false;
+                break;
+            }
+            consumed = lastNewline - window.data();
+        }
+
+        const char *p = window.data(), *end = window.data() + consumed;
+        while (p < end) {
+            const char *lineEnd = (const char *) memchr(p, '\n', end - p);
+            lineEnd = lineEnd ? lineEnd : end;
+            lineNum++;
+            window[lineEnd - window.data()] = '\0'; // Terminates the line for strtoll.
+            if (!parseLine(p, lineEnd)) {
+                m_error = filePath + ": malformed line " + std::to_string(lineNum);
+                ok = false;
+                break;
+            }
+            p = lineEnd + 1;
+        }
+
+        std::memmove(window.data(), window.data() + consumed, filled - consumed);
+        filled -= consumed;
+    }
+    close(fd);
+
+    if (ok && !flush()) {
+        m_error = "Batch consumer failed for " + filePath;
+        ok = false;
+    }
+
+    return ok;
+}
@@ -0,0 +1,344 @@
+#include "OcclusionCuller.h"
+#include <algorithm>
+#include <cmath>
+#include <cfloat>
+#include "Simd.h"
+
+#define OCCLUSION_TILES_X ((OCCLUSION_WIDTH + OCCLUSION_TILE_WIDTH - 1) / OCCLUSION_TILE_WIDTH)
+#define OCCLUSION_TILES_Y ((OCCLUSION_HEIGHT + OCCLUSION_TILE_HEIGHT - 1) / OCCLUSION_TILE_HEIGHT)
+
+static_assert(OCCLUSION_WIDTH % SIMD_WIDTH == 0 && OCCLUSION_TILE_WIDTH % SIMD_WIDTH == 0,
+              "rows of the depth buffer and of its tiles must be whole SIMD steps");
+
+OcclusionCuller::OcclusionCuller(unsigned int threadNum)
+        : m_bins(OCCLUSION_TILES_X * OCCLUSION_TILES_Y), m_binned_num(0), m_view_projection(1.0f), m_generation(0),
+          m_busy(0), m_stop(false), m_next_tile(0) {
+    if (threadNum == 0) {
+        threadNum = std::max(1u, std::thread::hardware_concurrency());
+    }
+    threadNum = std::min<unsigned int>(threadNum, m_bins.size());
+    for (unsigned int i = 1; i < threadNum; i++) {
+        m_workers.emplace_back(&OcclusionCuller::workerLoop, this);
+    }
+    unsigned int width = OCCLUSION_WIDTH, height = OCCLUSION_HEIGHT;
+    while (true) {
+        m_levels.emplace_back(width * height, 1.0f);
+        m_level_widths.push_back(width);
+        m_level_heights.push_back(height);
+        if (width == 1 && height == 1) {
+            break;
+        }
+        width = (width + 1) / 2;
+        height = (height + 1) / 2;
+    }
+}
+
+OcclusionCuller::~OcclusionCuller() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_wake.notify_all();
+    for (auto &worker: m_workers) {
+        worker.join();
+    }
+}
+
+void OcclusionCuller::workerLoop() {
+    unsigned int seen = 0;
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (true) {
+        m_wake.wait(lock, [this, &seen]() { return m_stop || m_generation != seen; });
+        if (m_stop) {
+            return;
+        }
+        seen = m_generation;
+        lock.unlock();
+        rasterizeTiles();
+        lock.lock();
+        if (--m_busy == 0) {
+            m_done.notify_one();
+        }
+    }
+}
+
+void OcclusionCuller::begin(const glm::mat4 &viewProjection) {
+    m_view_projection = viewProjection;
+    std::fill(m_levels[0].begin(), m_levels[0].end(), 1.0f);
+    m_triangles.clear();
+    for (auto &bin: m_bins) {
+        bin.clear();
+    }
+    m_binned_num = 0;
+}
+
+void OcclusionCuller::addOccluder(const glm::mat4 &model, const glm::vec3 *positions, size_t vertexNum,
+                                  const unsigned int *indices, size_t indexNum) {
+    addIndexedOccluder(model, positions, vertexNum, indices, indexNum);
+}
+
+void OcclusionCuller::addOccluder(const glm::mat4 &model, const glm::vec3 *positions, size_t vertexNum,
+                                  const unsigned short *indices, size_t indexNum) {
+    addIndexedOccluder(model, positions, vertexNum, indices, indexNum);
+}
+
+template<typename Index>
+void OcclusionCuller::addIndexedOccluder(const glm::mat4 &model, const glm::vec3 *positions, size_t vertexNum,
+                                         const Index *indices, size_t indexNum) {
+    // Vertices are shared by several triangles; each is transformed once.
+    glm::mat4 transform = m_view_projection * model;
+    m_clip.resize(vertexNum);
+    for (size_t v = 0; v < vertexNum; v++) {
+        m_clip[v] = transform * glm::vec4(positions[v], 1.0f);
+    }
+    for (size_t t = 0; t + 2 < indexNum; t += 3) {
+        const glm::vec4 clip[3] = {m_clip[indices[t]], m_clip[indices[t + 1]], m_clip[indices[t + 2]]};
+        // Entirely outside one side of the frustum.
+        if ((clip[0].x < -clip[0].w && clip[1].x < -clip[1].w && clip[2].x < -clip[2].w) ||
+            (clip[0].x > clip[0].w && clip[1].x > clip[1].w && clip[2].x > clip[2].w) ||
+            (clip[0].y < -clip[0].w && clip[1].y < -clip[1].w && clip[2].y < -clip[2].w) ||
+            (clip[0].y > clip[0].w && clip[1].y > clip[1].w && clip[2].y > clip[2].w) ||
+            (clip[0].z > clip[0].w && clip[1].z > clip[1].w && clip[2].z > clip[2].w)) {
+            continue;
+        }
+
+        // Clipped at the near plane, where z + w = 0: a triangle or a quad in front of it.
+        glm::vec4 polygon[4];
+        int cornerNum = 0;
+        for (int k = 0; k < 3; k++) {
+            const glm::vec4 &a = clip[k], &b = clip[(k + 1) % 3];
+            float distanceA = a.z + a.w, distanceB = b.z + b.w;
+            if (distanceA >= 0.0f) {
+                polygon[cornerNum++] = a;
+            }
+            if ((distanceA >= 0.0f) != (distanceB >= 0.0f)) {
+                polygon[cornerNum++] = a + (b - a) * (distanceA / (distanceA - distanceB));
+            }
+        }
+        if (cornerNum < 3) {
+            continue;
+        }
+
+        // Pixel coordinates and depths in [0, 1].
+        glm::vec3 screen[4];
+        for (int k = 0; k < cornerNum; k++) {
+            glm::vec3 ndc = glm::vec3(polygon[k]) / polygon[k].w;
+            screen[k] = glm::vec3((ndc.x * 0.5f + 0.5f) * OCCLUSION_WIDTH, (ndc.y * 0.5f + 0.5f) * OCCLUSION_HEIGHT,
+                                  ndc.z * 0.5f + 0.5f);
+        }
+        addTriangle(screen[0], screen[1], screen[2]);
+        if (cornerNum == 4) {
+            addTriangle(screen[0], screen[2], screen[3]);
+        }
+    }
+}
+
+void OcclusionCuller::addTriangle(const glm::vec3 &a, const glm::vec3 &b, const glm::vec3 &c) {
+    // Either winding: occluders may be single-sided walls seen from behind.
+    float area = (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+    if (std::fabs(area) < 1e-8f) {
+        return;
+    }
+    const glm::vec3 *corners[3] = {&a, area > 0.0f ? &b : &c, area > 0.0f ? &c : &b};
+    area = std::fabs(area);
+
+    occluderTriangle triangle;
+    float minX = std::min(a.x, std::min(b.x, c.x)), maxX = std::max(a.x, std::max(b.x, c.x));
+    float minY = std::min(a.y, std::min(b.y, c.y)), maxY = std::max(a.y, std::max(b.y, c.y));
+    triangle.minX = std::max(0, int(std::ceil(minX - 0.5f)));
+    triangle.maxX = std::min(OCCLUSION_WIDTH - 1, int(std::floor(maxX - 0.5f)));
+    triangle.minY = std::max(0, int(std::ceil(minY - 0.5f)));
+    triangle.maxY = std::min(OCCLUSION_HEIGHT - 1, int(std::floor(maxY - 0.5f)));
+    if (triangle.minX > triangle.maxX || triangle.minY > triangle.maxY) {
+        return;
+    }
+
+    for (int k = 0; k < 3; k++) {
+        const glm::vec3 &from = *corners[k], &to = *corners[(k + 1) % 3];
+        triangle.edgeA[k] = from.y - to.y;
+        triangle.edgeB[k] = to.x - from.x;
+        triangle.edgeC[k] = -(triangle.edgeA[k] * from.x + triangle.edgeB[k] * from.y);
+    }
+
+    // The depth plane through the corners; a pixel keeps its value at the pixel's farthest corner.
+    const glm::vec3 &p0 = *corners[0], &p1 = *corners[1], &p2 = *corners[2];
+    triangle.depthX = ((p1.z - p0.z) * (p2.y - p0.y) - (p2.z - p0.z) * (p1.y - p0.y)) / area;
+    triangle.depthY = ((p2.z - p0.z) * (p1.x - p0.x) - (p1.z - p0.z) * (p2.x - p0.x)) / area;
+    triangle.depth = p0.z - triangle.depthX * p0.x - triangle.depthY * p0.y +
+                     0.5f * (std::fabs(triangle.depthX) + std::fabs(triangle.depthY));
+    triangle.maxDepth = std::max(a.z, std::max(b.z, c.z));
+
+    unsigned int index = m_triangles.size();
+    m_triangles.push_back(triangle);
+    for (int ty = triangle.minY / OCCLUSION_TILE_HEIGHT; ty <= triangle.maxY / OCCLUSION_TILE_HEIGHT; ty++) {
+        for (int tx = triangle.minX / OCCLUSION_TILE_WIDTH; tx <= triangle.maxX / OCCLUSION_TILE_WIDTH; tx++) {
+            m_bins[ty * OCCLUSION_TILES_X + tx].push_back(index);
+            m_binned_num++;
+        }
+    }
+}
+
+void OcclusionCuller::rasterizeTile(unsigned int tile) {
+    int tileX = tile % OCCLUSION_TILES_X * OCCLUSION_TILE_WIDTH;
+    int tileY = tile / OCCLUSION_TILES_X * OCCLUSION_TILE_HEIGHT;
+    int tileMaxX = std::min(tileX + OCCLUSION_TILE_WIDTH, OCCLUSION_WIDTH) - 1;
+    int tileMaxY = std::min(tileY + OCCLUSION_TILE_HEIGHT, OCCLUSION_HEIGHT) - 1;
+    float *depth = m_levels[0].data();
+    static const float pixelCenters[SIMD_WIDTH] = {0.5f, 1.5f, 2.5f, 3.5f};
+    const simdFloat4 zero = simdSet(0.0f), laneOffsets = simdLoad(pixelCenters);
+
+    for (unsigned int index: m_bins[tile]) {
+        const occluderTriangle &triangle = m_triangles[index];
+        // Rows start on a SIMD step; lanes outside the triangle fail its edges.
+        int minX = std::max(triangle.minX, tileX) / SIMD_WIDTH * SIMD_WIDTH;
+        int maxX = std::min(triangle.maxX, tileMaxX);
+        int minY = std::max(triangle.minY, tileY), maxY = std::min(triangle.maxY, tileMaxY);
+        simdFloat4 edgeA[3], edgeB[3], edgeC[3];
+        for (int k = 0; k < 3; k++) {
+            edgeA[k] = simdSet(triangle.edgeA[k]);
+            edgeB[k] = simdSet(triangle.edgeB[k]);
+            edgeC[k] = simdSet(triangle.edgeC[k]);
+        }
+        simdFloat4 depthX = simdSet(triangle.depthX), depthY = simdSet(triangle.depthY);
+        simdFloat4 depth0 = simdSet(triangle.depth), maxDepth = simdSet(triangle.maxDepth);
+
+        for (int y = minY; y <= maxY; y++) {
+            simdFloat4 centerY = simdSet(y + 0.5f);
+            simdFloat4 rowC[3] = {edgeB[0] * centerY + edgeC[0], edgeB[1] * centerY + edgeC[1],
+                                  edgeB[2] * centerY + edgeC[2]};
+            simdFloat4 rowDepth = depthY * centerY + depth0;
+            float *row = depth + y * OCCLUSION_WIDTH;
+            for (int x = minX; x <= maxX; x += SIMD_WIDTH) {
+                simdFloat4 centerX = simdSet(float(x)) + laneOffsets;
+                int outside = simdLessMask(edgeA[0] * centerX + rowC[0], zero) |
+                              simdLessMask(edgeA[1] * centerX + rowC[1], zero) |
+                              simdLessMask(edgeA[2] * centerX + rowC[2], zero);
+                if (outside == (1 << SIMD_WIDTH) - 1) {
+                    continue;
+                }
+                simdFloat4 pixels = simdMin(depthX * centerX + rowDepth, maxDepth);
+                if (outside == 0) {
+                    simdStore(row + x, simdMin(simdLoad(row + x), pixels));
+                    continue;
+                }
+                float lanes[SIMD_WIDTH];
+                simdStore(lanes, pixels);
+                for (int lane = 0; lane < SIMD_WIDTH; lane++) {
+                    if (!(outside & (1 << lane))) {
+                        row[x + lane] = std::min(row[x + lane], lanes[lane]);
+                    }
+                }
+            }
+        }
+    }
+}
+
+void OcclusionCuller::buildPyramid() {
+    for (size_t level = 1; level < m_levels.size(); level++) {
+        const std::vector<float> &below = m_levels[level - 1];
+        unsigned int belowWidth = m_level_widths[level - 1], belowHeight = m_level_heights[level - 1];
+        std::vector<float> &texels = m_levels[level];
+        for (unsigned int y = 0; y < m_level_heights[level]; y++) {
+            // Odd sizes repeat their last row or column.
+            const float *row0 = &below[2 * y * belowWidth];
+            const float *row1 = &below[std::min(2 * y + 1, belowHeight - 1) * belowWidth];
+            for (unsigned int x = 0; x < m_level_widths[level]; x++) {
+                unsigned int x0 = 2 * x, x1 = std::min(2 * x + 1, belowWidth - 1);
+                texels[y * m_level_widths[level] + x] = std::max(std::max(row0[x0], row0[x1]),
+                                                                 std::max(row1[x0], row1[x1]));
+            }
+        }
+    }
+}
+
+void OcclusionCuller::rasterizeTiles() {
+    // Tiles are handed out one at a time: their costs differ a lot.
+    for (unsigned int tile; (tile = m_next_tile++) < m_bins.size();) {
+        if (!m_bins[tile].empty()) {
+            rasterizeTile(tile);
+        }
+    }
+}
+
+void OcclusionCuller::rasterize() {
+    m_next_tile = 0;
+    if (m_workers.empty() || m_binned_num < OCCLUSION_MIN_PARALLEL_TRIANGLES) {
+        rasterizeTiles();
+    } else {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_busy = m_workers.size();
+            m_generation++;
+        }
+        m_wake.notify_all();
+        rasterizeTiles();
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_done.wait(lock, [this]() { return m_busy == 0; });
+    }
+    buildPyramid();
+}
+
+bool OcclusionCuller::isVisible(const glm::vec3 &min, const glm::vec3 &max) const {
+    // The corners in clip space, from one corner and the clip-space edges.
+    glm::vec4 origin = m_view_projection * glm::vec4(min, 1.0f);
+    glm::vec4 edgeX = m_view_projection[0] * (max.x - min.x), edgeY = m_view_projection[1] * (max.y - min.y);
+    glm::vec4 edgeZ = m_view_projection[2] * (max.z - min.z);
+    float minX = FLT_MAX, maxX = -FLT_MAX, minY = FLT_MAX, maxY = -FLT_MAX, nearest = FLT_MAX;
+    for (int corner = 0; corner < 8; corner++) {
+        glm::vec4 clip = origin;
+        if (corner & 1) {
+            clip += edgeX;
+        }
+        if (corner & 2) {
+            clip += edgeY;
+        }
+        if (corner & 4) {
+            clip += edgeZ;
+        }
+        if (clip.w <= 1e-5f) {
+            return true;
+        }
+        float inverseW = 1.0f / clip.w;
+        float x = (clip.x * inverseW * 0.5f + 0.5f) * OCCLUSION_WIDTH;
+        float y = (clip.y * inverseW * 0.5f + 0.5f) * OCCLUSION_HEIGHT;
+        minX = std::min(minX, x);
+        maxX = std::max(maxX, x);
+        minY = std::min(minY, y);
+        maxY = std::max(maxY, y);
+        nearest = std::min(nearest, clip.z * inverseW * 0.5f + 0.5f);
+    }
+    if (maxX < 0.0f || maxY < 0.0f || minX >= OCCLUSION_WIDTH || minY >= OCCLUSION_HEIGHT) {
+        return true;
+    }
+
+    // The pixels the rectangle touches, then the level where they are at most 2x2 texels.
+    int x0 = std::max(0, int(minX)), x1 = std::min(OCCLUSION_WIDTH - 1, int(maxX));
+    int y0 = std::max(0, int(minY)), y1 = std::min(OCCLUSION_HEIGHT - 1, int(maxY));
+    size_t level = 0;
+    while (level + 1 < m_levels.size() &&
+           ((x1 >> level) - (x0 >> level) > 1 || (y1 >> level) - (y0 >> level) > 1)) {
+        level++;
+    }
+    const std::vector<float> &texels = m_levels[level];
+    unsigned int width = m_level_widths[level];
+    for (int y = y0 >> level; y <= y1 >> level; y++) {
+        for (int x = x0 >> level; x <= x1 >> level; x++) {
+            if (nearest <= texels[y * width + x]) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+size_t OcclusionCuller::cull(std::vector<unsigned int> &objects, const glm::vec3 *mins, const glm::vec3 *maxs) const {
+    size_t kept = 0;
+    for (unsigned int object: objects) {
+        if (isVisible(mins[object], maxs[object])) {
+            objects[kept++] = object;
+        }
+    }
+    size_t removed = objects.size() - kept;
+    objects.resize(kept);
+    return removed;
+}
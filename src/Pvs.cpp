@@ -0,0 +1,171 @@
+#include "Pvs.h"
+#include <fstream>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+
+static uint64_t hashBytes(uint64_t hash, const void *data, size_t size) {
+    const unsigned char *bytes = (const unsigned char *) data;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+uint64_t Pvs::hashInputs(uint64_t sceneHash, const std::vector<uint64_t> &meshHashes) {
+    uint64_t version = PVS_VERSION;
+    uint64_t hash = hashBytes(14695981039346656037ull, &version, sizeof(version));
+    hash = hashBytes(hash, &sceneHash, sizeof(sceneHash));
+    for (uint64_t meshHash: meshHashes) {
+        hash = hashBytes(hash, &meshHash, sizeof(meshHash));
+    }
+    return hash;
+}
+
+static void writeNumber(uint64_t value, std::vector<unsigned char> &out) {
+    while (value >= 0x80) {
+        out.push_back((unsigned char) (value | 0x80));
+        value >>= 7;
+    }
+    out.push_back((unsigned char) value);
+}
+
+static uint64_t readNumber(const unsigned char *&p, const unsigned char *end) {
+    uint64_t value = 0;
+    for (int shift = 0; p < end && shift < 64; shift += 7) {
+        unsigned char byte = *p++;
+        value |= uint64_t(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            break;
+        }
+    }
+    return value;
+}
+
+void Pvs::encode(const std::vector<unsigned char> &visible, std::vector<unsigned char> &encoded) {
+    std::vector<unsigned char> runs;
+    runs.push_back(PVS_RUNS);
+    size_t i = 0;
+    for (unsigned char value = 0; i < visible.size(); value ^= 1) {
+        size_t start = i;
+        while (i < visible.size() && (visible[i] != 0) == value) {
+            i++;
+        }
+        writeNumber(i - start, runs);
+    }
+
+    size_t rawSize = 1 + (visible.size() + 7) / 8;
+    if (runs.size() <= rawSize) {
+        encoded.insert(encoded.end(), runs.begin(), runs.end());
+        return;
+    }
+    size_t start = encoded.size();
+    encoded.resize(start + rawSize, 0);
+    encoded[start] = PVS_RAW;
+    for (size_t object = 0; object < visible.size(); object++) {
+        if (visible[object]) {
+            encoded[start + 1 + object / 8] |= 1u << (object % 8);
+        }
+    }
+}
+
+bool Pvs::write(const std::string &filePath, pvsHeader header, const std::vector<std::vector<unsigned char>> &cells) {
+    std::vector<uint32_t> offsets;
+    std::vector<unsigned char> data;
+    for (const auto &cell: cells) {
+        offsets.push_back(data.size());
+        encode(cell, data);
+    }
+    offsets.push_back(data.size());
+
+    header.magic = PVS_MAGIC;
+    header.version = PVS_VERSION;
+    header.offsetsOffset = sizeof(pvsHeader);
+    header.dataOffset = header.offsetsOffset + offsets.size() * sizeof(uint32_t);
+    header.fileSize = header.dataOffset + data.size();
+
+    std::ofstream file(filePath, std::ios::binary);
+    if (!file.is_open()) {
+        return false;
+    }
+    file.write((const char *) &header, sizeof(header));
+    file.write((const char *) offsets.data(), offsets.size() * sizeof(uint32_t));
+    file.write((const char *) data.data(), data.size());
+    return bool(file);
+}
+
+bool Pvs::load(const std::string &filePath, uint64_t inputHash) {
+    close();
+    std::ifstream file(filePath, std::ios::binary | std::ios::ate);
+    if (!file.is_open()) {
+        m_error = "Could not open " + filePath;
+        return false;
+    }
+    std::vector<unsigned char> bytes(file.tellg());
+    file.seekg(0);
+    if (bytes.size() < sizeof(pvsHeader) || !file.read((char *) bytes.data(), bytes.size())) {
+        m_error = filePath + " is not a PVS file";
+        return false;
+    }
+
+    pvsHeader header;
+    std::memcpy(&header, bytes.data(), sizeof(header));
+    if (header.magic != PVS_MAGIC || header.version != PVS_VERSION || header.fileSize != bytes.size() ||
+        header.dataOffset != header.offsetsOffset + (size_t(header.cellsX) * header.cellsZ + 1) * sizeof(uint32_t) ||
+        header.dataOffset > bytes.size()) {
+        m_error = filePath + " is damaged or from another version";
+        return false;
+    }
+    if (header.inputHash != inputHash) {
+        m_error = filePath + " was baked from another scene or other meshes";
+        return false;
+    }
+    m_header = header;
+    m_file.swap(bytes);
+    return true;
+}
+
+void Pvs::close() {
+    m_file.clear();
+    m_file.shrink_to_fit();
+    m_header = pvsHeader();
+    m_error.clear();
+}
+
+int Pvs::findCell(const glm::vec3 &position) const {
+    if (!isOpen() || position.y < m_header.minY || position.y > m_header.maxY) {
+        return -1;
+    }
+    float x = std::floor((position.x - m_header.originX) / m_header.cellSize);
+    float z = std::floor((position.z - m_header.originZ) / m_header.cellSize);
+    if (x < 0.0f || z < 0.0f || x >= m_header.cellsX || z >= m_header.cellsZ) {
+        return -1;
+    }
+    return int(x) + int(z) * m_header.cellsX;
+}
+
+void Pvs::decode(unsigned int cell, std::vector<unsigned char> &visible) const {
+    visible.assign(m_header.objectNum, 0);
+    uint32_t offsets[2];
+    std::memcpy(offsets, m_file.data() + m_header.offsetsOffset + cell * sizeof(uint32_t), sizeof(offsets));
+    const unsigned char *p = m_file.data() + m_header.dataOffset + offsets[0];
+    const unsigned char *end = m_file.data() + m_header.dataOffset + std::min<uint64_t>(
+            offsets[1], m_file.size() - m_header.dataOffset);
+    if (p >= end) {
+        return;
+    }
+
+    if (*p++ == PVS_RAW) {
+        for (size_t object = 0; object < visible.size() && p + object / 8 < end; object++) {
+            visible[object] = (p[object / 8] >> (object % 8)) & 1;
+        }
+        return;
+    }
+    size_t object = 0;
+    for (unsigned char value = 0; p < end && object < visible.size(); value ^= 1) {
+        size_t run = std::min<uint64_t>(readNumber(p, end), visible.size() - object);
+        std::fill(visible.begin() + object, visible.begin() + object + run, value);
+        object += run;
+    }
+}
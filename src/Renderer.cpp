@@ -4,6 +4,8 @@
 
 #include "Renderer.h"
 #include <iostream>
+#include <chrono>
+#include <cstring>
 
 void GLClearError() {
     while (glGetError() != GL_NO_ERROR);
@@ -21,14 +23,113 @@ bool GLLogCall(const char *function, const char *file, int line) {
 }
 
 void Renderer::draw(const VertexArray &va, const IndexBuffer &ib, const Shader &shader) const {
-    va.bind(0);
+    draw(va, 0, ib, shader);
+}
+
+void Renderer::draw(const VertexArray &va, unsigned int index, const IndexBuffer &ib, const Shader &shader) const {
+    draw(va, index, ib, shader, 0, ib.getCount());
+}
+
+void Renderer::draw(const VertexArray &va, unsigned int index, const IndexBuffer &ib, const Shader &shader,
+                    unsigned int first, unsigned int count) const {
+    va.bind(index);
     ib.bind();
 
     shader.bind();
 
-    GLCall(glDrawElements(GL_TRIANGLES, ib.getCount(), GL_UNSIGNED_INT, nullptr));
+    size_t indexSize = ib.getType() == GL_UNSIGNED_SHORT ? sizeof(unsigned short) : sizeof(unsigned int);
+    GLCall(glDrawElements(GL_TRIANGLES, count, ib.getType(), (const void *) (first * indexSize)));
+}
+
+void Renderer::multiDrawIndirect(const VertexArray &va, unsigned int index, const Shader &shader, unsigned int type,
+                                 size_t offset, unsigned int count) const {
+    if (count == 0) {
+        return;
+    }
+    va.bind(index);
+    shader.bind();
+
+    GLCall(glMultiDrawElementsIndirect(GL_TRIANGLES, type, (const void *) offset, count, 0));
+}
+
+void Renderer::drawInstanced(const VertexArray &va, unsigned int index, const Shader &shader, unsigned int type,
+                             const drawElementsIndirectCommand &command) const {
+    va.bind(index);
+    shader.bind();
+
+    size_t indexSize = type == GL_UNSIGNED_SHORT ? sizeof(unsigned short) : sizeof(unsigned int);
+    GLCall(glDrawElementsInstancedBaseVertex(GL_TRIANGLES, command.count, type,
+                                             (const void *) (command.firstIndex * indexSize), command.instanceCount,
+                                             command.baseVertex));
 }
 
 void Renderer::clear() const {
     glClear(GL_COLOR_BUFFER_BIT);
 }
+
+uint64_t Renderer::makeKey(unsigned int pass, unsigned int shader, unsigned int vertexArray, float depth,
+                           bool backToFront, unsigned int mesh) {
+    // Non-negative floats order like their bit patterns; the sign bit is left out.
+    uint32_t bits = 0;
+    if (depth > 0.0f) {
+        std::memcpy(&bits, &depth, sizeof(bits));
+    }
+    uint64_t bucket = bits >> (31 - RENDER_KEY_DEPTH_BITS);
+    if (backToFront) {
+        bucket = (1u << RENDER_KEY_DEPTH_BITS) - 1 - bucket;
+    }
+    return (uint64_t(pass & 0xff) << RENDER_KEY_PASS_SHIFT) | (uint64_t(shader & 0xf) << RENDER_KEY_SHADER_SHIFT) |
+           (uint64_t(vertexArray & 0xf) << RENDER_KEY_VAO_SHIFT) | (bucket << RENDER_KEY_DEPTH_SHIFT) |
+           (mesh & ((1u << RENDER_KEY_MESH_BITS) - 1));
+}
+
+void Renderer::execute(const std::function<void(uint64_t)> &beginState, const std::function<void(unsigned int)> &draw,
+                       const std::function<void(uint64_t)> &endState) {
+    // Least significant byte first, each pass stable. All eight histograms are counted in one read, and bytes every
+    // command shares, like the high bits of the mesh, are skipped.
+    auto sortStart = std::chrono::steady_clock::now();
+    size_t commandNum = m_commands.size();
+    size_t counts[8][256] = {};
+    for (const auto &command: m_commands) {
+        for (int digit = 0; digit < 8; digit++) {
+            counts[digit][(command.key >> (8 * digit)) & 0xff]++;
+        }
+    }
+    m_sorted.resize(commandNum);
+    for (int digit = 0; digit < 8 && commandNum > 0; digit++) {
+        size_t *count = counts[digit];
+        if (count[(m_commands[0].key >> (8 * digit)) & 0xff] == commandNum) {
+            continue;
+        }
+        size_t offset = 0;
+        for (int value = 0; value < 256; value++) {
+            size_t valueNum = count[value];
+            count[value] = offset;
+            offset += valueNum;
+        }
+        for (const auto &command: m_commands) {
+            m_sorted[count[(command.key >> (8 * digit)) & 0xff]++] = command;
+        }
+        m_commands.swap(m_sorted);
+    }
+    m_queue_stats.sortSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - sortStart).count();
+
+    for (size_t i = 0; i < commandNum;) {
+        uint64_t key = m_commands[i].key;
+        beginState(key);
+        for (; i < commandNum && getState(m_commands[i].key) == getState(key); i++) {
+            draw(m_commands[i].payload);
+        }
+        endState(key);
+        m_queue_stats.stateChangeNum++;
+    }
+    m_queue_stats.commandNum += commandNum;
+    m_queue_stats.executeNum++;
+    m_commands.clear();
+}
+
+renderQueueStats Renderer::takeQueueStats() {
+    renderQueueStats stats = m_queue_stats;
+    m_queue_stats = renderQueueStats();
+    return stats;
+}
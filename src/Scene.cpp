@@ -0,0 +1,173 @@
+#include "Scene.h"
+#include "glm/gtc/matrix_transform.hpp"
+#include "TextTokenizer.h"
+
+glm::mat4 Scene::getModel(size_t i) const {
+    const glm::vec3 &rotation = m_rotations[i];
+    glm::mat4 model = glm::translate(glm::mat4(1.0f), m_positions[i]);
+    model = glm::rotate(model, glm::radians(rotation.z), glm::vec3(0.0f, 0.0f, 1.0f));
+    model = glm::rotate(model, glm::radians(rotation.y), glm::vec3(0.0f, 1.0f, 0.0f));
+    model = glm::rotate(model, glm::radians(rotation.x), glm::vec3(1.0f, 0.0f, 0.0f));
+    return glm::scale(model, m_scales[i]);
+}
+
+void Scene::reserve(size_t objectNum) {
+    m_meshes.reserve(objectNum);
+    m_parents.reserve(objectNum);
+    m_positions.reserve(objectNum);
+    m_rotations.reserve(objectNum);
+    m_scales.reserve(objectNum);
+    m_translucent.reserve(objectNum);
+    m_occluders.reserve(objectNum);
+    m_materials.reserve(objectNum);
+}
+
+unsigned int Scene::addMesh(const std::string &name, const std::string &path) {
+    m_mesh_names.push_back(name);
+    m_mesh_paths.push_back(path);
+    return m_mesh_paths.size() - 1;
+}
+
+void Scene::addObject(unsigned int mesh, const glm::vec3 &position, const glm::vec3 &rotation, const glm::vec3 &scale,
+                      bool translucent, bool occluder, const sceneMaterial &material, unsigned int parent) {
+    m_meshes.push_back(mesh);
+    m_parents.push_back(parent);
+    m_positions.push_back(position);
+    m_rotations.push_back(rotation);
+    m_scales.push_back(scale);
+    m_translucent.push_back(translucent);
+    m_occluders.push_back(occluder);
+    m_materials.push_back(material);
+}
+
+void Scene::clear() {
+    m_mesh_names.clear();
+    m_mesh_paths.clear();
+    m_meshes.clear();
+    m_parents.clear();
+    m_positions.clear();
+    m_rotations.clear();
+    m_scales.clear();
+    m_translucent.clear();
+    m_occluders.clear();
+    m_materials.clear();
+}
+
+static bool readVec3(TextTokenizer &tokens, glm::vec3 &value) {
+    return tokens.number(value.x) && tokens.number(value.y) && tokens.number(value.z);
+}
+
+bool Scene::parseObjectKeys(TextTokenizer &tokens, std::unordered_map<std::string_view, unsigned int> &objects) {
+    glm::vec3 &scale = m_scales.back();
+    sceneMaterial &material = m_materials.back();
+    std::string_view key, name;
+    bool valid = true;
+    while (valid && tokens.word(key)) {
+        if (key == "position") {
+            valid = readVec3(tokens, m_positions.back());
+        } else if (key == "rotation") {
+            valid = readVec3(tokens, m_rotations.back());
+        } else if (key == "scale") {
+            // A single factor scales uniformly.
+            valid = tokens.number(scale.x);
+            if (valid && tokens.peekNumber()) {
+                valid = tokens.number(scale.y) && tokens.number(scale.z);
+            } else {
+                scale = glm::vec3(scale.x);
+            }
+        } else if (key == "translucent") {
+            m_translucent.back() = 1;
+        } else if (key == "occluder") {
+            m_occluders.back() = 1;
+        } else if (key == "color") {
+            valid = readVec3(tokens, material.color);
+        } else if (key == "ambient") {
+            valid = tokens.number(material.ambient);
+        } else if (key == "diffuse") {
+            valid = tokens.number(material.diffuse);
+        } else if (key == "specular") {
+            valid = tokens.number(material.specular);
+        } else if (key == "shininess") {
+            valid = tokens.number(material.shininess);
+        } else if (key == "alpha") {
+            valid = tokens.number(material.alpha);
+        } else if (key == "name") {
+            if (!tokens.word(name)) {
+                valid = tokens.fail("expected 'name <id>'");
+            } else if (!objects.emplace(name, m_meshes.size() - 1).second) {
+                valid = tokens.fail("object '" + std::string(name) + "' is named twice");
+            }
+        } else if (key == "parent") {
+            auto parent = objects.end();
+            if (!tokens.word(name)) {
+                valid = tokens.fail("expected 'parent <id>'");
+            } else if ((parent = objects.find(name)) == objects.end()) {
+                valid = tokens.fail("unknown object '" + std::string(name) + "'");
+            } else {
+                m_parents.back() = parent->second;
+            }
+        } else {
+            valid = tokens.fail("unknown object key '" + std::string(key) + "'");
+        }
+    }
+    return valid;
+}
+
+bool Scene::load(const std::string &filePath) {
+    clear();
+    m_error.clear();
+
+    TextTokenizer tokens;
+    if (!tokens.open(filePath)) {
+        m_error = tokens.getError();
+        return false;
+    }
+    std::string directory;
+    size_t slash = filePath.find_last_of('/');
+    if (slash != std::string::npos) {
+        directory = filePath.substr(0, slash + 1);
+    }
+
+    // Size the arrays up front so parsing does not reallocate.
+    reserve(tokens.countLines("object"));
+
+    // Names are looked up as views into the mapping.
+    std::unordered_map<std::string_view, unsigned int> meshes, objects;
+    std::string_view keyword, name, file;
+    bool valid = true;
+    while (valid && tokens.nextLine()) {
+        tokens.word(keyword);
+        if (keyword == "mesh") {
+            if (!tokens.word(name) || !tokens.word(file)) {
+                valid = tokens.fail("expected 'mesh <name> <file>'");
+            } else if (!meshes.emplace(name, m_mesh_paths.size()).second) {
+                valid = tokens.fail("mesh '" + std::string(name) + "' is declared twice");
+            } else {
+                addMesh(std::string(name), directory + std::string(file));
+            }
+        } else if (keyword == "object") {
+            auto mesh = meshes.end();
+            if (!tokens.word(name)) {
+                valid = tokens.fail("expected 'object <mesh>'");
+            } else if ((mesh = meshes.find(name)) == meshes.end()) {
+                valid = tokens.fail("unknown mesh '" + std::string(name) + "'");
+            } else {
+                addObject(mesh->second, glm::vec3(0.0f), glm::vec3(0.0f), glm::vec3(1.0f), false, false,
+                          sceneMaterial());
+                valid = parseObjectKeys(tokens, objects);
+            }
+        } else {
+            valid = tokens.fail("unknown keyword '" + std::string(keyword) + "'");
+        }
+        if (valid && !tokens.atLineEnd()) {
+            valid = tokens.fail("unexpected text at the end of the line");
+        }
+    }
+
+    if (!valid) {
+        m_error = tokens.getError();
+        clear();
+        return false;
+    }
+    return true;
+}
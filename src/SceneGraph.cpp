@@ -0,0 +1,92 @@
+#include "SceneGraph.h"
+
+unsigned int SceneGraph::add(unsigned int parent, const glm::vec3 &translation, const glm::quat &rotation,
+                             const glm::vec3 &scale) {
+    m_parents.push_back(parent);
+    m_translations.push_back(translation);
+    m_rotations.push_back(rotation);
+    m_scales.push_back(scale);
+    m_worlds.emplace_back(1.0f);
+    m_normals.emplace_back(1.0f);
+    m_dirty.push_back(1);
+    m_any_dirty = true;
+    return m_parents.size() - 1;
+}
+
+void SceneGraph::setLocal(unsigned int node, const glm::vec3 &translation, const glm::quat &rotation,
+                          const glm::vec3 &scale) {
+    m_translations[node] = translation;
+    m_rotations[node] = rotation;
+    m_scales[node] = scale;
+    m_dirty[node] = 1;
+    m_any_dirty = true;
+}
+
+void SceneGraph::reserve(size_t nodeNum) {
+    m_parents.reserve(nodeNum);
+    m_translations.reserve(nodeNum);
+    m_rotations.reserve(nodeNum);
+    m_scales.reserve(nodeNum);
+    m_worlds.reserve(nodeNum);
+    m_normals.reserve(nodeNum);
+    m_dirty.reserve(nodeNum);
+}
+
+void SceneGraph::clear() {
+    m_parents.clear();
+    m_translations.clear();
+    m_rotations.clear();
+    m_scales.clear();
+    m_worlds.clear();
+    m_normals.clear();
+    m_dirty.clear();
+    m_updated.clear();
+    m_any_dirty = false;
+}
+
+glm::quat SceneGraph::eulerRotation(const glm::vec3 &degrees) {
+    return glm::angleAxis(glm::radians(degrees.z), glm::vec3(0.0f, 0.0f, 1.0f)) *
+           glm::angleAxis(glm::radians(degrees.y), glm::vec3(0.0f, 1.0f, 0.0f)) *
+           glm::angleAxis(glm::radians(degrees.x), glm::vec3(1.0f, 0.0f, 0.0f));
+}
+
+const std::vector<unsigned int> &SceneGraph::update() {
+    m_updated.clear();
+    if (!m_any_dirty) {
+        return m_updated;
+    }
+
+    for (unsigned int node = 0; node < m_parents.size(); node++) {
+        unsigned int parent = m_parents[node];
+        // A parent precedes its children, so its flag is final by now.
+        if (parent != INVALID_NODE && m_dirty[parent]) {
+            m_dirty[node] = 1;
+        }
+        if (!m_dirty[node]) {
+            continue;
+        }
+
+        // Local T * R * S, and its normal matrix R * S^-1, which needs no inverse.
+        glm::mat3 rotation = glm::mat3_cast(m_rotations[node]);
+        const glm::vec3 &scale = m_scales[node];
+        glm::mat4 local(glm::vec4(rotation[0] * scale.x, 0.0f), glm::vec4(rotation[1] * scale.y, 0.0f),
+                        glm::vec4(rotation[2] * scale.z, 0.0f), glm::vec4(m_translations[node], 1.0f));
+        glm::mat3 localNormal(rotation[0] * (scale.x != 0.0f ? 1.0f / scale.x : 0.0f),
+                              rotation[1] * (scale.y != 0.0f ? 1.0f / scale.y : 0.0f),
+                              rotation[2] * (scale.z != 0.0f ? 1.0f / scale.z : 0.0f));
+        if (parent == INVALID_NODE) {
+            m_worlds[node] = local;
+            m_normals[node] = localNormal;
+        } else {
+            m_worlds[node] = m_worlds[parent] * local;
+            m_normals[node] = m_normals[parent] * localNormal;
+        }
+        m_updated.push_back(node);
+    }
+
+    for (unsigned int node: m_updated) {
+        m_dirty[node] = 0;
+    }
+    m_any_dirty = false;
+    return m_updated;
+}
@@ -0,0 +1,282 @@
+#include "SceneSnapshot.h"
+#include <fstream>
+#include <iostream>
+#include <cstring>
+#include <cstdio>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "MeshCache.h"
+
+static inline uint64_t alignUp(uint64_t value) {
+    return (value + 15) & ~uint64_t(15);
+}
+
+// FNV-1a, continuing from hash.
+static uint64_t hashBytes(uint64_t hash, const void *data, size_t size) {
+    const unsigned char *bytes = (const unsigned char *) data;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+static uint64_t hashString(uint64_t hash, const std::string &value) {
+    uint64_t length = value.size();
+    hash = hashBytes(hash, &length, sizeof(length));
+    return hashBytes(hash, value.data(), value.size());
+}
+
+// Hashes the contents of the scene and lights files; the mesh files are added by modification time and size.
+static bool hashSources(const std::string &scenePath, const std::string &lightsPath, uint64_t &hash) {
+    uint64_t version = SCENE_SNAPSHOT_VERSION;
+    hash = hashBytes(14695981039346656037ull, &version, sizeof(version));
+    for (const std::string *path: {&scenePath, &lightsPath}) {
+        struct stat st{};
+        if (stat(path->c_str(), &st) != 0) {
+            return false;
+        }
+        uint64_t contents = MeshCache::hashFile(*path);
+        hash = hashString(hash, *path);
+        hash = hashBytes(hash, &contents, sizeof(contents));
+    }
+    return true;
+}
+
+static uint64_t hashMesh(uint64_t hash, const std::string &path, int64_t mtime, uint64_t size) {
+    hash = hashString(hash, path);
+    hash = hashBytes(hash, &mtime, sizeof(mtime));
+    return hashBytes(hash, &size, sizeof(size));
+}
+
+SceneSnapshot::SceneSnapshot()
+        : m_data(nullptr), m_size(0), m_header(nullptr) {}
+
+SceneSnapshot::~SceneSnapshot() {
+    close();
+}
+
+void SceneSnapshot::close() {
+    if (m_data) {
+        munmap(m_data, m_size);
+    }
+    m_data = nullptr;
+    m_size = 0;
+    m_header = nullptr;
+}
+
+std::string SceneSnapshot::getString(uint32_t offset, uint32_t length) const {
+    return std::string((const char *) at(m_header->stringsOffset) + offset, length);
+}
+
+// Whether count elements of the given size from offset stay within size bytes, without overflowing.
+static inline bool fitsIn(uint64_t offset, uint64_t count, uint64_t elementSize, uint64_t size) {
+    return offset % 16 == 0 && offset <= size && count <= (size - offset) / elementSize;
+}
+
+bool SceneSnapshot::isConsistent() const {
+    const sceneSnapshotHeader &h = *m_header;
+    bool valid = fitsIn(h.meshesOffset, h.meshNum, sizeof(snapshotMesh), m_size) &&
+                 fitsIn(h.stringsOffset, h.stringSize, 1, m_size) &&
+                 fitsIn(h.objectMeshesOffset, h.objectNum, sizeof(uint32_t), m_size) &&
+                 fitsIn(h.parentsOffset, h.objectNum, sizeof(uint32_t), m_size) &&
+                 fitsIn(h.positionsOffset, h.objectNum, sizeof(glm::vec3), m_size) &&
+                 fitsIn(h.rotationsOffset, h.objectNum, sizeof(glm::vec3), m_size) &&
+                 fitsIn(h.scalesOffset, h.objectNum, sizeof(glm::vec3), m_size) &&
+                 fitsIn(h.translucentOffset, h.objectNum, 1, m_size) &&
+                 fitsIn(h.occludersOffset, h.objectNum, 1, m_size) &&
+                 fitsIn(h.materialsOffset, h.objectNum, sizeof(sceneMaterial), m_size) &&
+                 fitsIn(h.placementsOffset, h.objectNum, sizeof(resolvedPlacement), m_size) &&
+                 fitsIn(h.lightsOffset, h.lightNum, sizeof(glm::vec3), m_size) &&
+                 fitsIn(h.lightSpacesOffset, h.lightNum, sizeof(glm::mat4), m_size);
+
+    for (unsigned int m = 0; valid && m < h.meshNum; m++) {
+        const snapshotMesh &mesh = getMeshes()[m];
+        valid = (uint64_t) mesh.nameOffset + mesh.nameLength <= h.stringSize &&
+                (uint64_t) mesh.pathOffset + mesh.pathLength <= h.stringSize;
+    }
+
+    // Objects refer to declared meshes and to parents placed before them, as Scene::load guarantees.
+    const uint32_t *meshes = (const uint32_t *) at(h.objectMeshesOffset);
+    const uint32_t *parents = (const uint32_t *) at(h.parentsOffset);
+    for (uint32_t i = 0; valid && i < h.objectNum; i++) {
+        valid = meshes[i] < h.meshNum && (parents[i] < i || parents[i] == SCENE_ROOT);
+    }
+    return valid;
+}
+
+bool SceneSnapshot::open(const std::string &snapshotPath, const std::string &scenePath,
+                         const std::string &lightsPath) {
+    close();
+    m_error.clear();
+
+    int fd = ::open(snapshotPath.c_str(), O_RDONLY);
+    if (fd < 0) {
+        m_error = "Could not open the scene snapshot " + snapshotPath;
+        return false;
+    }
+    struct stat st{};
+    if (fstat(fd, &st) != 0 || (size_t) st.st_size < sizeof(sceneSnapshotHeader)) {
+        ::close(fd);
+        m_error = "The scene snapshot " + snapshotPath + " is truncated";
+        return false;
+    }
+    void *data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (data == MAP_FAILED) {
+        m_error = "Could not map the scene snapshot " + snapshotPath;
+        return false;
+    }
+    m_data = data;
+    m_size = st.st_size;
+
+    const sceneSnapshotHeader *header = (const sceneSnapshotHeader *) m_data;
+    if (header->magic != SCENE_SNAPSHOT_MAGIC || header->version != SCENE_SNAPSHOT_VERSION ||
+        header->fileSize != m_size) {
+        close();
+        m_error = "The scene snapshot " + snapshotPath + " is from another version";
+        return false;
+    }
+    m_header = header;
+    if (!isConsistent()) {
+        close();
+        m_error = "The scene snapshot " + snapshotPath + " is corrupt";
+        return false;
+    }
+
+    // The mesh files are checked like the mesh caches check their sources, by modification time and size.
+    uint64_t hash;
+    bool valid = hashSources(scenePath, lightsPath, hash);
+    for (unsigned int m = 0; valid && m < m_header->meshNum; m++) {
+        const snapshotMesh &mesh = getMeshes()[m];
+        std::string path = getString(mesh.pathOffset, mesh.pathLength);
+        struct stat source{};
+        valid = stat(path.c_str(), &source) == 0;
+        hash = hashMesh(hash, path, source.st_mtime, source.st_size);
+    }
+    if (!valid || hash != m_header->inputHash) {
+        close();
+        m_error = "The scene snapshot " + snapshotPath + " is out of date";
+        return false;
+    }
+
+    return true;
+}
+
+void SceneSnapshot::restore(Scene &scene, Lights &lights) const {
+    scene = Scene();
+    for (unsigned int m = 0; m < m_header->meshNum; m++) {
+        const snapshotMesh &mesh = getMeshes()[m];
+        scene.addMesh(getString(mesh.nameOffset, mesh.nameLength), getString(mesh.pathOffset, mesh.pathLength));
+    }
+
+    const uint32_t *meshes = (const uint32_t *) at(m_header->objectMeshesOffset);
+    const uint32_t *parents = (const uint32_t *) at(m_header->parentsOffset);
+    const glm::vec3 *positions = (const glm::vec3 *) at(m_header->positionsOffset);
+    const glm::vec3 *rotations = (const glm::vec3 *) at(m_header->rotationsOffset);
+    const glm::vec3 *scales = (const glm::vec3 *) at(m_header->scalesOffset);
+    const unsigned char *translucent = (const unsigned char *) at(m_header->translucentOffset);
+    const unsigned char *occluders = (const unsigned char *) at(m_header->occludersOffset);
+    const sceneMaterial *materials = (const sceneMaterial *) at(m_header->materialsOffset);
+    scene.reserve(m_header->objectNum);
+    for (size_t i = 0; i < m_header->objectNum; i++) {
+        scene.addObject(meshes[i], positions[i], rotations[i], scales[i], translucent[i], occluders[i],
+                        materials[i], parents[i]);
+    }
+
+    lights.setLights((const glm::vec3 *) at(m_header->lightsOffset), m_header->lightNum);
+}
+
+bool SceneSnapshot::write(const std::string &snapshotPath, const std::string &scenePath,
+                          const std::string &lightsPath, const Scene &scene,
+                          const std::vector<fileIdentity> &meshIdentities,
+                          const std::vector<resolvedPlacement> &placements, const Lights &lights,
+                          const std::vector<glm::mat4> &lightSpaceMatrices) {
+    size_t meshNum = scene.getMeshNum(), objectNum = scene.getObjectNum(), lightNum = lights.getLightNum();
+    if (meshIdentities.size() != meshNum || placements.size() != objectNum || lightSpaceMatrices.size() != lightNum) {
+        std::cerr << "The scene snapshot does not match the scene" << std::endl;
+        return false;
+    }
+
+    sceneSnapshotHeader header{};
+    header.magic = SCENE_SNAPSHOT_MAGIC;
+    header.version = SCENE_SNAPSHOT_VERSION;
+    header.meshNum = meshNum;
+    header.objectNum = objectNum;
+    header.lightNum = lightNum;
+    if (!hashSources(scenePath, lightsPath, header.inputHash)) {
+        std::cerr << "Could not hash the inputs of the scene snapshot" << std::endl;
+        return false;
+    }
+
+    std::vector<snapshotMesh> meshes(meshNum);
+    std::string strings;
+    for (size_t m = 0; m < meshNum; m++) {
+        const std::string &name = scene.getMeshName(m), &path = scene.getMeshPath(m);
+        meshes[m] = {(uint32_t) strings.size(), (uint32_t) name.size(), (uint32_t) (strings.size() + name.size()),
+                     (uint32_t) path.size(), meshIdentities[m]};
+        strings += name;
+        strings += path;
+        header.inputHash = hashMesh(header.inputHash, path, meshIdentities[m].mtime, meshIdentities[m].size);
+    }
+    header.stringSize = strings.size();
+
+    uint64_t offset = alignUp(sizeof(header));
+    auto place = [&offset](uint64_t &field, uint64_t bytes) {
+        field = offset;
+        offset = alignUp(offset + bytes);
+    };
+    place(header.meshesOffset, meshNum * sizeof(snapshotMesh));
+    place(header.stringsOffset, strings.size());
+    place(header.objectMeshesOffset, objectNum * sizeof(uint32_t));
+    place(header.parentsOffset, objectNum * sizeof(uint32_t));
+    place(header.positionsOffset, objectNum * sizeof(glm::vec3));
+    place(header.rotationsOffset, objectNum * sizeof(glm::vec3));
+    place(header.scalesOffset, objectNum * sizeof(glm::vec3));
+    place(header.translucentOffset, objectNum);
+    place(header.occludersOffset, objectNum);
+    place(header.materialsOffset, objectNum * sizeof(sceneMaterial));
+    place(header.placementsOffset, objectNum * sizeof(resolvedPlacement));
+    place(header.lightsOffset, lightNum * sizeof(glm::vec3));
+    place(header.lightSpacesOffset, lightNum * sizeof(glm::mat4));
+    header.fileSize = offset;
+
+    std::vector<char> buffer(header.fileSize, 0);
+    char *data = buffer.data();
+    std::memcpy(data, &header, sizeof(header));
+    std::memcpy(data + header.meshesOffset, meshes.data(), meshNum * sizeof(snapshotMesh));
+    std::memcpy(data + header.stringsOffset, strings.data(), strings.size());
+    for (size_t i = 0; i < objectNum; i++) {
+        ((uint32_t *) (data + header.objectMeshesOffset))[i] = scene.getMesh(i);
+        ((uint32_t *) (data + header.parentsOffset))[i] = scene.getParent(i);
+        ((glm::vec3 *) (data + header.positionsOffset))[i] = scene.getPosition(i);
+        ((glm::vec3 *) (data + header.rotationsOffset))[i] = scene.getRotation(i);
+        ((glm::vec3 *) (data + header.scalesOffset))[i] = scene.getScale(i);
+        data[header.translucentOffset + i] = scene.isTranslucent(i);
+        data[header.occludersOffset + i] = scene.isOccluder(i);
+        ((sceneMaterial *) (data + header.materialsOffset))[i] = scene.getMaterial(i);
+    }
+    std::memcpy(data + header.placementsOffset, placements.data(), objectNum * sizeof(resolvedPlacement));
+    for (size_t i = 0; i < lightNum; i++) {
+        ((glm::vec3 *) (data + header.lightsOffset))[i] = lights.getLightPos(i);
+    }
+    std::memcpy(data + header.lightSpacesOffset, lightSpaceMatrices.data(), lightNum * sizeof(glm::mat4));
+
+    // Write to a temporary file first so an interrupted run never leaves a truncated snapshot behind.
+    std::string tempPath = snapshotPath + ".tmp";
+    std::ofstream outFile(tempPath, std::ios::binary | std::ios::trunc);
+    if (!outFile.is_open()) {
+        std::cerr << "Could not write the scene snapshot " << snapshotPath << std::endl;
+        return false;
+    }
+    outFile.write(buffer.data(), buffer.size());
+    outFile.close();
+    if (!outFile || rename(tempPath.c_str(), snapshotPath.c_str()) != 0) {
+        remove(tempPath.c_str());
+        return false;
+    }
+
+    return true;
+}
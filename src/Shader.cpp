@@ -9,6 +9,8 @@
 #include <string>
 #include <glm/gtc/type_ptr.hpp>
 #include <vector>
+#include <cstring>
+#include "GLState.h"
 
 Shader::Shader(const std::string &filePath)
         : m_file_path1(filePath), m_renderer_ID(0) {
@@ -31,40 +33,86 @@ Shader::Shader(const std::string &vertexShader, const std::string &fragmentShade
 }
 
 Shader::~Shader() {
-    glDeleteProgram(m_renderer_ID);
+    glState().deleteProgram(m_renderer_ID);
 }
 
 void Shader::bind() const {
-    glUseProgram(m_renderer_ID);
+    glState().useProgram(m_renderer_ID);
 }
 
 void Shader::unbind() const {
-    glUseProgram(0);
+    glState().useProgram(0);
 }
 
 void Shader::setUniform1i(const std::string &name, int value) {
-    glUniform1i(getUniformLocation(name), value);
+    int location = getUniformLocation(name);
+    if (!holds(location, &value, 1)) {
+        glUniform1i(location, value);
+    }
 }
 
 void Shader::setUniform1f(const std::string &name, float value) {
-    glUniform1f(getUniformLocation(name), value);
+    int location = getUniformLocation(name);
+    if (!holds(location, &value, 1)) {
+        glUniform1f(location, value);
+    }
 }
 
 void Shader::setUniform3f(const std::string &name, float f0, float f1, float f2) {
-    glUniform3f(getUniformLocation(name), f0, f1, f2);
+    int location = getUniformLocation(name);
+    float value[3] = {f0, f1, f2};
+    if (!holds(location, value, 3)) {
+        glUniform3f(location, f0, f1, f2);
+    }
 }
 
 void Shader::setUniform4f(const std::string &name, float f0, float f1, float f2, float f3) {
-    glUniform4f(getUniformLocation(name), f0, f1, f2, f3);
+    int location = getUniformLocation(name);
+    float value[4] = {f0, f1, f2, f3};
+    if (!holds(location, value, 4)) {
+        glUniform4f(location, f0, f1, f2, f3);
+    }
+}
+
+// Matrices are compared as the shader sees them, after transposing.
+void Shader::setUniformMatrix3fv(const std::string &name, unsigned int count, bool transpose, glm::mat3 value) {
+    int location = getUniformLocation(name);
+    glm::mat3 held = transpose ? glm::transpose(value) : value;
+    if (!holds(location, glm::value_ptr(held), 9)) {
+        glUniformMatrix3fv(location, count, transpose, glm::value_ptr(value));
+    }
 }
 
 void Shader::setUniformMatrix4fv(const std::string &name, unsigned int count, bool transpose, glm::mat4 value) {
-    glUniformMatrix4fv(getUniformLocation(name), count, transpose, glm::value_ptr(value));
+    int location = getUniformLocation(name);
+    glm::mat4 held = transpose ? glm::transpose(value) : value;
+    if (!holds(location, glm::value_ptr(held), 16)) {
+        glUniformMatrix4fv(location, count, transpose, glm::value_ptr(value));
+    }
+}
+
+bool Shader::holds(int location, const void *value, unsigned int size) {
+    if (location < 0) {
+        glState().countUniform(true);
+        return true;
+    }
+    if ((size_t) location >= m_uniform_values.size()) {
+        m_uniform_values.resize(location + 1, uniformValue());
+    }
+    uniformValue &held = m_uniform_values[location];
+    bool same = held.size == size && std::memcmp(held.data, value, size * sizeof(float)) == 0;
+    if (!same) {
+        held.size = size;
+        std::memcpy(held.data, value, size * sizeof(float));
+    }
+    glState().countUniform(same);
+    return same;
 }
 
 int Shader::getUniformLocation(const std::string &name) {
-    if (m_uniform_location_cache.find(name) != m_uniform_location_cache.end()) {
-        return m_uniform_location_cache[name];
+    auto cached = m_uniform_location_cache.find(name);
+    if (cached != m_uniform_location_cache.end()) {
+        return cached->second;
     }
     int location = glGetUniformLocation(m_renderer_ID, name.c_str());
     if (location == -1) {
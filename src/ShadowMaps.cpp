@@ -0,0 +1,104 @@
+#include "ShadowMaps.h"
+#include <algorithm>
+#include "GLState.h"
+
+ShadowMaps::ShadowMaps(unsigned int lightNum, unsigned int width, unsigned int height)
+        : m_width(width), m_height(height) {
+    resize(lightNum);
+}
+
+void ShadowMaps::resize(unsigned int lightNum) {
+    m_opaque_FB.clear();
+    m_translucent_FB.clear();
+    m_opaque.reset(new Texture("", lightNum, textureType::Depth, m_width, m_height));
+    m_translucent.reset(new Texture("", lightNum, textureType::Depth, m_width, m_height));
+
+    for (unsigned int i = 0; i < lightNum; i++) {
+        m_opaque_FB.emplace_back();
+        m_opaque_FB[i].addTexutre(m_opaque->getID(i));
+        m_translucent_FB.emplace_back();
+        m_translucent_FB[i].addTexutre(m_translucent->getID(i));
+    }
+    unbind();
+
+    m_dirty.assign(lightNum, true);
+    m_casters.assign(lightNum, std::vector<bool>());
+}
+
+void ShadowMaps::bindOpaque(unsigned int light) const {
+    m_opaque_FB[light].bind();
+    glState().viewport(0, 0, m_width, m_height);
+    glClear(GL_DEPTH_BUFFER_BIT);
+}
+
+void ShadowMaps::bindTranslucent(unsigned int light) const {
+    m_translucent_FB[light].bind();
+    glState().viewport(0, 0, m_width, m_height);
+    glClear(GL_DEPTH_BUFFER_BIT);
+}
+
+void ShadowMaps::unbind() const {
+    glState().bindFramebuffer(0);
+}
+
+void ShadowMaps::markAllDirty() {
+    m_dirty.assign(m_dirty.size(), true);
+}
+
+bool ShadowMaps::missesCasters(unsigned int light, const std::vector<unsigned int> &casters) const {
+    const std::vector<bool> &rendered = m_casters[light];
+    for (unsigned int caster: casters) {
+        if (caster >= rendered.size() || !rendered[caster]) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void ShadowMaps::markClean(unsigned int light, const std::vector<unsigned int> &casters) {
+    std::vector<bool> &rendered = m_casters[light];
+    rendered.assign(rendered.size(), false);
+    for (unsigned int caster: casters) {
+        if (caster >= rendered.size()) {
+            rendered.resize(caster + 1, false);
+        }
+        rendered[caster] = true;
+    }
+    m_dirty[light] = false;
+}
+
+bool ShadowMaps::cropToReceivers(const glm::mat4 &lightSpaceMatrix, const glm::vec3 &receiverMin,
+                                 const glm::vec3 &receiverMax, glm::mat4 &cropped) {
+    cropped = lightSpaceMatrix;
+    if (receiverMin.x > receiverMax.x) {
+        return false;
+    }
+
+    // The receivers' corners in normalized device coordinates. Corners behind the light have no projection; the
+    // whole frustum is kept then.
+    glm::vec3 min(1.0f), max(-1.0f);
+    for (int corner = 0; corner < 8; corner++) {
+        glm::vec4 point = lightSpaceMatrix * glm::vec4(corner & 1 ? receiverMax.x : receiverMin.x,
+                                                       corner & 2 ? receiverMax.y : receiverMin.y,
+                                                       corner & 4 ? receiverMax.z : receiverMin.z, 1.0f);
+        if (point.w <= 1e-6f) {
+            return true;
+        }
+        glm::vec3 ndc = glm::vec3(point) / point.w;
+        min = glm::min(min, ndc);
+        max = glm::max(max, ndc);
+    }
+    min = glm::max(min, glm::vec3(-1.0f));
+    max = glm::min(max, glm::vec3(1.0f));
+    if (min.x >= max.x || min.y >= max.y || max.z <= -1.0f) {
+        return false;
+    }
+
+    // Maps the rectangle and the depths up to the farthest receiver back onto the unit cube, in clip space.
+    float width = max.x - min.x, height = max.y - min.y, depth = max.z + 1.0f;
+    glm::mat4 crop(glm::vec4(2.0f / width, 0.0f, 0.0f, 0.0f), glm::vec4(0.0f, 2.0f / height, 0.0f, 0.0f),
+                   glm::vec4(0.0f, 0.0f, 2.0f / depth, 0.0f),
+                   glm::vec4(-(max.x + min.x) / width, -(max.y + min.y) / height, 2.0f / depth - 1.0f, 1.0f));
+    cropped = crop * lightSpaceMatrix;
+    return true;
+}
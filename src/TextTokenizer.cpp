@@ -0,0 +1,192 @@
+#include "TextTokenizer.h"
+#include "ObjParser.h"
+#include <cstring>
+#include <cctype>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+static inline bool isSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+static inline bool isDelimiter(const char *p, const char *end) {
+    return p == end || isSpace(*p) || *p == '\n';
+}
+
+TextTokenizer::TextTokenizer()
+        : m_data(nullptr), m_size(0), m_begin(nullptr), m_end(nullptr), m_p(nullptr), m_line_begin(nullptr),
+          m_token(nullptr), m_line(0), m_in_line(false) {}
+
+TextTokenizer::~TextTokenizer() {
+    close();
+}
+
+void TextTokenizer::close() {
+    if (m_data) {
+        munmap(m_data, m_size);
+    }
+    m_data = nullptr;
+    m_size = 0;
+}
+
+bool TextTokenizer::open(const std::string &filePath) {
+    close();
+    reset(nullptr, nullptr, filePath);
+
+    int fd = ::open(filePath.c_str(), O_RDONLY);
+    if (fd < 0) {
+        m_error = "Could not open " + filePath;
+        return false;
+    }
+    struct stat st{};
+    if (fstat(fd, &st) != 0) {
+        ::close(fd);
+        m_error = "Could not stat " + filePath;
+        return false;
+    }
+    if (st.st_size > 0) {
+        void *data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED) {
+            ::close(fd);
+            m_error = "Could not map " + filePath;
+            return false;
+        }
+        madvise(data, st.st_size, MADV_SEQUENTIAL);
+        m_data = data;
+        m_size = st.st_size;
+    }
+    ::close(fd);
+
+    const char *begin = (const char *) m_data;
+    reset(begin, begin + m_size, filePath);
+    return true;
+}
+
+void TextTokenizer::reset(const char *begin, const char *end, const std::string &name) {
+    m_begin = m_p = m_line_begin = m_token = begin;
+    m_end = end;
+    m_line = 0;
+    m_in_line = false;
+    m_name = name;
+    m_error.clear();
+}
+
+size_t TextTokenizer::countLines(std::string_view prefix) const {
+    size_t count = 0;
+    const char *p = m_begin;
+    while (p < m_end) {
+        while (p < m_end && isSpace(*p)) {
+            p++;
+        }
+        if ((size_t) (m_end - p) >= prefix.size() && memcmp(p, prefix.data(), prefix.size()) == 0) {
+            count++;
+        }
+        const char *newline = (const char *) memchr(p, '\n', m_end - p);
+        p = newline ? newline + 1 : m_end;
+    }
+    return count;
+}
+
+void TextTokenizer::skipSpaces() {
+    while (m_p < m_end && isSpace(*m_p)) {
+        m_p++;
+    }
+    m_token = m_p;
+}
+
+bool TextTokenizer::nextLine() {
+    if (m_in_line) {
+        const char *newline = (const char *) memchr(m_p, '\n', m_end - m_p);
+        m_p = newline ? newline + 1 : m_end;
+    }
+    m_in_line = true;
+
+    while (m_p < m_end) {
+        m_line_begin = m_p;
+        m_line++;
+        skipSpaces();
+        if (m_p < m_end && *m_p != '\n' && *m_p != '#') {
+            return true;
+        }
+        const char *newline = (const char *) memchr(m_p, '\n', m_end - m_p);
+        m_p = newline ? newline + 1 : m_end;
+    }
+    return false;
+}
+
+bool TextTokenizer::atLineEnd() {
+    skipSpaces();
+    return m_p == m_end || *m_p == '\n';
+}
+
+bool TextTokenizer::word(std::string_view &token) {
+    if (atLineEnd()) {
+        return false;
+    }
+    const char *begin = m_p;
+    while (!isDelimiter(m_p, m_end)) {
+        m_p++;
+    }
+    token = std::string_view(begin, m_p - begin);
+    return true;
+}
+
+bool TextTokenizer::endNumber(const char *end) {
+    if (!end) {
+        return fail("expected a number");
+    }
+    // Stop at the delimiters and punctuation callers consume, but not in the middle of a token.
+    if (end < m_end && (std::isalnum((unsigned char) *end) || *end == '.' || *end == '_')) {
+        return fail("malformed number");
+    }
+    m_p = end;
+    return true;
+}
+
+bool TextTokenizer::number(float &value) {
+    skipSpaces();
+    return endNumber(ObjParser::parseFloat(m_p, m_end, value));
+}
+
+bool TextTokenizer::number(int &value) {
+    skipSpaces();
+    const char *p = m_p;
+    bool negative = p < m_end && *p == '-';
+    if (p < m_end && (*p == '-' || *p == '+')) {
+        p++;
+    }
+    if (p == m_end || *p < '0' || *p > '9') {
+        return endNumber(nullptr);
+    }
+    long long result = 0;
+    while (p < m_end && *p >= '0' && *p <= '9' && result < 1000000000ll) {
+        result = result * 10 + (*p++ - '0');
+    }
+    value = (int) (negative ? -result : result);
+    return endNumber(p);
+}
+
+bool TextTokenizer::peekNumber() {
+    skipSpaces();
+    if (m_p == m_end) {
+        return false;
+    }
+    char c = *m_p;
+    return (c >= '0' && c <= '9') || c == '-' || c == '+' || c == '.';
+}
+
+bool TextTokenizer::character(char c) {
+    skipSpaces();
+    if (m_p < m_end && *m_p == c) {
+        m_p++;
+        return true;
+    }
+    return false;
+}
+
+bool TextTokenizer::fail(const std::string &message) {
+    m_error = m_name + ":" + std::to_string(m_line) + ":" + std::to_string(getColumn()) + ": " + message;
+    return false;
+}
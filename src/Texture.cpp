@@ -4,17 +4,18 @@
 
 #include "Texture.h"
 #include "vendor/stb_image/stb_image.h"
+#include "GLState.h"
 
 Texture::Texture(const std::string &path, unsigned int count, textureType type, unsigned width, unsigned height)
         : m_file_path(path), m_local_buffer(nullptr), m_width(width), m_height(height), m_BPP(0), m_count(count) {
     stbi_set_flip_vertically_on_load(1);
     m_local_buffer = stbi_load(path.c_str(), &m_width, &m_height, &m_BPP, 4);
 
-    m_renderer_ID = new unsigned int(m_count);
+    m_renderer_ID = new unsigned int[m_count];
     glGenTextures(count, m_renderer_ID);
 
     for (size_t i = 0; i < count; i++) {
-        glBindTexture(GL_TEXTURE_2D, m_renderer_ID[i]);
+        glState().bindTexture(0, m_renderer_ID[i]);
 
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
@@ -33,19 +34,18 @@ Texture::Texture(const std::string &path, unsigned int count, textureType type,
         }
     }
 
-    glBindTexture(GL_TEXTURE_2D, 0);
+    glState().bindTexture(0, 0);
 }
 
 Texture::~Texture() {
-    glDeleteTextures(m_count, m_renderer_ID);
-    delete m_renderer_ID;
+    glState().deleteTextures(m_count, m_renderer_ID);
+    delete[] m_renderer_ID;
 }
 
 void Texture::bind(unsigned int slot) const {
-    glActiveTexture(GL_TEXTURE0 + slot);
-    glBindTexture(GL_TEXTURE_2D, *(m_renderer_ID + slot));
+    glState().bindTexture(slot, *(m_renderer_ID + slot));
 }
 
-void Texture::unBind() const {
-    glBindTexture(GL_TEXTURE_2D, 0);
+void Texture::unBind(unsigned int slot) const {
+    glState().bindTexture(slot, 0);
 }
@@ -4,36 +4,54 @@
 
 #include "VertexArray.h"
 #include "VertexBufferLayout.h"
+#include "GLState.h"
 
 VertexArray::VertexArray(unsigned int count)
 :m_count(count){
-    m_renderer_ID = new unsigned int(m_count);
+    m_renderer_ID = new unsigned int[m_count];
     glGenVertexArrays(m_count, m_renderer_ID);
 }
 
 VertexArray::~VertexArray() {
-    glDeleteVertexArrays(m_count, m_renderer_ID);
-    delete m_renderer_ID;
+    glState().deleteVertexArrays(m_count, m_renderer_ID);
+    delete[] m_renderer_ID;
 }
 
-void VertexArray::addBuffer(unsigned int index, const VertexBuffer &vb, const VertexBufferLayout &layout) {
+unsigned int VertexArray::addBuffer(unsigned int index, const VertexBuffer &vb, const VertexBufferLayout &layout,
+                                    unsigned int firstAttribute, size_t offset) {
     bind(index);
     vb.bind();
     const auto &elements = layout.getElements();
-    unsigned int offset = 0;
     for (unsigned int i = 0; i < elements.size(); i++) {
         const auto &element = elements[i];
-        glEnableVertexAttribArray(i);
-        glVertexAttribPointer(i, element.count, element.type, element.normalized, layout.getStride(),
-                              (const void *) offset);
-        offset += element.count * vertexBufferElement::getSizeOfType(element.type);
+        glEnableVertexAttribArray(firstAttribute + i);
+        if (element.integer) {
+            glVertexAttribIPointer(firstAttribute + i, element.count, element.type, layout.getStride(),
+                                   (const void *) offset);
+        } else {
+            glVertexAttribPointer(firstAttribute + i, element.count, element.type, element.normalized,
+                                  layout.getStride(), (const void *) offset);
+        }
+        glVertexAttribDivisor(firstAttribute + i, layout.getDivisor());
+        offset += element.getSize();
+    }
+
+    return firstAttribute + elements.size();
+}
+
+void VertexArray::addBuffers(unsigned int index, const std::vector<const VertexBuffer *> &buffers,
+                             const std::vector<VertexBufferLayout> &layouts) {
+    ASSERT(buffers.size() == layouts.size());
+    unsigned int attribute = 0;
+    for (size_t i = 0; i < buffers.size(); i++) {
+        attribute = addBuffer(index, *buffers[i], layouts[i], attribute);
     }
 }
 
 void VertexArray::bind(unsigned int index) const {
-    glBindVertexArray(*(m_renderer_ID+index));
+    glState().bindVertexArray(*(m_renderer_ID+index));
 }
 
 void VertexArray::unbind() const {
-    glBindVertexArray(0);
+    glState().bindVertexArray(0);
 }
@@ -4,27 +4,45 @@
 
 #include "VertexBuffer.h"
 #include "Renderer.h"
+#include "GLState.h"
 
 VertexBuffer::VertexBuffer(const void *data, unsigned int size) {
     glGenBuffers(1, &m_renderer_ID);
-    glBindBuffer(GL_ARRAY_BUFFER, m_renderer_ID);
+    glState().bindBuffer(GL_ARRAY_BUFFER, m_renderer_ID);
     glBufferData(GL_ARRAY_BUFFER, size, data, GL_STATIC_DRAW);
 }
 
 VertexBuffer::VertexBuffer(const std::vector<glm::vec3> &data, unsigned int size) {
     glGenBuffers(1, &m_renderer_ID);
-    glBindBuffer(GL_ARRAY_BUFFER, m_renderer_ID);
+    glState().bindBuffer(GL_ARRAY_BUFFER, m_renderer_ID);
     glBufferData(GL_ARRAY_BUFFER, size, data.data(), GL_STATIC_DRAW);
 }
 
+VertexBuffer::VertexBuffer(unsigned int size) {
+    glGenBuffers(1, &m_renderer_ID);
+    glState().bindBuffer(GL_ARRAY_BUFFER, m_renderer_ID);
+    glBufferData(GL_ARRAY_BUFFER, size, nullptr, GL_DYNAMIC_DRAW);
+}
+
 VertexBuffer::~VertexBuffer() {
-    glDeleteBuffers(1, &m_renderer_ID);
+    glState().deleteBuffers(1, &m_renderer_ID);
 }
 
 void VertexBuffer::bind() const {
-    glBindBuffer(GL_ARRAY_BUFFER, m_renderer_ID);
+    glState().bindBuffer(GL_ARRAY_BUFFER, m_renderer_ID);
 }
 
 void VertexBuffer::unbind() const {
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glState().bindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void VertexBuffer::update(size_t offset, const void *data, size_t size) const {
+    glState().bindBuffer(GL_ARRAY_BUFFER, m_renderer_ID);
+    glBufferSubData(GL_ARRAY_BUFFER, offset, size, data);
+}
+
+void VertexBuffer::replace(const void *data, size_t size) const {
+    glState().bindBuffer(GL_ARRAY_BUFFER, m_renderer_ID);
+    glBufferData(GL_ARRAY_BUFFER, size, nullptr, GL_STREAM_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, size, data);
 }
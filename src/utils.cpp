@@ -2,8 +2,6 @@
 // Created by 程思浩 on 24-5-31.
 //
 
-#define TINYOBJLOADER_IMPLEMENTATION
-
 #include "GL/glew.h"
 #include "fstream"
 #include "sstream"
@@ -11,7 +9,14 @@
 #include <GLFW/glfw3.h>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
-#include "tiny_obj_loader.h"
+#include "Mesh.h"
+#include "MeshCache.h"
+#include "ObjParser.h"
+#include "NormalGenerator.h"
+#include "ObjStreamer.h"
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
+#include <sys/stat.h>
 
 bool genShaderSrc(const std::string &filePath, unsigned int num) {
     std::ifstream inFile(filePath);
@@ -77,70 +82,109 @@ void processInput(GLFWwindow *window, glm::vec3 &cameraPos, glm::vec3 &cameraFro
     }
 }
 
-// Function to load the OBJ file.
-bool loadOBJ(const char *path, std::vector<glm::vec3> &vertices, std::vector<glm::vec3> &normals, const glm::vec3 &offset) {
-    tinyobj::attrib_t attrib;
-    std::vector<tinyobj::shape_t> shapes;
-    std::vector<tinyobj::material_t> materials;
-    std::string warn, err;
-
-    if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, path)) {
-        std::cerr << warn << err << std::endl;
+// Function to load the OBJ file as an indexed mesh, welding identical (position, normal) pairs.
+bool loadOBJ(const char *path, meshData &mesh, const glm::vec3 &offset) {
+    objData obj;
+    ObjParser parser;
+    if (!parser.parse(path, obj)) {
+        std::cerr << parser.getError() << std::endl;
         return false;
     }
 
-    for (const auto &shape: shapes) {
-        for (const auto &index: shape.mesh.indices) {
-            glm::vec3 vertex = {
-                    attrib.vertices[3 * index.vertex_index + 0] + offset.x,
-                    attrib.vertices[3 * index.vertex_index + 1] + offset.y,
-                    attrib.vertices[3 * index.vertex_index + 2] + offset.z
+    // Files without vn records get generated normals instead of zero vectors.
+    NormalGenerator generator;
+    size_t generated = generator.generate(obj);
+    if (generated > 0) {
+        std::cout << path << ": generated normals for " << generated << " corners" << std::endl;
+    }
+
+    size_t cornerCount = obj.corners.size();
+    mesh.indices.reserve(mesh.indices.size() + cornerCount);
+
+    VertexWelder welder(mesh, obj.positions.size() / 3);
+    for (const auto &corner: obj.corners) {
+        glm::vec3 vertex = {
+                obj.positions[3 * corner.position + 0] + offset.x,
+                obj.positions[3 * corner.position + 1] + offset.y,
+                obj.positions[3 * corner.position + 2] + offset.z
+        };
+
+        glm::vec3 normal(0.0f);
+        if (corner.normal >= 0) {
+            normal = {
+                    obj.normals[3 * corner.normal + 0],
+                    obj.normals[3 * corner.normal + 1],
+                    obj.normals[3 * corner.normal + 2]
             };
-            vertices.push_back(vertex);
-
-            if (!attrib.normals.empty()) {
-                glm::vec3 normal = {
-                        attrib.normals[3 * index.normal_index + 0],
-                        attrib.normals[3 * index.normal_index + 1],
-                        attrib.normals[3 * index.normal_index + 2]
-                };
-                normals.push_back(normal);
-            }
         }
+        welder.addCorner(vertex, normal);
     }
 
+    // Report how much welding saved.
+    std::cout << path << ": " << cornerCount << " -> " << mesh.positions.size() << " vertices ("
+              << (mesh.positions.empty() ? 0.0 : double(cornerCount) / mesh.positions.size()) << "x), "
+              << (mesh.fitsShortIndices() ? 16 : 32) << "-bit indices" << std::endl;
+
     return true;
 }
 
-void getAxisOff(const std::string filePath, std::unordered_map<unsigned int, glm::vec3> &axisOffs){
-    std::ifstream stream(filePath);
-
-    std::string line;
-
-    while (getline(stream, line)) {
-        if (line.find("##") == std::string::npos && line != "") { // Skip if encounter comment lines or blank lines.
-            if (line.find("# object") != std::string::npos) {
-                line = line.assign(line, 8);
-                unsigned int index = std::stoul(line);
-                std::vector<float> offset;
-                getline(stream, line);
-                std::string::iterator it = line.begin();
-                while (it != line.end()) {
-                    std::string off;
-                    while (it != line.end() && (*it) != ' ') {
-                        off.push_back(*it);
-                        it++;
-                    }
-                    offset.push_back(std::stof(off));
-                    if (it != line.end() && (*it) == ' ') {
-                        it++;
-                    }
-                }
-                axisOffs[index] = glm::vec3(offset[0], offset[1],offset[2]);
-            } else {
-                std::cout << "Failed to parse scene information from " << filePath << std::endl;
-                return ;
-            }
+// Function to load the OBJ file through its binary cache, rebuilding the cache when it is missing or stale. Files of
+// at least streamThreshold bytes are streamed into the cache with streamBudget bytes of working memory.
+bool loadOBJ(const char *path, MeshCache &cache, const glm::vec3 &offset, size_t streamBudget,
+             unsigned long long streamThreshold) {
+    std::string cachePath = std::string(path) + ".cache";
+    if (cache.open(cachePath, path, offset)) {
+        return true;
+    }
+
+    // Only the scene offset changed: move the cached positions instead of rebuilding.
+    if (MeshCache::rebase(cachePath, path, offset) && cache.open(cachePath, path, offset)) {
+        std::cout << path << ": mesh cache moved to the new offset" << std::endl;
+        return true;
+    }
+
+    // Meshes too large to hold in memory are streamed into the cache within a fixed budget.
+    struct stat st{};
+    if (stat(path, &st) == 0 && (unsigned long long) st.st_size >= streamThreshold) {
+        ObjStreamer streamer(streamBudget);
+        MeshCacheWriter writer(cachePath, path, offset);
+        auto consume = [&writer](meshData &batch) {
+            vertexCacheStats before, after;
+            optimizeMesh(batch, before, after);
+            return writer.append(batch);
+        };
+        if (!streamer.stream(path, offset, consume) ||
+            !writer.finish(streamer.getWindowSize())) {
+            std::cerr << "Failed to stream " << path << ": " << streamer.getError() << std::endl;
+            return false;
         }
+        std::cout << path << ": streamed in " << streamer.getBatchNum() << " batches" << std::endl;
+        return cache.open(cachePath, path, offset);
     }
-}
\ No newline at end of file
+
+    meshData mesh;
+    if (!loadOBJ(path, mesh, offset)) {
+        return false;
+    }
+
+    // Optimise once at cache build time; later runs map the optimised mesh.
+    vertexCacheStats before, after;
+    optimizeMesh(mesh, before, after);
+    std::cout << path << ": ACMR " << before.acmr << " -> " << after.acmr << ", ATVR " << before.atvr << " -> "
+              << after.atvr << std::endl;
+
+    buildLodChain(mesh);
+    std::cout << path << ": " << mesh.lods.size() << " levels of detail:";
+    for (const meshLod &lod: mesh.lods) {
+        std::cout << " " << lod.indexCount / 3;
+    }
+    std::cout << " triangles" << std::endl;
+
+    if (MeshCache::write(cachePath, path, offset, mesh) && cache.open(cachePath, path, offset)) {
+        return true;
+    }
+
+    // A read-only or full disk only costs the cache; this run uses the mesh just built.
+    std::cerr << "Failed to write mesh cache for " << path << ", using the mesh from memory" << std::endl;
+    return cache.hold(path, offset, mesh);
+}